@@ -0,0 +1,31 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+#include "sqlite.h"
+
+namespace sqlite {
+
+struct allocator_statistics {
+  // Largest allocation size of each size class. Allocations larger than the last class are
+  // passed to the system allocator and counted in the last entry of `allocations`.
+  std::vector<std::size_t> sizes;
+
+  // Number of allocations per size class, including reallocations that moved to a new class.
+  std::vector<std::uint64_t> allocations;
+
+  // Bytes currently allocated and the highest value observed. Threads publish their usage in
+  // steps of 64 KiB, so both values are approximate by that amount per thread.
+  std::int64_t current = 0;
+  std::int64_t peak = 0;
+};
+
+// Memory allocator for `SQLITE_CONFIG_MALLOC` that serves small allocations from size-class
+// pools with a free list cache per thread. Pool memory is reused but never returned to the
+// operating system. Install it with `config::allocator` or pass the methods to
+// `sqlite3_config` directly.
+const sqlite3_mem_methods* pool_allocator();
+
+allocator_statistics pool_allocator_statistics();
+
+}  // namespace sqlite
@@ -0,0 +1,51 @@
+#pragma once
+#include <string>
+
+#include "sqlite.h"
+
+// Approximate nearest-neighbour indexes over float32 BLOB embeddings, as virtual tables of
+// the module "ivf_flat" that `define_ann` registers on a connection, e.g.
+//
+//   define_ann(db);
+//   create_ann_index(db, "items_ann", "items", "embedding", ann_options{ 128 });
+//   db << "select rowid, distance from items_ann where embedding match ? and k = 10;" << query ...
+//
+// Rows whose embedding is NULL are not indexed. Embeddings of another size than `dimensions`
+// are rejected: creating the index fails if the base table holds one, and so do inserts and
+// updates of the base table that write one.
+//
+// The query vector is matched against a hidden column named like the indexed column, and
+// `items_ann(?, 10)` is a shorthand for the same query.
+//
+// The index clusters the embeddings around centroids that k-means finds when the index is
+// created, and a query scans only the lists of the `probes` centroids nearest to the query
+// vector. Results come in ascending Euclidean distance, and their rowids are those of the
+// base table. `probes = ?` overrides the default per query; more probes find more of the
+// true neighbours at the cost of latency.
+//
+// The index lives in the shadow tables <name>_config, <name>_centroids, <name>_vectors and
+// <name>_lists of the same database, and triggers on the base table keep it in sync, so
+// every connection that reads the index or writes the base table must call `define_ann`
+// first. The centroids are not retrained, so an index should be created after the bulk of
+// the data is loaded and recreated when the data drifts far from it. The base table must
+// have rowids.
+namespace sqlite {
+
+struct ann_options {
+  int dimensions;
+  // Number of centroids, zero for the square root of the number of rows.
+  int lists = 0;
+  // Lists scanned per query unless the query sets `probes`.
+  int probes = 8;
+};
+
+// Registers the module "ivf_flat" on `db`.
+void define_ann(const database& db);
+
+// Creates the index `name` over `column` of `table`, which is the same as
+// `create virtual table name using ivf_flat(table=..., column=..., dimensions=..., lists=...,
+// probes=...)`, and throws when creating it fails.
+void create_ann_index(const database& db, const std::string& name, const std::string& table, const std::string& column,
+                      const ann_options& options);
+
+}  // namespace sqlite
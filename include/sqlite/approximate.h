@@ -0,0 +1,65 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include "sqlite.h"
+
+namespace sqlite {
+
+// Streaming quantile sketch (merging t-digest). Values are buffered and merged into at most
+// about `compression` centroids, which are small near the tails so that extreme quantiles
+// stay accurate.
+class tdigest {
+private:
+  struct centroid {
+    double mean;
+    double weight;
+  };
+
+  double compression_;
+  std::vector<centroid> centroids_;
+  std::vector<double> buffer_;
+  double count_ = 0;
+  double min_ = 0;
+  double max_ = 0;
+
+  void merge();
+
+public:
+  explicit tdigest(double compression = 100);
+
+  void add(double value);
+
+  // Estimated value below which the given fraction of the values lies. Zero without values.
+  double quantile(double fraction);
+
+  std::uint64_t count() const {
+    return static_cast<std::uint64_t>(count_);
+  }
+};
+
+// Distinct count sketch (HyperLogLog) with 4096 registers and a standard error of about 1.6%.
+class hyperloglog {
+private:
+  static const int precision = 12;
+  std::array<std::uint8_t, 1 << precision> registers_ = {};
+
+public:
+  // Adds a value by its 64-bit hash.
+  void add(std::uint64_t hash);
+
+  std::uint64_t estimate() const;
+
+  // Hashes the bytes of a value.
+  static std::uint64_t hash(const void* data, std::size_t size);
+};
+
+// Registers the aggregate functions
+//   approx_quantile(x, q): the q-quantile of the non-NULL numbers x, using a t-digest
+//   approx_median(x): approx_quantile(x, 0.5)
+//   approx_count_distinct(x): the number of distinct non-NULL values x, using HyperLogLog
+// Integers and reals that are equal count as the same value.
+void define_approximate_aggregates(const database& db);
+
+}  // namespace sqlite
@@ -0,0 +1,79 @@
+#pragma once
+#include <chrono>
+#include <functional>
+#include <memory>
+
+#include "sqlite.h"
+
+namespace sqlite {
+
+struct backup_progress {
+  // Pages left to copy and the total number of pages of the source database.
+  int remaining = 0;
+  int total = 0;
+
+  // Number of times the backup started over because another connection changed the source.
+  std::size_t restarts = 0;
+
+  bool done = false;
+};
+
+struct backup_options {
+  // Pages copied per step. The source is locked only for the duration of a step.
+  int pages_per_step = 256;
+
+  // Maximum copy rate in MB/s. Zero copies as fast as possible.
+  double max_rate = 0;
+
+  // Time to wait before a step is retried when the source or destination is busy.
+  std::chrono::milliseconds retry{ 50 };
+
+  // Number of restarts after which the backup gives up, and `wait` throws, because the source
+  // changes faster than it is copied. Zero never gives up.
+  std::size_t max_restarts = 3;
+
+  // Copies the remaining pages in a single step after `max_restarts` restarts instead of
+  // giving up. The step holds the read lock on the source until the copy is complete, which
+  // blocks writers unless the source is in WAL mode.
+  bool lock_to_finish = false;
+
+  // Called on the backup thread after every step.
+  std::function<void(const backup_progress&)> progress;
+};
+
+// Online backup with `sqlite3_backup_step` on a background thread. Changes made through the
+// source connection are applied to the copy as it progresses. Changes made through other
+// connections restart the copy.
+//
+// The background thread steps the source connection, and the destination connection when it
+// is passed in, while the caller keeps using them. That is only safe in the serialized
+// threading mode (`SQLITE_CONFIG_SERIALIZED`, `threading_mode::serialized`), which is the
+// default of most builds but not of those compiled with SQLITE_THREADSAFE=2.
+class backup {
+private:
+  struct state;
+  std::shared_ptr<state> state_;
+
+  void stop();
+
+public:
+  backup(sqlite3* source, sqlite3* destination, bool owns_destination, const backup_options& options);
+
+  backup(backup&& other) = default;
+
+  // Cancels this backup like the destructor does before it takes over `other`.
+  backup& operator=(backup&& other);
+
+  // Cancels the backup if it is still running and waits for the thread to finish.
+  ~backup();
+
+  // Blocks until the backup is complete and throws if it failed or was moved from.
+  void wait();
+
+  // Stops the backup after the current step. The destination is left incomplete.
+  void cancel();
+
+  backup_progress progress() const;
+};
+
+}  // namespace sqlite
@@ -0,0 +1,96 @@
+#pragma once
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "sqlite.h"
+
+// Binding of arrays to the table-valued function "carray", which `define_carray` registers on
+// a connection, e.g.
+//
+//   define_carray(db);
+//   std::vector<sqlite3_int64> ids = ...;
+//   db << "select name from users where id in carray(?);" << carray(ids) >> ...
+//
+// One statement serves lists of any length, so it can be cached and reused where an IN list
+// with a parameter per element needs a statement per length. Elements can be `int`,
+// `sqlite3_int64`, `double`, `std::string` and `const char*`. The array is referenced, not
+// copied, and must neither change nor move until the statement is reset or finalized. It is
+// bound as a random handle that only statements of the same connection can resolve.
+// Table-valued functions need SQLite 3.9.0 or later at runtime.
+namespace sqlite {
+
+enum class array_type {
+  int32,
+  int64,
+  real,
+  text,
+  string,
+};
+
+template<typename T>
+struct array_type_of;
+
+template<>
+struct array_type_of<int> {
+  static const array_type value = array_type::int32;
+};
+
+template<>
+struct array_type_of<sqlite3_int64> {
+  static const array_type value = array_type::int64;
+};
+
+template<>
+struct array_type_of<double> {
+  static const array_type value = array_type::real;
+};
+
+template<>
+struct array_type_of<const char*> {
+  static const array_type value = array_type::text;
+};
+
+template<>
+struct array_type_of<std::string> {
+  static const array_type value = array_type::string;
+};
+
+template<typename T>
+struct array_view {
+  const T* data;
+  std::size_t size;
+};
+
+template<typename T>
+array_view<T> carray(const T* data, std::size_t size) {
+  return array_view<T>{ data, size };
+}
+
+template<typename T>
+array_view<T> carray(const std::vector<T>& values) {
+  return array_view<T>{ values.data(), values.size() };
+}
+
+// Registers the table-valued function "carray" on the connection. Calling it again on the same
+// connection has no effect.
+void define_carray(const database& db);
+
+// Registers an array with the connection and returns the handle that "carray" looks it up by.
+// Throws if carray is not defined on the connection.
+sqlite3_int64 register_array(sqlite3* db, array_type type, const void* data, std::size_t size);
+
+template<typename T>
+database_binder&& operator<<(database_binder&& db, array_view<T> values) {
+  auto handle = register_array(db.db_, array_type_of<T>::value, values.data, values.size);
+  try {
+    db.arrays_.push_back(handle);
+  }
+  catch (...) {
+    unregister_array(db.db_, handle);
+    throw;
+  }
+  return std::move(db) << handle;
+}
+
+}  // namespace sqlite
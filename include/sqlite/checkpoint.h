@@ -0,0 +1,90 @@
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+
+#include "sqlite.h"
+
+namespace sqlite {
+
+struct checkpoint_options {
+  // WAL size in pages that triggers a passive checkpoint.
+  int passive_pages = 1000;
+
+  // WAL size in pages at which the checkpoint waits for readers and restarts the WAL.
+  int restart_pages = 10000;
+
+  // WAL size in pages at which the WAL file is also truncated. Falls back to a restart
+  // checkpoint when the SQLite library is older than 3.8.8, which added truncate checkpoints.
+  int truncate_pages = 50000;
+
+  // Longest time a restart or truncate checkpoint waits for readers and writers.
+  std::chrono::milliseconds busy_timeout{ 100 };
+
+  // WAL size in pages of the automatic checkpoints that are restored when the checkpointer
+  // is destroyed. SQLite can not report the setting it replaces, so callers that changed it
+  // from the default pass their value here.
+  int autocheckpoint = 1000;
+};
+
+struct checkpoint_metrics {
+  // WAL size in pages reported by the last commit.
+  int wal_pages = 0;
+
+  // Pages moved back into the database by the last checkpoint.
+  int checkpointed_pages = 0;
+
+  std::uint64_t checkpoints = 0;
+  std::uint64_t restarts = 0;
+  std::uint64_t truncates = 0;
+
+  // Checkpoints that could not run to completion because of readers or writers.
+  std::uint64_t busy = 0;
+
+  std::chrono::microseconds last_duration{ 0 };
+  std::chrono::microseconds max_duration{ 0 };
+  std::chrono::microseconds total_duration{ 0 };
+};
+
+// Replaces the automatic checkpoints that run on the committing thread with checkpoints on a
+// background thread and a separate connection, which is opened with the same VFS. The WAL
+// size is tracked with `sqlite3_wal_hook`.
+// Passive checkpoints are escalated to restart and truncate checkpoints when readers keep
+// the WAL from being reset.
+class checkpointer {
+private:
+  sqlite3* db_ = nullptr;
+  sqlite3* connection_ = nullptr;
+  checkpoint_options options_;
+  checkpoint_metrics metrics_;
+
+  bool requested_ = false;
+  bool stopping_ = false;
+
+  mutable std::mutex mutex_;
+  std::condition_variable condition_;
+  std::thread thread_;
+
+  static int hook(void* data, sqlite3* db, const char* name, int pages);
+
+  void run();
+  void checkpoint(int pages);
+
+public:
+  checkpointer(const database& db, checkpoint_options options = {});
+
+  checkpointer(const checkpointer& other) = delete;
+  checkpointer& operator=(const checkpointer& other) = delete;
+
+  // Stops the background thread and restores automatic checkpoints.
+  ~checkpointer();
+
+  // Requests a checkpoint independent of the WAL size.
+  void request();
+
+  checkpoint_metrics metrics() const;
+};
+
+}  // namespace sqlite
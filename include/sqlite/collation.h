@@ -0,0 +1,22 @@
+#pragma once
+#include <cstddef>
+
+#include "sqlite.h"
+
+// Comparators for `database::define_collation`. They find the first difference of two strings
+// with AVX2 or SSE2 on x86-64, chosen at runtime, and byte by byte elsewhere. Only ASCII
+// letters are folded; other bytes, including UTF-8 sequences, compare by their value.
+namespace sqlite {
+
+// Orders like SQLite's NOCASE: case-insensitive for ASCII letters, then shorter first.
+int compare_nocase(const char* a, std::size_t a_size, const char* b, std::size_t b_size);
+
+// Like `compare_nocase`, but runs of digits compare by their numeric value, so that
+// "file9" < "file10". Numbers that only differ by leading zeros order fewer zeros first.
+int compare_natural(const char* a, std::size_t a_size, const char* b, std::size_t b_size);
+
+// Registers the collations "ascii_nocase" (`compare_nocase`) and "natural_nocase"
+// (`compare_natural`).
+void define_collations(const database& db);
+
+}  // namespace sqlite
@@ -0,0 +1,41 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+
+#include "sqlite.h"
+
+namespace sqlite {
+
+struct compressed_vfs_options {
+  // Registers the VFS as the default VFS.
+  bool make_default = false;
+};
+
+struct compression_statistics {
+  std::uint64_t pages_written = 0;
+  std::uint64_t pages_read = 0;
+
+  // Bytes of the pages that were written and the bytes that were stored for them.
+  std::uint64_t bytes_in = 0;
+  std::uint64_t bytes_out = 0;
+
+  std::chrono::nanoseconds compress_time{ 0 };
+  std::chrono::nanoseconds decompress_time{ 0 };
+
+  // `bytes_in` divided by `bytes_out`.
+  double ratio() const {
+    return bytes_out ? static_cast<double>(bytes_in) / static_cast<double>(bytes_out) : 0;
+  }
+};
+
+// Registers the "compressed" VFS and returns it. Pages of main database files are compressed
+// with an LZ4 block codec and appended to free space in the file. A page map locates them and
+// is written, together with a superblock that points to it, whenever SQLite syncs the file
+// or releases its locks. Journals and WAL files are passed on to the default VFS unchanged.
+// Open a database with `database(path, open_mode::read_write, "compressed")`. Files that were
+// not created by this VFS cannot be opened with it. The options of the first call are used.
+sqlite3_vfs* compressed_vfs(const compressed_vfs_options& options = {});
+
+compression_statistics compressed_vfs_statistics();
+
+}  // namespace sqlite
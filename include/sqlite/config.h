@@ -0,0 +1,88 @@
+#pragma once
+#include "allocator.h"
+#include "mutex.h"
+#include "pcache.h"
+#include "sqlite.h"
+
+namespace sqlite {
+
+enum class threading_mode {
+  unchanged,
+
+  // All mutexes are disabled. Connections must not be used by more than one thread.
+  single_thread,
+
+  // Connections and their statements must not be used by more than one thread at a time.
+  multi_thread,
+
+  // Connections can be used by any number of threads at the same time.
+  serialized,
+};
+
+enum class memory_allocator {
+  // The allocator that SQLite was compiled with, usually `malloc`.
+  system,
+
+  // The size-class pool allocator returned by `pool_allocator`.
+  pool,
+};
+
+enum class page_cache_implementation {
+  // The page cache that SQLite was compiled with.
+  system,
+
+  // The slab and CLOCK based page cache returned by `clock_page_cache`.
+  clock,
+};
+
+enum class mutex_implementation {
+  // The mutexes that SQLite was compiled with.
+  system,
+
+  // The spinning and parking mutexes returned by `futex_mutex`.
+  futex,
+};
+
+// Process-wide settings that are applied with `sqlite3_config` before the library is
+// initialized. Negative values leave the compile-time defaults in place.
+struct config {
+  threading_mode threading = threading_mode::unchanged;
+
+  memory_allocator allocator = memory_allocator::system;
+
+  mutex_implementation mutex = mutex_implementation::system;
+  futex_mutex_options futex;
+
+  page_cache_implementation page_cache = page_cache_implementation::system;
+  page_cache_options clock_cache;
+
+  // Memory usage statistics take a global mutex on every allocation when enabled.
+  // Zero disables them, one enables them.
+  int memstatus = -1;
+
+  // Default size and number of lookaside slots of each connection.
+  int lookaside_size = -1;
+  int lookaside_count = -1;
+
+  // Size and number of slots of a static page cache buffer that is allocated once for the
+  // whole process. Only used by the system page cache. The slot size must be a few bytes
+  // larger than the largest page size.
+  int page_cache_size = -1;
+  int page_cache_count = -1;
+
+  // Size and number of slots of a static scratch buffer. SQLite 3.21 and later no longer use
+  // scratch memory and these settings are ignored.
+  int scratch_size = -1;
+  int scratch_count = -1;
+
+  // Default and maximum number of bytes of each database file that are accessed through
+  // memory-mapped I/O. The maximum caps `database::mmap_size`.
+  sqlite3_int64 mmap_size = -1;
+  sqlite3_int64 mmap_limit = -1;
+};
+
+// Applies the settings and initializes the library. Throws if the library has already been
+// initialized, which happens implicitly when the first database is opened.
+void initialize(const config& options);
+
+}  // namespace sqlite
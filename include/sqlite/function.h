@@ -0,0 +1,336 @@
+#pragma once
+#include <cstring>
+#include <exception>
+#include <memory>
+#include <new>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "sqlite3.h"
+#include "utility/function_traits.h"
+
+// Conversions between the arguments and results of user-defined SQL functions and C++ types.
+// Arguments can be of any integral type, `float`, `double`, `std::string`, `std::u16string`,
+// `std::vector` of an arithmetic type for BLOBs and `const char*`, which points to the UTF-8
+// text of the argument for the duration of the call and avoids a copy. Integers other than
+// `int` and `bool` go through `sqlite3_int64`, so unsigned values above its maximum wrap.
+// NULL arguments become zero, empty strings, empty vectors or null pointers. `sqlite3_value*`
+// passes the argument on undecoded. Results can be any of these types except
+// `sqlite3_value*`, `void` and `std::nullptr_t` for NULL, or a `std::unique_ptr` of a result
+// type that is NULL when empty.
+namespace sqlite {
+
+inline void get_val_from_db(sqlite3_value* value, int& val) {
+  val = sqlite3_value_int(value);
+}
+
+inline void get_val_from_db(sqlite3_value* value, sqlite3_int64& val) {
+  val = sqlite3_value_int64(value);
+}
+
+inline void get_val_from_db(sqlite3_value* value, bool& val) {
+  val = sqlite3_value_int64(value) != 0;
+}
+
+template<typename T>
+typename std::enable_if<std::is_integral<T>::value>::type get_val_from_db(sqlite3_value* value, T& val) {
+  val = static_cast<T>(sqlite3_value_int64(value));
+}
+
+inline void get_val_from_db(sqlite3_value* value, float& val) {
+  val = float(sqlite3_value_double(value));
+}
+
+inline void get_val_from_db(sqlite3_value* value, double& val) {
+  val = sqlite3_value_double(value);
+}
+
+inline void get_val_from_db(sqlite3_value* value, const char*& val) {
+  val = reinterpret_cast<const char*>(sqlite3_value_text(value));
+}
+
+inline void get_val_from_db(sqlite3_value* value, std::string& val) {
+  auto text = reinterpret_cast<const char*>(sqlite3_value_text(value));
+  if (text) {
+    val.assign(text, static_cast<std::size_t>(sqlite3_value_bytes(value)));
+  } else {
+    val.clear();
+  }
+}
+
+inline void get_val_from_db(sqlite3_value* value, std::u16string& val) {
+  auto text = static_cast<const char16_t*>(sqlite3_value_text16(value));
+  if (text) {
+    val.assign(text, static_cast<std::size_t>(sqlite3_value_bytes16(value)) / sizeof(char16_t));
+  } else {
+    val.clear();
+  }
+}
+
+template<typename T>
+void get_val_from_db(sqlite3_value* value, std::vector<T>& val) {
+  static_assert(std::is_arithmetic<T>::value, "vectors are stored as BLOBs of arithmetic types");
+  auto data = sqlite3_value_blob(value);
+  val.resize(static_cast<std::size_t>(sqlite3_value_bytes(value)) / sizeof(T));
+  if (!val.empty()) {
+    std::memcpy(val.data(), data, val.size() * sizeof(T));
+  }
+}
+
+inline void get_val_from_db(sqlite3_value* value, sqlite3_value*& val) {
+  val = value;
+}
+
+inline void store_result_in_db(sqlite3_context* context, int val) {
+  sqlite3_result_int(context, val);
+}
+
+inline void store_result_in_db(sqlite3_context* context, sqlite3_int64 val) {
+  sqlite3_result_int64(context, val);
+}
+
+inline void store_result_in_db(sqlite3_context* context, bool val) {
+  sqlite3_result_int(context, val ? 1 : 0);
+}
+
+template<typename T>
+typename std::enable_if<std::is_integral<T>::value>::type store_result_in_db(sqlite3_context* context, T val) {
+  sqlite3_result_int64(context, static_cast<sqlite3_int64>(val));
+}
+
+inline void store_result_in_db(sqlite3_context* context, double val) {
+  sqlite3_result_double(context, val);
+}
+
+inline void store_result_in_db(sqlite3_context* context, const char* val) {
+  if (val) {
+    sqlite3_result_text(context, val, -1, SQLITE_TRANSIENT);
+  } else {
+    sqlite3_result_null(context);
+  }
+}
+
+inline void store_result_in_db(sqlite3_context* context, const std::string& val) {
+  sqlite3_result_text(context, val.data(), static_cast<int>(val.size()), SQLITE_TRANSIENT);
+}
+
+inline void store_result_in_db(sqlite3_context* context, const std::u16string& val) {
+  sqlite3_result_text16(context, val.data(), static_cast<int>(val.size() * sizeof(char16_t)), SQLITE_TRANSIENT);
+}
+
+template<typename T>
+void store_result_in_db(sqlite3_context* context, const std::vector<T>& val) {
+  static_assert(std::is_arithmetic<T>::value, "vectors are stored as BLOBs of arithmetic types");
+  const void* data = val.empty() ? "" : static_cast<const void*>(val.data());
+  sqlite3_result_blob(context, data, static_cast<int>(val.size() * sizeof(T)), SQLITE_TRANSIENT);
+}
+
+inline void store_result_in_db(sqlite3_context* context, std::nullptr_t) {
+  sqlite3_result_null(context);
+}
+
+template<typename T>
+void store_result_in_db(sqlite3_context* context, const std::unique_ptr<T>& val) {
+  if (val) {
+    store_result_in_db(context, *val);
+  } else {
+    sqlite3_result_null(context);
+  }
+}
+
+// Decodes the arguments of a call one by one and passes them to the function, like `binder`
+// does with the columns of a row.
+template<std::size_t Count>
+class function_binder {
+private:
+  template<typename Function, std::size_t Index>
+  using nth_argument_type = typename std::decay<typename utility::function_traits<Function>::template argument<Index>>::type;
+
+  template<typename Function, typename... Values>
+  static void call(std::false_type, sqlite3_context* context, Function& function, Values&&... values) {
+    store_result_in_db(context, function(std::move(values)...));
+  }
+
+  template<typename Function, typename... Values>
+  static void call(std::true_type, sqlite3_context* context, Function& function, Values&&... values) {
+    function(std::move(values)...);
+    sqlite3_result_null(context);
+  }
+
+public:
+  template<typename Function, typename... Values, std::size_t Boundary = Count>
+  static typename std::enable_if<(sizeof...(Values) < Boundary), void>::type
+  run(sqlite3_context* context, sqlite3_value** arguments, Function& function, Values&&... values) {
+    nth_argument_type<Function, sizeof...(Values)> value{};
+    get_val_from_db(arguments[sizeof...(Values)], value);
+    run<Function>(context, arguments, function, std::forward<Values>(values)..., std::move(value));
+  }
+
+  template<typename Function, typename... Values, std::size_t Boundary = Count>
+  static typename std::enable_if<(sizeof...(Values) == Boundary), void>::type
+  run(sqlite3_context* context, sqlite3_value**, Function& function, Values&&... values) {
+    typedef typename utility::function_traits<Function>::result_type result_type;
+    call(std::is_void<result_type>(), context, function, std::forward<Values>(values)...);
+  }
+};
+
+// Runs `call` and reports its exceptions as SQL errors of the function call.
+template<typename Call>
+void guarded(sqlite3_context* context, Call&& call) {
+  try {
+    call();
+  }
+  catch (const std::exception& e) {
+    sqlite3_result_error(context, e.what(), -1);
+  }
+  catch (...) {
+    sqlite3_result_error(context, "unknown exception in user-defined function", -1);
+  }
+}
+
+// Callbacks of a scalar function whose function object is the user data of the function.
+template<typename Function>
+struct scalar_function {
+  static void call(sqlite3_context* context, int, sqlite3_value** arguments) {
+    auto& function = *static_cast<Function*>(sqlite3_user_data(context));
+    guarded(context, [&]() {
+      function_binder<utility::function_traits<Function>::arity>::run(context, arguments, function);
+    });
+  }
+
+  static void destroy(void* function) {
+    delete static_cast<Function*>(function);
+  }
+};
+
+// Callbacks of a collation whose comparator is the user data of the collation. Comparators
+// take the UTF-8 text and size of both strings and return a negative number, zero or a
+// positive number. Exceptions cannot be reported from a comparison and terminate.
+template<typename Compare>
+struct collation_function {
+  static int compare(void* comparator, int a_size, const void* a, int b_size, const void* b) noexcept {
+    auto& function = *static_cast<Compare*>(comparator);
+    return function(static_cast<const char*>(a), static_cast<std::size_t>(a_size), static_cast<const char*>(b),
+                    static_cast<std::size_t>(b_size));
+  }
+
+  static void destroy(void* comparator) {
+    delete static_cast<Compare*>(comparator);
+  }
+};
+
+// A member function bound to an object, with the signature of the member function.
+template<typename Method>
+struct bound_method;
+
+template<typename Class, typename Result, typename... Arguments>
+struct bound_method<Result(Class::*)(Arguments...)> {
+  Class* self;
+  Result(Class::*method)(Arguments...);
+
+  Result operator()(Arguments... arguments) const {
+    return (self->*method)(std::forward<Arguments>(arguments)...);
+  }
+};
+
+// Whether an aggregate can be removed from a window frame, see `database::define_aggregate`.
+template<typename Aggregate, typename = void>
+struct is_window_aggregate : std::false_type {
+};
+
+template<typename Aggregate>
+struct is_window_aggregate<Aggregate, decltype((void)&Aggregate::inverse, (void)&Aggregate::value)> : std::true_type {
+};
+
+// Callbacks of an aggregate function. The aggregate object of a group is constructed in the
+// memory of `sqlite3_aggregate_context` by the first step and destroyed by the final call.
+template<typename Aggregate>
+struct aggregate_function {
+  static_assert(alignof(Aggregate) <= 8, "SQLite aligns aggregate contexts to 8 bytes");
+
+  struct state {
+    // Null until the first step.
+    Aggregate* aggregate;
+    typename std::aligned_storage<sizeof(Aggregate), alignof(Aggregate)>::type storage;
+  };
+
+  static Aggregate* get(sqlite3_context* context, bool create) {
+    auto s = static_cast<state*>(sqlite3_aggregate_context(context, create ? sizeof(state) : 0));
+    if (!s) {
+      return nullptr;
+    }
+    if (!s->aggregate && create) {
+      s->aggregate = new (&s->storage) Aggregate();
+    }
+    return s->aggregate;
+  }
+
+  template<typename Method>
+  static void invoke(sqlite3_context* context, sqlite3_value** arguments, Method method) {
+    auto aggregate = get(context, true);
+    if (!aggregate) {
+      sqlite3_result_error_nomem(context);
+      return;
+    }
+    bound_method<Method> bound{ aggregate, method };
+    function_binder<utility::function_traits<bound_method<Method>>::arity>::run(context, arguments, bound);
+  }
+
+  static void step(sqlite3_context* context, int, sqlite3_value** arguments) {
+    guarded(context, [&]() {
+      invoke(context, arguments, &Aggregate::step);
+    });
+  }
+
+  static void inverse(sqlite3_context* context, int, sqlite3_value** arguments) {
+    guarded(context, [&]() {
+      invoke(context, arguments, &Aggregate::inverse);
+    });
+  }
+
+  static void value(sqlite3_context* context) {
+    guarded(context, [&]() {
+      auto aggregate = get(context, true);
+      if (!aggregate) {
+        sqlite3_result_error_nomem(context);
+        return;
+      }
+      store_result_in_db(context, aggregate->value());
+    });
+  }
+
+  static void finish(sqlite3_context* context) {
+    auto s = static_cast<state*>(sqlite3_aggregate_context(context, 0));
+    if (!s || !s->aggregate) {
+      // No rows were aggregated.
+      guarded(context, [&]() {
+        Aggregate empty;
+        store_result_in_db(context, empty.final());
+      });
+      return;
+    }
+    guarded(context, [&]() {
+      store_result_in_db(context, s->aggregate->final());
+    });
+    s->aggregate->~Aggregate();
+    s->aggregate = nullptr;
+  }
+
+  static int create(sqlite3* db, const char* name, int flags, std::false_type) {
+    return sqlite3_create_function_v2(db, name, static_cast<int>(utility::function_traits<decltype(&Aggregate::step)>::arity), flags, nullptr,
+                                      nullptr, step, finish, nullptr);
+  }
+
+  static int create(sqlite3* db, const char* name, int flags, std::true_type) {
+#if SQLITE_VERSION_NUMBER >= 3025000
+    return sqlite3_create_window_function(db, name, static_cast<int>(utility::function_traits<decltype(&Aggregate::step)>::arity), flags, nullptr,
+                                          step, finish, value, inverse, nullptr);
+#else
+    return create(db, name, flags, std::false_type());
+#endif
+  }
+};
+
+}  // namespace sqlite
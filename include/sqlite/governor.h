@@ -0,0 +1,83 @@
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "sqlite.h"
+
+namespace sqlite {
+
+struct governor_options {
+  // Process-wide memory budget in bytes. Also installed as the soft heap limit.
+  sqlite3_int64 budget = 0;
+
+  // Fraction of the budget at which caches of idle connections are released.
+  double threshold = 0.9;
+
+  // Interval of the background check. Zero disables the background thread and leaves the
+  // checks to `check`.
+  std::chrono::milliseconds interval{ 1000 };
+};
+
+struct memory_pressure {
+  sqlite3_int64 budget = 0;
+
+  // Memory in use before and after caches were released.
+  sqlite3_int64 before = 0;
+  sqlite3_int64 after = 0;
+
+  // Number of connections whose caches were released.
+  std::size_t released = 0;
+};
+
+// Keeps the memory used by SQLite within a process-wide budget. When usage crosses the
+// threshold, the page caches of attached connections are released in order of their last
+// use until usage is back below the threshold, and the pressure callbacks are called.
+//
+// Caches are released from the background thread, which requires the serialized threading
+// mode. In other modes set the interval to zero and call `check` from a thread that may use
+// all attached connections.
+class memory_governor {
+private:
+  governor_options options_;
+  sqlite3_int64 previous_limit_ = 0;
+
+  std::vector<const database*> databases_;
+  std::vector<std::function<void(const memory_pressure&)>> callbacks_;
+
+  bool stopping_ = false;
+  mutable std::mutex mutex_;
+  std::condition_variable condition_;
+  std::thread thread_;
+
+  sqlite3_int64 usage() const;
+
+public:
+  memory_governor(governor_options options);
+
+  memory_governor(const memory_governor& other) = delete;
+  memory_governor& operator=(const memory_governor& other) = delete;
+
+  // Stops the background thread and restores the previous soft heap limit.
+  ~memory_governor();
+
+  // Connections must be detached before they are destroyed.
+  void attach(const database& db);
+  void detach(const database& db);
+
+  // Callbacks are called on the thread that runs the check, after caches were released.
+  void on_pressure(std::function<void(const memory_pressure&)> callback);
+
+  // Enforces the budget and returns the number of bytes that were released.
+  sqlite3_int64 check();
+
+  // Memory used by SQLite. Falls back to the sum of the page caches of attached connections
+  // when memory statistics are disabled.
+  sqlite3_int64 used() const;
+};
+
+}  // namespace sqlite
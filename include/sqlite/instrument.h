@@ -0,0 +1,75 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "sqlite.h"
+
+namespace sqlite {
+
+enum class file_kind {
+  main,
+  wal,
+  journal,
+  other,
+};
+
+enum class io_operation {
+  read,
+  write,
+  sync,
+  lock,
+};
+
+struct io_histogram {
+  std::uint64_t count = 0;
+  std::uint64_t bytes = 0;
+  std::chrono::nanoseconds time{ 0 };
+
+  // Number of operations that took less than 2^(i+1) and at least 2^i nanoseconds.
+  std::uint64_t buckets[40] = {};
+
+  // Upper bound of the latency below which the given fraction of the operations completed.
+  std::chrono::nanoseconds percentile(double fraction) const;
+};
+
+struct file_statistics {
+  std::string path;
+  file_kind kind = file_kind::other;
+
+  // Indexed by `io_operation`. Locks include shared memory locks of WAL databases.
+  io_histogram operations[4];
+};
+
+struct instrumented_vfs_options {
+  // Name of the VFS that is wrapped. Defaults to the default VFS, but may name another shim
+  // such as "compressed".
+  const char* wrap = nullptr;
+
+  // Registers the VFS as the default VFS.
+  bool make_default = false;
+};
+
+// Registers the "instrumented" VFS and returns it. It passes every call on to the wrapped VFS
+// and records counts, bytes and a log2 latency histogram per file and operation with relaxed
+// atomic counters. Statistics are kept by path and accumulate over all connections that
+// open the file. The options of the first call are used.
+sqlite3_vfs* instrumented_vfs(const instrumented_vfs_options& options = {});
+
+// Statistics of all files that were opened through the VFS.
+std::vector<file_statistics> instrumented_vfs_statistics();
+
+// Resets all counters to zero.
+void reset_instrumented_vfs_statistics();
+
+enum class export_format {
+  json,
+
+  // Prometheus text exposition format with one histogram per file and operation.
+  prometheus,
+};
+
+std::string export_statistics(const std::vector<file_statistics>& statistics, export_format format);
+
+}  // namespace sqlite
@@ -0,0 +1,42 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "sqlite.h"
+
+namespace sqlite {
+
+struct futex_mutex_options {
+  // Number of times a contended lock is retried before the thread is parked.
+  int spin = 100;
+
+  // Counts acquisitions, contended acquisitions and their wait time per mutex.
+  bool statistics = false;
+};
+
+struct mutex_statistics {
+  // Name of a static SQLite mutex, or "fast" and "recursive" for the totals of all mutexes
+  // that SQLite allocates per connection, per database file and so on.
+  std::string name;
+
+  std::uint64_t acquires = 0;
+
+  // Acquisitions that found the mutex locked, whether they then spun or parked, and the time
+  // they took to acquire it.
+  std::uint64_t contended = 0;
+  std::chrono::nanoseconds wait{ 0 };
+};
+
+// Mutex implementation for `SQLITE_CONFIG_MUTEX` that spins briefly on contention and then
+// parks the thread on a futex. Every mutex occupies its own cache line. Platforms without
+// futexes yield the thread instead of parking it. The options apply to all mutexes. Install
+// it with `config::mutex` or pass the methods to `sqlite3_config` directly.
+const sqlite3_mutex_methods* futex_mutex(const futex_mutex_options& options);
+
+// Returns counters for the static mutexes and totals for the dynamic ones. Counters are
+// only collected when `futex_mutex_options::statistics` is set.
+std::vector<mutex_statistics> futex_mutex_statistics();
+
+}  // namespace sqlite
@@ -0,0 +1,40 @@
+#pragma once
+#include <cstdint>
+
+#include "sqlite.h"
+
+namespace sqlite {
+
+struct page_cache_options {
+  // Allocates large slabs from 2 MiB huge pages where the operating system supports it.
+  bool huge_pages = false;
+
+  // Maximum number of bytes of slabs allocated for pages by all connections together. When
+  // the budget is exhausted, a connection recycles its own least recently referenced pages
+  // first and then those of other connections with the same page size. Zero limits each
+  // connection by its `cache_size` instead.
+  std::size_t budget = 0;
+};
+
+struct page_cache_statistics {
+  std::uint64_t hits = 0;
+  std::uint64_t misses = 0;
+  std::uint64_t evictions = 0;
+
+  // Pages currently cached and the bytes that are used for them.
+  std::uint64_t pages = 0;
+  std::uint64_t bytes = 0;
+
+  // Bytes allocated for slabs, including free slots.
+  std::uint64_t reserved = 0;
+};
+
+// Page cache for `SQLITE_CONFIG_PCACHE2` that stores pages in slabs and evicts them with the
+// CLOCK algorithm, which only sets a bit when a cached page is fetched. The options apply to
+// all caches. Install it with `config::page_cache` or pass the methods to `sqlite3_config`
+// directly.
+const sqlite3_pcache_methods2* clock_page_cache(const page_cache_options& options);
+
+page_cache_statistics clock_page_cache_statistics();
+
+}  // namespace sqlite
@@ -0,0 +1,52 @@
+#pragma once
+#include <cstdint>
+
+#include "sqlite.h"
+
+namespace sqlite {
+
+struct readahead_vfs_options {
+  // Size and alignment of the blocks in the cache.
+  std::size_t block_size = 64 * 1024;
+
+  // Bytes of blocks that are kept in the cache shared by all files of the VFS.
+  std::size_t cache_size = 64 * 1024 * 1024;
+
+  // Readahead starts with two blocks and doubles up to this many bytes while the stream of
+  // reads stays sequential.
+  std::size_t max_window = 4 * 1024 * 1024;
+
+  // Number of consecutive forward reads after which readahead starts. Reads count as
+  // forward when they start no further than a block or the current window, whichever is
+  // larger, after the end of the previous read.
+  int sequential_reads = 4;
+
+  // Registers the VFS as the default VFS.
+  bool make_default = false;
+};
+
+struct readahead_statistics {
+  // Reads of main database files that were served from the cache and those that were not.
+  std::uint64_t hits = 0;
+  std::uint64_t misses = 0;
+
+  std::uint64_t readaheads = 0;
+  std::uint64_t bytes_read_ahead = 0;
+
+  std::uint64_t evictions = 0;
+
+  // Number of times all blocks of a file were dropped because another connection changed it.
+  std::uint64_t invalidations = 0;
+};
+
+// Registers the "readahead" VFS and returns it. Reads of main database files are tracked per
+// connection, and once they form a forward stream they are served from large aligned reads
+// that fill a shared block cache. Random reads bypass the cache. Writes through the VFS drop
+// the cached blocks they touch, and changes of other processes are detected through the file
+// change counter or the WAL index when a read transaction starts. All other files and
+// operations are passed on to the default VFS. The options of the first call are used.
+sqlite3_vfs* readahead_vfs(const readahead_vfs_options& options = {});
+
+readahead_statistics readahead_vfs_statistics();
+
+}  // namespace sqlite
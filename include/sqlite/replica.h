@@ -0,0 +1,60 @@
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "sqlite.h"
+
+namespace sqlite {
+
+struct replica_options {
+  // Interval at which the file is checked for changes. Zero disables scheduled refreshes.
+  std::chrono::milliseconds refresh{ 0 };
+};
+
+// Serves a database file from an in-memory copy. A refresh loads a new copy next to the
+// current one and swaps them atomically. Readers keep the generation they obtained from
+// `get` alive until they release it and are never blocked by a refresh.
+class replica {
+private:
+  std::string path_;
+  replica_options options_;
+  sqlite3* source_ = nullptr;
+  sqlite3_int64 version_ = -1;
+
+  std::shared_ptr<database> current_;
+  std::uint64_t generation_ = 0;
+
+  bool stopping_ = false;
+  mutable std::mutex mutex_;
+  std::mutex refresh_mutex_;
+  std::condition_variable condition_;
+  std::thread thread_;
+
+  sqlite3_int64 data_version();
+  void run();
+
+public:
+  replica(const std::string& path, replica_options options = {});
+
+  replica(const replica& other) = delete;
+  replica& operator=(const replica& other) = delete;
+
+  ~replica();
+
+  // Returns the current generation.
+  std::shared_ptr<database> get() const;
+
+  // Loads a new generation if the file changed since the last load. Returns true when the
+  // generation was replaced.
+  bool refresh();
+
+  // Number of loaded generations, starting at one.
+  std::uint64_t generation() const;
+};
+
+}  // namespace sqlite
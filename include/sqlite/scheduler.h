@@ -0,0 +1,133 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "sqlite.h"
+
+namespace sqlite {
+
+enum class priority : std::size_t {
+  high,
+  normal,
+  low,
+};
+
+struct scheduler_options {
+  // Number of connections opened to the database.
+  std::size_t connections = 4;
+
+  // Maximum number of connections that each priority class may hold at the same time,
+  // indexed by `priority`. Keeping the low limit below `connections` reserves capacity
+  // for latency-critical work.
+  std::size_t limits[3] = { 4, 4, 2 };
+
+  // A waiting request is treated as one class higher for every `aging` interval it waits.
+  std::chrono::milliseconds aging{ 250 };
+
+  // Number of virtual machine instructions between progress handler invocations.
+  int yield_interval = 1000;
+
+  // Interrupt the statements of lower classes while a request of a higher class waits for a
+  // connection. Pausing them instead would keep their locks, which can block the very work
+  // they yield to. An interrupted statement is aborted, not paused: it fails with
+  // SQLITE_INTERRUPT, and SQLite rolls back the transaction it was part of. Requests that
+  // aged into a higher class are preempted as that class.
+  bool preempt = true;
+};
+
+// Runs work on a fixed set of connections to the same database in priority order.
+class scheduler {
+private:
+  struct slot {
+    scheduler* owner = nullptr;
+    std::unique_ptr<database> db;
+    priority current = priority::normal;
+    // Class that the request had reached by aging when it got the connection.
+    std::size_t rank = 0;
+    bool busy = false;
+  };
+
+  struct waiter {
+    priority level;
+    std::chrono::steady_clock::time_point since;
+    std::uint64_t ticket;
+  };
+
+  scheduler_options options_;
+  std::vector<std::unique_ptr<slot>> slots_;
+  std::vector<waiter> waiters_;
+  std::uint64_t next_ticket_ = 0;
+  std::atomic<std::size_t> running_[3];
+  std::atomic<std::size_t> waiting_[3];
+
+  mutable std::mutex mutex_;
+  std::condition_variable released_;
+
+  static std::size_t index(priority level) {
+    return static_cast<std::size_t>(level);
+  }
+
+  static int progress(void* data);
+
+  bool eligible(const waiter& w) const;
+  std::size_t effective(const waiter& w, std::chrono::steady_clock::time_point now) const;
+  bool next(const waiter& w) const;
+
+  slot& acquire(priority level);
+  void release(slot& s);
+
+  class lease {
+  private:
+    scheduler& owner_;
+    slot& slot_;
+
+  public:
+    lease(scheduler& owner, priority level) : owner_(owner), slot_(owner.acquire(level)) {
+    }
+
+    lease(const lease& other) = delete;
+    lease& operator=(const lease& other) = delete;
+
+    ~lease() {
+      owner_.release(slot_);
+    }
+
+    database& db() const {
+      return *slot_.db;
+    }
+  };
+
+public:
+  scheduler(const std::string& db_name, scheduler_options options = {});
+
+  scheduler(const scheduler& other) = delete;
+  scheduler& operator=(const scheduler& other) = delete;
+
+  ~scheduler();
+
+  // Blocks until a connection is available to the given priority class and calls
+  // `function` with it. The connection is returned to the scheduler when `function` returns
+  // or throws. With `preempt`, a statement of `function` is aborted with SQLITE_INTERRUPT,
+  // and its transaction rolled back, when a request of a higher class starts waiting; the
+  // caller decides whether to run it again.
+  template<typename Function>
+  auto run(priority level, Function&& function) -> decltype(function(std::declval<database&>())) {
+    lease l(*this, level);
+    return function(l.db());
+  }
+
+  // Number of requests of the given class that are waiting for a connection.
+  std::size_t waiting(priority level) const;
+
+  // Number of connections currently held by the given class.
+  std::size_t running(priority level) const;
+};
+
+}  // namespace sqlite
@@ -1,12 +1,21 @@
 #pragma once
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <codecvt>
+#include <cstring>
 #include <locale>
+#include <memory>
 #include <string>
 #include <functional>
+#include <iterator>
 #include <stdexcept>
+#include <unordered_map>
+#include <vector>
 #include <ctime>
 
 #include "sqlite3.h"
+#include "function.h"
 #include "utility/function_traits.h"
 
 namespace sqlite {
@@ -29,10 +38,57 @@ struct sqlite_exception : public std::runtime_error {
 
 class database;
 class database_binder;
+class transaction;
+class savepoint;
+class backup;
+struct backup_options;
+struct file_statistics;
+
+struct cached_statement {
+  sqlite3_stmt* stmt;
+  bool busy;
+};
+
+enum class transaction_mode {
+  deferred,
+  immediate,
+  exclusive,
+};
+
+// Access pattern hints for memory-mapped database files.
+enum class open_mode {
+  read_write,
+
+  // Read-only access to a file that is never modified while it is open. No file locks are
+  // taken and no hot journal or schema change checks are made.
+  immutable,
+};
+
+enum class mmap_advice {
+  normal,
+  sequential,
+  random,
+  willneed,
+};
 
 template<std::size_t>
 class binder;
 
+template<typename T>
+struct array_view;
+
+template<typename T>
+struct is_vector : std::false_type {
+};
+
+template<typename T, typename Allocator>
+struct is_vector<std::vector<T, Allocator>> : std::true_type {
+};
+
+// Arrays are bound to statements as handles of a registry that the "carray" table looks them
+// up in, since this version of SQLite cannot bind pointers. See `carray.h`.
+void unregister_array(sqlite3* db, sqlite3_int64 handle);
+
 template<typename T>
 database_binder&& operator<<(database_binder&& db, const T&& val);
 
@@ -41,11 +97,18 @@ void get_col_from_db(database_binder& db, int index, T& val);
 
 class database_binder {
 private:
+  const database* const owner_ = nullptr;
   sqlite3* const db_ = nullptr;
   std::u16string sql_;
   sqlite3_stmt* stmt_ = nullptr;
   int index_ = 1;
 
+  // Set when the statement is borrowed from the statement cache of an immutable database.
+  cached_statement* cached_ = nullptr;
+
+  // Handles of the arrays that are bound to the statement.
+  std::vector<sqlite3_int64> arrays_;
+
   bool throw_exceptions_ = true;
   bool error_occured_ = false;
 
@@ -60,11 +123,9 @@ private:
       throw_sqlite_error();
     }
 
-    if (sqlite3_finalize(stmt_) != SQLITE_OK) {
+    if (finish() != SQLITE_OK) {
       throw_sqlite_error();
     }
-
-    stmt_ = nullptr;
   }
 
   void extract_single_value(std::function<void(void)> call_back) {
@@ -82,13 +143,14 @@ private:
       throw_sqlite_error();
     }
 
-    if (sqlite3_finalize(stmt_) != SQLITE_OK) {
+    if (finish() != SQLITE_OK) {
       throw_sqlite_error();
     }
-
-    stmt_ = nullptr;
   }
 
+  // Finalizes the statement or resets it and returns it to the statement cache.
+  int finish();
+
   void prepare() {
     if (sqlite3_prepare16_v2(db_, sql_.data(), -1, &stmt_, nullptr) != SQLITE_OK) {                                    
       throw_sqlite_error();
@@ -102,7 +164,8 @@ private:
     || std::is_integral<Type>::value
     || std::is_same<std::string, Type>::value
     || std::is_same<std::u16string, Type>::value
-    || std::is_same<sqlite_int64, Type>::value>;
+    || std::is_same<sqlite_int64, Type>::value
+    || is_vector<Type>::value>;
 
   template<typename T>
   friend database_binder&& operator<<(database_binder&& ddb, const T&& val);
@@ -110,17 +173,24 @@ private:
   template<typename T>
   friend void get_col_from_db(database_binder& ddb, int index, T& val);
 
+  template<typename T>
+  friend database_binder&& operator<<(database_binder&& ddb, array_view<T> values);
+
+  template<typename T>
+  friend database_binder&& operator<<(database_binder&& ddb, const std::vector<T>& vec);
+
+  template<typename T>
+  friend void get_col_from_db(database_binder& ddb, int index, std::vector<T>& vec);
+
 protected:
-  database_binder(sqlite3* db, const std::u16string& sql) : db_(db), sql_(sql) {
-    prepare();
-  }
+  database_binder(const database* owner, sqlite3* db, const std::u16string& sql);
 
-  database_binder(sqlite3* db, const std::string& sql) : database_binder(db, conv(sql)) {
+  database_binder(const database* owner, sqlite3* db, const std::string& sql) : database_binder(owner, db, conv(sql)) {
   }
 
 #ifdef _MSC_VER
-  database_binder(sqlite3* db, const std::wstring& sql) : db_(db), sql_(sql.begin(), sql.end()) {
-    prepare();
+  database_binder(const database* owner, sqlite3* db, const std::wstring& sql)
+    : database_binder(owner, db, std::u16string(sql.begin(), sql.end())) {
   }
 #endif
 
@@ -140,11 +210,9 @@ public:
         throw_sqlite_error();
       }
 
-      if (sqlite3_finalize(stmt_) != SQLITE_OK) {
+      if (finish() != SQLITE_OK) {
         throw_sqlite_error();
       }
-
-      stmt_ = nullptr;
     }
   }
 
@@ -185,6 +253,230 @@ private:
   bool connected_;
   bool ownes_db_;
 
+  // Transaction control statements are prepared once and reused.
+  struct savepoint_statements {
+    sqlite3_stmt* save = nullptr;
+    sqlite3_stmt* release = nullptr;
+    sqlite3_stmt* rollback = nullptr;
+  };
+
+  mutable sqlite3_stmt* begin_[3] = {};
+  mutable sqlite3_stmt* commit_ = nullptr;
+  mutable sqlite3_stmt* rollback_ = nullptr;
+  mutable std::vector<savepoint_statements> savepoints_;
+  mutable std::size_t savepoint_depth_ = 0;
+
+  // Statements of immutable databases are prepared once and reset after use.
+  bool immutable_ = false;
+  mutable std::unordered_map<std::u16string, cached_statement> statements_;
+
+  // Consecutive writes outside of explicit transactions are grouped when batching is enabled.
+  std::size_t batch_limit_ = 0;
+  std::chrono::milliseconds batch_interval_{ 0 };
+  mutable std::size_t batch_count_ = 0;
+  mutable std::chrono::steady_clock::time_point batch_start_;
+  mutable bool batch_open_ = false;
+
+  // Error of a batch that was lost, i.e. rolled back by SQLite or by a failed implicit
+  // commit, which the next `flush` throws.
+  mutable std::string batch_error_;
+
+  // Time of the last statement in steady clock ticks, read by other threads.
+  mutable std::atomic<std::chrono::steady_clock::rep> last_used_{ std::chrono::steady_clock::now().time_since_epoch().count() };
+
+  friend class database_binder;
+  friend class transaction;
+  friend class savepoint;
+
+  void execute(sqlite3_stmt*& stmt, const std::string& sql) const {
+    if (!stmt && sqlite3_prepare_v2(db_, sql.data(), -1, &stmt, nullptr) != SQLITE_OK) {
+      throw sqlite_exception(sqlite3_errmsg(db_));
+    }
+    if (sqlite3_step(stmt) != SQLITE_DONE) {
+      sqlite_exception e(sqlite3_errmsg(db_));
+      sqlite3_reset(stmt);
+      throw e;
+    }
+    sqlite3_reset(stmt);
+  }
+
+  void begin(transaction_mode mode) const {
+    static const char* sql[] = { "begin deferred;", "begin immediate;", "begin exclusive;" };
+    auto index = static_cast<std::size_t>(mode);
+    execute(begin_[index], sql[index]);
+  }
+
+  void commit() const {
+    execute(commit_, "commit;");
+    savepoint_depth_ = 0;
+  }
+
+  void rollback() const {
+    execute(rollback_, "rollback;");
+    savepoint_depth_ = 0;
+  }
+
+  std::size_t save() const {
+    auto depth = savepoint_depth_;
+    if (savepoints_.size() <= depth) {
+      savepoints_.resize(depth + 1);
+    }
+    execute(savepoints_[depth].save, "savepoint s" + std::to_string(depth) + ";");
+    savepoint_depth_++;
+    return depth;
+  }
+
+  void release(std::size_t depth) const {
+    execute(savepoints_[depth].release, "release s" + std::to_string(depth) + ";");
+    savepoint_depth_ = depth;
+  }
+
+  void rollback(std::size_t depth) const {
+    execute(savepoints_[depth].rollback, "rollback to s" + std::to_string(depth) + ";");
+    release(depth);
+  }
+
+  // Returns the cached statement for `sql`, preparing it on first use. Returns null when the
+  // statement is still in use, i.e. by a nested query.
+  cached_statement* checkout(const std::u16string& sql) const {
+    auto it = statements_.find(sql);
+    if (it == statements_.end()) {
+      sqlite3_stmt* stmt = nullptr;
+      if (sqlite3_prepare16_v2(db_, sql.data(), -1, &stmt, nullptr) != SQLITE_OK) {
+        throw sqlite_exception(sqlite3_errmsg(db_));
+      }
+      if (!sqlite3_stmt_readonly(stmt)) {
+        sqlite3_finalize(stmt);
+        throw sqlite_exception("attempt to write an immutable database");
+      }
+      it = statements_.emplace(sql, cached_statement{ stmt, false }).first;
+    }
+    if (it->second.busy) {
+      return nullptr;
+    }
+    it->second.busy = true;
+    return &it->second;
+  }
+
+  // Called by `database_binder` for every statement before it is executed.
+  void prepared(sqlite3_stmt* stmt) const {
+    auto now = std::chrono::steady_clock::now();
+    last_used_.store(now.time_since_epoch().count(), std::memory_order_relaxed);
+    if (immutable_ && !sqlite3_stmt_readonly(stmt)) {
+      throw sqlite_exception("attempt to write an immutable database");
+    }
+    if (batch_limit_ == 0) {
+      return;
+    }
+    if (batch_open_ && sqlite3_get_autocommit(db_)) {
+      // SQLite rolled the batch back, i.e. after an I/O error or an `or rollback` conflict.
+      batch_open_ = false;
+      batch_error_ = "batch was rolled back";
+    }
+
+    // Reads and transaction control statements end the current batch.
+    if (sqlite3_stmt_readonly(stmt)) {
+      try_flush();
+      return;
+    }
+
+    if (batch_open_ && (batch_count_ >= batch_limit_ || now - batch_start_ >= batch_interval_)) {
+      try_flush();
+    }
+
+    if (!batch_open_) {
+      // Never interfere with transactions that were started explicitly.
+      if (!sqlite3_get_autocommit(db_)) {
+        return;
+      }
+      begin(transaction_mode::immediate);
+      batch_open_ = true;
+      batch_start_ = now;
+      batch_count_ = 0;
+    }
+    batch_count_++;
+  }
+
+  // Commits the current batch unless a statement is still running, in which case the batch
+  // stays open and is committed later. A batch that is lost is recorded for `flush`.
+  void try_flush() const {
+    if (batch_open_) {
+      try {
+        flush();
+      }
+      catch (const sqlite_exception& e) {
+        if (!batch_open_) {
+          batch_error_ = e.what();
+        }
+      }
+    }
+  }
+
+  void finalize() {
+    try_flush();
+    for (auto& stmt : begin_) {
+      sqlite3_finalize(stmt);
+      stmt = nullptr;
+    }
+    sqlite3_finalize(commit_);
+    sqlite3_finalize(rollback_);
+    commit_ = nullptr;
+    rollback_ = nullptr;
+    for (auto& statements : savepoints_) {
+      sqlite3_finalize(statements.save);
+      sqlite3_finalize(statements.release);
+      sqlite3_finalize(statements.rollback);
+    }
+    savepoints_.clear();
+    for (auto& statement : statements_) {
+      sqlite3_finalize(statement.second.stmt);
+    }
+    statements_.clear();
+  }
+
+  void close() {
+    finalize();
+    if (db_ && ownes_db_) {
+      sqlite3_close_v2(db_);
+    }
+    db_ = nullptr;
+    connected_ = false;
+  }
+
+  // Takes over the connection and statements of `other` and leaves it unconnected.
+  void take(database& other) {
+    db_ = other.db_;
+    connected_ = other.connected_;
+    ownes_db_ = other.ownes_db_;
+    std::copy(std::begin(other.begin_), std::end(other.begin_), std::begin(begin_));
+    commit_ = other.commit_;
+    rollback_ = other.rollback_;
+    savepoints_ = std::move(other.savepoints_);
+    savepoint_depth_ = other.savepoint_depth_;
+    immutable_ = other.immutable_;
+    statements_ = std::move(other.statements_);
+    batch_limit_ = other.batch_limit_;
+    batch_interval_ = other.batch_interval_;
+    batch_count_ = other.batch_count_;
+    batch_start_ = other.batch_start_;
+    batch_open_ = other.batch_open_;
+    batch_error_ = std::move(other.batch_error_);
+    last_used_.store(other.last_used_.load(std::memory_order_relaxed), std::memory_order_relaxed);
+
+    other.db_ = nullptr;
+    other.connected_ = false;
+    other.ownes_db_ = false;
+    std::fill(std::begin(other.begin_), std::end(other.begin_), nullptr);
+    other.commit_ = nullptr;
+    other.rollback_ = nullptr;
+    other.savepoints_.clear();
+    other.savepoint_depth_ = 0;
+    other.statements_.clear();
+    other.batch_limit_ = 0;
+    other.batch_open_ = false;
+    other.batch_error_.clear();
+  }
+
 public:
   database(const std::u16string& db_name) : connected_(false), ownes_db_(true) {
     connected_ = sqlite3_open16(db_name.data(), &db_) == SQLITE_OK;
@@ -199,27 +491,77 @@ public:
   database(const std::string& db_name) : database(conv(db_name)) {
   }
 
+  // Opens the database with `open_mode::immutable` as a read-only URI with `immutable=1` and
+  // enables memory-mapped I/O up to the `SQLITE_CONFIG_MMAP_SIZE` limit. Statements are
+  // prepared on first use, or up front with `prepare`, and reused. Write statements throw.
+  // `vfs` names a registered VFS to open the database with instead of the default one.
+  database(const std::string& db_name, open_mode mode, const char* vfs = nullptr) : connected_(false), ownes_db_(true) {
+    if (mode == open_mode::read_write) {
+      if (vfs) {
+        connected_ = sqlite3_open_v2(db_name.data(), &db_, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE, vfs) == SQLITE_OK;
+      } else {
+        connected_ = sqlite3_open16(conv(db_name).data(), &db_) == SQLITE_OK;
+      }
+      return;
+    }
+    std::string uri = "file:";
+    for (auto c : db_name) {
+      if (c == '?' || c == '#' || c == '%') {
+        static const char digits[] = "0123456789abcdef";
+        uri += '%';
+        uri += digits[static_cast<unsigned char>(c) >> 4];
+        uri += digits[c & 0xf];
+      } else {
+        uri += c;
+      }
+    }
+    uri += "?immutable=1";
+    connected_ = sqlite3_open_v2(uri.data(), &db_, SQLITE_OPEN_READONLY | SQLITE_OPEN_URI, vfs) == SQLITE_OK;
+    immutable_ = true;
+    if (connected_) {
+      sqlite3_exec(db_, "pragma mmap_size=9223372036854775807;", nullptr, nullptr, nullptr);
+    }
+  }
+
   database(sqlite3* db) : db_(db), connected_(true), ownes_db_(false) {
   }
 
-  ~database() {
-    if (db_ && ownes_db_) {
-      sqlite3_close_v2(db_);
-      db_ = nullptr;
+  database(const database& other) = delete;
+  database& operator=(const database& other) = delete;
+
+  // Moves the connection with its prepared statements and open batch. Binders of `other`
+  // that are still alive must not be used afterwards.
+  database(database&& other) : connected_(false), ownes_db_(false) {
+    take(other);
+  }
+
+  database& operator=(database&& other) {
+    if (this != &other) {
+      close();
+      take(other);
     }
+    return *this;
+  }
+
+  // Opens an in-memory database and copies the database file at `path` into it in a single
+  // backup step. See `replica.h` for copies that are refreshed from disk.
+  static database open_in_memory_copy(const std::string& path);
+
+  ~database() {
+    close();
   }
 
   database_binder operator<<(const std::string& sql) const {
-    return database_binder(db_, sql);
+    return database_binder(this, db_, sql);
   }
 
   database_binder operator<<(const std::u16string& sql) const {
-    return database_binder(db_, sql);
+    return database_binder(this, db_, sql);
   }
 
 #ifdef _MSC_VER
   database_binder operator<<(const std::wstring& sql) const {
-    return database_binder(db_, sql);
+    return database_binder(this, db_, sql);
   }
 #endif
 
@@ -230,6 +572,281 @@ public:
   sqlite3_int64 last_insert_rowid() const {
     return sqlite3_last_insert_rowid(db_);
   }
+
+  sqlite3* handle() const {
+    return db_;
+  }
+
+  // Prepares a statement of an immutable database ahead of its first use.
+  void prepare(const std::string& sql) const {
+    if (!immutable_) {
+      throw sqlite_exception("only statements of immutable databases are cached");
+    }
+    checkout(conv(sql))->busy = false;
+  }
+
+  // Time at which the last statement was prepared on this database.
+  std::chrono::steady_clock::time_point last_used() const {
+    using clock = std::chrono::steady_clock;
+    return clock::time_point(clock::duration(last_used_.load(std::memory_order_relaxed)));
+  }
+
+  // Groups consecutive write statements into implicit transactions. A batch is committed
+  // before the next read or transaction control statement, and when the next write arrives
+  // after `statements` writes or after `interval` has passed since the batch was started.
+  // Passing zero statements commits the current batch and disables batching.
+  //
+  // Nothing commits a batch in the background: `interval` is only checked when the next
+  // statement is issued. An open batch is a `BEGIN IMMEDIATE` transaction and holds the
+  // database's write lock until then, so callers that go idle after writing must call `flush`.
+  void batch(std::size_t statements, std::chrono::milliseconds interval = std::chrono::milliseconds(100)) {
+    if (statements == 0) {
+      flush();
+    }
+    batch_limit_ = statements;
+    batch_interval_ = interval;
+  }
+
+  // Commits the current batch. Throws when that fails, and when a batch that was committed
+  // implicitly since the last call was lost; its writes are then rolled back. A batch whose
+  // commit failed but whose transaction is still open, i.e. with `SQLITE_BUSY`, stays open.
+  void flush() const {
+    if (batch_open_) {
+      try {
+        commit();
+      }
+      catch (const sqlite_exception&) {
+        batch_open_ = !sqlite3_get_autocommit(db_);
+        throw;
+      }
+      batch_open_ = false;
+    }
+    if (!batch_error_.empty()) {
+      sqlite_exception e(batch_error_.data());
+      batch_error_.clear();
+      throw e;
+    }
+  }
+
+  // Sets the size and number of lookaside slots of this connection. Must be called before
+  // the connection is used.
+  void lookaside(int size, int count) const {
+    auto hresult = sqlite3_db_config(db_, SQLITE_DBCONFIG_LOOKASIDE, nullptr, size, count);
+    if (hresult != SQLITE_OK) {
+      throw sqlite_exception(sqlite3_errstr(hresult));
+    }
+  }
+
+  // Sets the maximum number of bytes of the database file that are accessed through
+  // memory-mapped I/O and returns the limit that is in effect. The limit is capped by
+  // `SQLITE_CONFIG_MMAP_SIZE`. Zero disables memory-mapped I/O.
+  sqlite3_int64 mmap_size(sqlite3_int64 bytes) const {
+    sqlite3_int64 size = 0;
+    *this << "pragma mmap_size=" + std::to_string(bytes) + ";" >> size;
+    return size;
+  }
+
+  sqlite3_int64 mmap_size() const {
+    sqlite3_int64 size = 0;
+    *this << "pragma mmap_size;" >> size;
+    return size;
+  }
+
+  // Registers `function` as a scalar SQL function. Its arity and the types of its arguments
+  // and result are taken from its signature, see `function.h`. Calls decode the arguments
+  // on the stack and do not allocate unless the function takes or returns strings. Calls of
+  // deterministic functions with constant arguments are evaluated once per statement where
+  // SQLite supports it; pass false for functions with side effects or random results.
+  template<typename Function>
+  void define(const std::string& name, Function&& function, bool deterministic = true) const {
+    typedef typename std::decay<Function>::type type;
+    auto flags = SQLITE_UTF8;
+#ifdef SQLITE_DETERMINISTIC
+    if (deterministic) {
+      flags |= SQLITE_DETERMINISTIC;
+    }
+#endif
+    // The function object is destroyed by SQLite, also when the registration fails.
+    auto hresult = sqlite3_create_function_v2(db_, name.data(), static_cast<int>(utility::function_traits<type>::arity), flags,
+                                              new type(std::forward<Function>(function)), scalar_function<type>::call, nullptr, nullptr,
+                                              scalar_function<type>::destroy);
+    if (hresult != SQLITE_OK) {
+      throw sqlite_exception(sqlite3_errstr(hresult));
+    }
+  }
+
+  // Registers `Aggregate` as an aggregate SQL function. For every group a default-constructed
+  // `Aggregate` is placed in memory that SQLite allocates for the group, rows are passed to
+  // its `step` method and the result of its `final` method is returned. The arity and the
+  // argument types are taken from the signature of `step`, which must not be overloaded.
+  // Aggregates that also have `inverse`, which removes a row, and `value`, which returns the
+  // current result, are registered as window functions when SQLite supports them (3.25).
+  template<typename Aggregate>
+  void define_aggregate(const std::string& name, bool deterministic = true) const {
+    auto flags = SQLITE_UTF8;
+#ifdef SQLITE_DETERMINISTIC
+    if (deterministic) {
+      flags |= SQLITE_DETERMINISTIC;
+    }
+#endif
+    auto hresult = aggregate_function<Aggregate>::create(db_, name.data(), flags, is_window_aggregate<Aggregate>());
+    if (hresult != SQLITE_OK) {
+      throw sqlite_exception(sqlite3_errstr(hresult));
+    }
+  }
+
+  // Registers `compare` as the collation `name`, for use like `order by name collate name`.
+  // It is called with the UTF-8 text and size of two strings, like
+  // `int(const char* a, std::size_t a_size, const char* b, std::size_t b_size)`, and must order
+  // them consistently. See `collation.h` for built-in comparators.
+  template<typename Compare>
+  void define_collation(const std::string& name, Compare&& compare) const {
+    typedef typename std::decay<Compare>::type type;
+    auto comparator = new type(std::forward<Compare>(compare));
+    auto hresult = sqlite3_create_collation_v2(db_, name.data(), SQLITE_UTF8, comparator, collation_function<type>::compare,
+                                               collation_function<type>::destroy);
+    if (hresult != SQLITE_OK) {
+      // Unlike functions, the comparator is not destroyed when the registration fails.
+      delete comparator;
+      throw sqlite_exception(sqlite3_errstr(hresult));
+    }
+  }
+
+  // Copies this database to the given file or database on a background thread while it stays
+  // usable. See `backup.h`.
+  backup backup_to(const std::string& path, const backup_options& options) const;
+  backup backup_to(const database& destination, const backup_options& options) const;
+
+  // I/O statistics of the database file, its WAL and its journal when the database was opened
+  // through the instrumented VFS. See `instrument.h`.
+  std::vector<file_statistics> io_statistics() const;
+
+  // Passes an access pattern hint for the memory-mapped part of the main database file to the
+  // operating system. The mapping is created on demand, so this should be called after
+  // `mmap_size` and is a no-op when memory-mapped I/O is disabled or not supported.
+  void mmap_advise(mmap_advice advice) const;
+};
+
+inline database_binder::database_binder(const database* owner, sqlite3* db, const std::u16string& sql)
+  : owner_(owner), db_(db), sql_(sql) {
+  if (owner_ && owner_->immutable_) {
+    cached_ = owner_->checkout(sql_);
+    if (cached_) {
+      stmt_ = cached_->stmt;
+    }
+  }
+  if (!stmt_) {
+    prepare();
+  }
+  if (owner_) {
+    try {
+      owner_->prepared(stmt_);
+    }
+    catch (...) {
+      finish();
+      throw;
+    }
+  }
+}
+
+inline int database_binder::finish() {
+  auto stmt = stmt_;
+  stmt_ = nullptr;
+  int hresult;
+  if (!cached_) {
+    hresult = sqlite3_finalize(stmt);
+  } else {
+    hresult = sqlite3_reset(stmt);
+    sqlite3_clear_bindings(stmt);
+    cached_->busy = false;
+    cached_ = nullptr;
+  }
+  // Arrays are released once the statement can no longer read them.
+  for (auto handle : arrays_) {
+    unregister_array(db_, handle);
+  }
+  arrays_.clear();
+  return hresult;
+}
+
+// Begins a transaction with cached statements and rolls it back on destruction unless it
+// was committed. The default mode takes the write lock up front, which avoids deadlocks when
+// two deferred transactions try to upgrade their read locks at the same time.
+class transaction {
+private:
+  const database& db_;
+  bool active_ = false;
+
+public:
+  explicit transaction(const database& db, transaction_mode mode = transaction_mode::immediate) : db_(db) {
+    db_.flush();
+    db_.begin(mode);
+    active_ = true;
+  }
+
+  transaction(const transaction& other) = delete;
+  transaction& operator=(const transaction& other) = delete;
+
+  ~transaction() {
+    if (active_) {
+      try {
+        db_.rollback();
+      }
+      catch (...) {
+      }
+    }
+  }
+
+  // The transaction stays active when the commit fails (i.e. with `SQLITE_BUSY`) so that it
+  // can be retried or rolled back.
+  void commit() {
+    db_.commit();
+    active_ = false;
+  }
+
+  void rollback() {
+    db_.rollback();
+    active_ = false;
+  }
+};
+
+// Establishes a named savepoint that can be nested inside transactions and other savepoints.
+// Savepoints must be released or rolled back in reverse order of their creation.
+class savepoint {
+private:
+  const database& db_;
+  std::size_t depth_ = 0;
+  bool active_ = false;
+
+public:
+  explicit savepoint(const database& db) : db_(db) {
+    db_.flush();
+    depth_ = db_.save();
+    active_ = true;
+  }
+
+  savepoint(const savepoint& other) = delete;
+  savepoint& operator=(const savepoint& other) = delete;
+
+  ~savepoint() {
+    if (active_) {
+      try {
+        db_.rollback(depth_);
+      }
+      catch (...) {
+      }
+    }
+  }
+
+  void release() {
+    db_.release(depth_);
+    active_ = false;
+  }
+
+  void rollback() {
+    db_.rollback(depth_);
+    active_ = false;
+  }
 };
 
 template<std::size_t Count>
@@ -403,6 +1020,39 @@ inline database_binder&& operator<<(database_binder&& db, const std::u16string&&
   return std::move(db);
 }
 
+// std::vector of arithmetic types, stored as a BLOB of the elements in native byte order
+template<typename T>
+inline void get_col_from_db(database_binder& db, int index, std::vector<T>& vec) {
+  static_assert(std::is_arithmetic<T>::value, "vectors are stored as BLOBs of arithmetic types");
+  if (sqlite3_column_type(db.stmt_, index) == SQLITE_NULL) {
+    vec.clear();
+  } else {
+    auto data = sqlite3_column_blob(db.stmt_, index);
+    vec.resize(static_cast<std::size_t>(sqlite3_column_bytes(db.stmt_, index)) / sizeof(T));
+    if (!vec.empty()) {
+      std::memcpy(vec.data(), data, vec.size() * sizeof(T));
+    }
+  }
+}
+
+template<typename T>
+inline database_binder&& operator<<(database_binder&& db, const std::vector<T>& vec) {
+  static_assert(std::is_arithmetic<T>::value, "vectors are stored as BLOBs of arithmetic types");
+  // A null pointer would bind NULL instead of an empty BLOB.
+  const void* data = vec.empty() ? "" : static_cast<const void*>(vec.data());
+  if (sqlite3_bind_blob(db.stmt_, db.index_, data, static_cast<int>(vec.size() * sizeof(T)), SQLITE_TRANSIENT) != SQLITE_OK) {
+    db.throw_sqlite_error();
+  }
+
+  ++db.index_;
+  return std::move(db);
+}
+
+template<typename T>
+inline database_binder&& operator<<(database_binder&& db, const std::vector<T>&& vec) {
+  return std::move(db) << vec;
+}
+
 // Call the rvalue functions.
 template<typename T>
 database_binder&& operator<<(database_binder&& db, const T& val) {
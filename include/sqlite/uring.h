@@ -0,0 +1,52 @@
+#pragma once
+#include <cstdint>
+
+#include "sqlite.h"
+
+namespace sqlite {
+
+struct uring_vfs_options {
+  // Submission queue size of the ring that is created for every main database file.
+  unsigned entries = 64;
+
+  // Bytes read ahead once sequential reads are detected. The next window is read
+  // asynchronously while the current one is consumed. Zero disables readahead.
+  std::size_t readahead = 256 * 1024;
+
+  // Number of consecutive sequential reads after which readahead starts.
+  int sequential_reads = 4;
+
+  // Writes are collected until the next sync, lock change or file control, or until they
+  // exceed this many bytes, and are then submitted together.
+  std::size_t write_batch = 16 * 1024 * 1024;
+
+  // Registers the VFS as the default VFS.
+  bool make_default = false;
+};
+
+struct uring_statistics {
+  std::uint64_t reads = 0;
+  std::uint64_t readahead_hits = 0;
+  std::uint64_t writes = 0;
+
+  // Number of `io_uring_enter` calls that submitted batched writes and the writes they
+  // contained after adjacent pages were merged.
+  std::uint64_t write_batches = 0;
+  std::uint64_t write_submissions = 0;
+
+  std::uint64_t syncs = 0;
+};
+
+// Registers the "uring" VFS and returns it. Main database files are read and written through
+// an io_uring instance, and all other files and operations are passed on to the default unix
+// VFS. Memory-mapped I/O is not used by files of this VFS. When io_uring is not available,
+// i.e. on other platforms, older kernels or when it is disabled, the VFS behaves like the
+// default VFS. The options of the first call are used.
+sqlite3_vfs* uring_vfs(const uring_vfs_options& options = {});
+
+// Whether files of the VFS use io_uring.
+bool uring_available();
+
+uring_statistics uring_vfs_statistics();
+
+}  // namespace sqlite
@@ -11,8 +11,8 @@ template <typename Function>
 struct function_traits : public function_traits<decltype(&Function::operator())>
 {};
 
-template <typename ClassType, typename ReturnType, typename... Arguments>
-struct function_traits<ReturnType(ClassType::*)(Arguments...) const> {
+template <typename ReturnType, typename... Arguments>
+struct function_traits<ReturnType(*)(Arguments...)> {
 	typedef ReturnType result_type;
 
 	template <std::size_t Index>
@@ -21,5 +21,20 @@ struct function_traits<ReturnType(ClassType::*)(Arguments...) const> {
 	static const std::size_t arity = sizeof...(Arguments);
 };
 
+template <typename ReturnType, typename... Arguments>
+struct function_traits<ReturnType(Arguments...)> : public function_traits<ReturnType(*)(Arguments...)>
+{};
+
+template <typename ClassType, typename ReturnType, typename... Arguments>
+struct function_traits<ReturnType(ClassType::*)(Arguments...) const> : public function_traits<ReturnType(*)(Arguments...)> {
+	typedef ClassType class_type;
+};
+
+// Mutable lambdas and non-const member functions.
+template <typename ClassType, typename ReturnType, typename... Arguments>
+struct function_traits<ReturnType(ClassType::*)(Arguments...)> : public function_traits<ReturnType(*)(Arguments...)> {
+	typedef ClassType class_type;
+};
+
 }  // namespace utility
 }  // namespace sqlite
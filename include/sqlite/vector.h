@@ -0,0 +1,33 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+#include "sqlite.h"
+
+// Distances between embeddings that are stored as BLOBs of float32 or int8 components in
+// native byte order. The kernels use AVX-512 or AVX2 on x86-64, chosen at runtime, and plain
+// loops elsewhere. Pointers need no alignment, so they can point into SQLite's records.
+namespace sqlite {
+
+float vector_dot(const float* a, const float* b, std::size_t size);
+
+// Euclidean distance.
+float vector_l2(const float* a, const float* b, std::size_t size);
+
+// One minus the cosine similarity, so that nearer vectors have smaller distances. One when
+// either vector is zero.
+float vector_cosine(const float* a, const float* b, std::size_t size);
+
+// The int8 variants accumulate in 32 bits, which holds for up to 32768 components.
+std::int32_t vector_dot(const std::int8_t* a, const std::int8_t* b, std::size_t size);
+float vector_l2(const std::int8_t* a, const std::int8_t* b, std::size_t size);
+float vector_cosine(const std::int8_t* a, const std::int8_t* b, std::size_t size);
+
+// Registers the deterministic SQL functions vec_dot(a, b), vec_l2(a, b) and vec_cosine(a, b)
+// over float32 BLOBs and vec_dot_i8, vec_l2_i8 and vec_cosine_i8 over int8 BLOBs. They read
+// the BLOBs in place, so that `order by vec_l2(embedding, ?) limit 10` copies no rows. NULL
+// arguments give NULL, and BLOBs of different sizes are an error, as are int8 BLOBs of more
+// than 32768 components.
+void define_vector_functions(const database& db);
+
+}  // namespace sqlite
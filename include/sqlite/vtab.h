@@ -0,0 +1,392 @@
+#pragma once
+#include <cmath>
+#include <cstring>
+#include <initializer_list>
+#include <iterator>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include "sqlite.h"
+
+// Read-only virtual tables over random-access ranges of structures, e.g.
+//
+//   struct point { sqlite3_int64 id; double x; std::string name; };
+//   std::vector<point> points = ...;
+//   define_sorted_table(db, "points", points, column("id", &point::id), column("x", &point::x),
+//                       column("name", &point::name));
+//   db << "select p.name from points p join other o on o.point = p.id where p.id > ?;" << 10 ...
+//
+// The range is referenced, not copied, and must neither change nor move while statements
+// read the table. Columns are read straight from the elements, and strings are passed to
+// SQLite without a copy. Members can be integral, floating point, `std::string` or
+// `const char*`.
+namespace sqlite {
+
+template<typename Class, typename Type>
+struct table_column {
+  typedef Type type;
+
+  const char* name;
+  Type Class::*member;
+};
+
+template<typename Class, typename Type>
+table_column<Class, Type> column(const char* name, Type Class::*member) {
+  return table_column<Class, Type>{ name, member };
+}
+
+template<typename Range, typename... Columns>
+class table_module {
+private:
+  enum plan {
+    equal = 1,
+    lower = 2,
+    upper = 4,
+  };
+
+  struct table {
+    sqlite3_vtab base;
+    table_module* module;
+  };
+
+  struct cursor {
+    sqlite3_vtab_cursor base;
+    std::size_t position;
+    std::size_t end;
+  };
+
+  const Range& range_;
+  std::tuple<Columns...> columns_;
+  bool sorted_;
+  std::string schema_;
+
+  template<typename T>
+  static typename std::enable_if<std::is_arithmetic<T>::value, const char*>::type declared_type() {
+    return std::is_floating_point<T>::value ? "real" : "integer";
+  }
+
+  template<typename T>
+  static typename std::enable_if<!std::is_arithmetic<T>::value, const char*>::type declared_type() {
+    return "text";
+  }
+
+  template<typename T>
+  static typename std::enable_if<std::is_integral<T>::value>::type store(sqlite3_context* context, T value) {
+    sqlite3_result_int64(context, static_cast<sqlite3_int64>(value));
+  }
+
+  template<typename T>
+  static typename std::enable_if<std::is_floating_point<T>::value>::type store(sqlite3_context* context, T value) {
+    sqlite3_result_double(context, static_cast<double>(value));
+  }
+
+  static void store(sqlite3_context* context, const std::string& value) {
+    sqlite3_result_text(context, value.data(), static_cast<int>(value.size()), SQLITE_STATIC);
+  }
+
+  static void store(sqlite3_context* context, const char* value) {
+    if (value) {
+      sqlite3_result_text(context, value, -1, SQLITE_STATIC);
+    } else {
+      sqlite3_result_null(context);
+    }
+  }
+
+  typedef typename std::tuple_element<0, std::tuple<Columns...>>::type::type key_type;
+
+  // Whether the binary search can narrow the range by `value`. SQLite orders values of
+  // different storage classes by their class, e.g. every number before every string, and
+  // converts them by the column's affinity, which `compare` does neither of. The range is
+  // left as is for such values, and SQLite's check of the rows applies its own rules.
+  template<typename T>
+  static typename std::enable_if<std::is_arithmetic<T>::value, bool>::type searchable(sqlite3_value* value) {
+    auto type = sqlite3_value_type(value);
+    return type == SQLITE_INTEGER || type == SQLITE_FLOAT;
+  }
+
+  template<typename T>
+  static typename std::enable_if<!std::is_arithmetic<T>::value, bool>::type searchable(sqlite3_value* value) {
+    return sqlite3_value_type(value) == SQLITE_TEXT;
+  }
+
+  // Compares a key with a constraint value of its storage class. Numbers are compared as
+  // doubles and strings bytewise. Keys that are equal as doubles but not as integers stay in
+  // the range, and SQLite's check of the rows drops them.
+  template<typename T>
+  static typename std::enable_if<std::is_arithmetic<T>::value, int>::type compare(T key, sqlite3_value* value) {
+    auto a = static_cast<double>(key);
+    auto b = sqlite3_value_double(value);
+    return a < b ? -1 : (a > b ? 1 : 0);
+  }
+
+  static int compare(const char* key, std::size_t size, sqlite3_value* value) {
+    auto text = reinterpret_cast<const char*>(sqlite3_value_text(value));
+    auto length = static_cast<std::size_t>(sqlite3_value_bytes(value));
+    auto result = std::memcmp(key, text ? text : "", std::min(size, length));
+    return result ? result : (size < length ? -1 : (size > length ? 1 : 0));
+  }
+
+  static int compare(const std::string& key, sqlite3_value* value) {
+    return compare(key.data(), key.size(), value);
+  }
+
+  static int compare(const char* key, sqlite3_value* value) {
+    return key ? compare(key, std::strlen(key), value) : -1;
+  }
+
+  static std::string quote(const std::string& name) {
+    std::string quoted = "\"";
+    for (auto c : name) {
+      quoted += c;
+      if (c == '"') {
+        quoted += c;
+      }
+    }
+    return quoted + "\"";
+  }
+
+  std::size_t size() const {
+    return static_cast<std::size_t>(std::distance(std::begin(range_), std::end(range_)));
+  }
+
+  auto row(std::size_t index) const -> decltype(*std::begin(range_)) {
+    return std::begin(range_)[index];
+  }
+
+  // First row in [begin, end) whose key is not below `value`, or above it when `inclusive`.
+  std::size_t partition(std::size_t begin, std::size_t end, sqlite3_value* value, bool inclusive) const {
+    auto member = std::get<0>(columns_).member;
+    while (begin < end) {
+      auto middle = begin + (end - begin) / 2;
+      auto order = compare(row(middle).*member, value);
+      if (order < 0 || (inclusive && order == 0)) {
+        begin = middle + 1;
+      } else {
+        end = middle;
+      }
+    }
+    return begin;
+  }
+
+  template<std::size_t Index>
+  static void store_member(const table_module& module, std::size_t position, sqlite3_context* context) {
+    store(context, module.row(position).*(std::get<Index>(module.columns_).member));
+  }
+
+  template<std::size_t... Indexes>
+  void store_column(std::size_t position, int index, sqlite3_context* context, std::index_sequence<Indexes...>) const {
+    typedef void (*function)(const table_module&, std::size_t, sqlite3_context*);
+    static const function functions[] = { &table_module::store_member<Indexes>... };
+    functions[index](*this, position, context);
+  }
+
+  static int connect(sqlite3* db, void* module, int, const char* const*, sqlite3_vtab** vtab, char**) {
+    auto self = static_cast<table_module*>(module);
+    auto hresult = sqlite3_declare_vtab(db, self->schema_.data());
+    if (hresult != SQLITE_OK) {
+      return hresult;
+    }
+    auto t = static_cast<table*>(sqlite3_malloc(sizeof(table)));
+    if (!t) {
+      return SQLITE_NOMEM;
+    }
+    std::memset(t, 0, sizeof(table));
+    t->module = self;
+    *vtab = &t->base;
+    return SQLITE_OK;
+  }
+
+  static int disconnect(sqlite3_vtab* vtab) {
+    sqlite3_free(vtab);
+    return SQLITE_OK;
+  }
+
+  static int best_index(sqlite3_vtab* vtab, sqlite3_index_info* info) {
+    auto& self = *reinterpret_cast<table*>(vtab)->module;
+    auto rows = static_cast<double>(self.size());
+    int constraints[3] = { -1, -1, -1 };
+    for (int i = 0; self.sorted_ && i < info->nConstraint; i++) {
+      auto& c = info->aConstraint[i];
+      if (!c.usable || c.iColumn != 0) {
+        continue;
+      }
+      if (c.op == SQLITE_INDEX_CONSTRAINT_EQ) {
+        constraints[0] = i;
+      } else if (c.op == SQLITE_INDEX_CONSTRAINT_GT || c.op == SQLITE_INDEX_CONSTRAINT_GE) {
+        constraints[1] = i;
+      } else if (c.op == SQLITE_INDEX_CONSTRAINT_LT || c.op == SQLITE_INDEX_CONSTRAINT_LE) {
+        constraints[2] = i;
+      }
+    }
+
+    // Arguments are passed to `filter` in the order of the plan bits.
+    int plan = 0;
+    int argument = 0;
+    for (int bit = 0; bit < 3; bit++) {
+      if (constraints[bit] >= 0) {
+        plan |= 1 << bit;
+        info->aConstraintUsage[constraints[bit]].argvIndex = ++argument;
+      }
+    }
+    info->idxNum = plan;
+
+    auto search = std::log2(rows + 1) + 1;
+    if (plan & equal) {
+      info->estimatedCost = search;
+      rows = 1;
+    } else if ((plan & lower) && (plan & upper)) {
+      info->estimatedCost = search + rows / 4;
+      rows /= 4;
+    } else if (plan) {
+      info->estimatedCost = search + rows / 2;
+      rows /= 2;
+    } else {
+      info->estimatedCost = rows + 1;
+    }
+    if (sqlite3_libversion_number() >= 3008002) {
+      info->estimatedRows = static_cast<sqlite3_int64>(rows);
+    }
+    if (self.sorted_ && info->nOrderBy == 1 && info->aOrderBy[0].iColumn == 0 && !info->aOrderBy[0].desc) {
+      info->orderByConsumed = 1;
+    }
+    return SQLITE_OK;
+  }
+
+  static int open(sqlite3_vtab*, sqlite3_vtab_cursor** out) {
+    auto c = static_cast<cursor*>(sqlite3_malloc(sizeof(cursor)));
+    if (!c) {
+      return SQLITE_NOMEM;
+    }
+    std::memset(c, 0, sizeof(cursor));
+    *out = &c->base;
+    return SQLITE_OK;
+  }
+
+  static int close(sqlite3_vtab_cursor* c) {
+    sqlite3_free(c);
+    return SQLITE_OK;
+  }
+
+  static int filter(sqlite3_vtab_cursor* base, int plan, const char*, int, sqlite3_value** arguments) {
+    auto c = reinterpret_cast<cursor*>(base);
+    auto& self = *reinterpret_cast<table*>(base->pVtab)->module;
+    std::size_t begin = 0;
+    std::size_t end = self.size();
+    if (plan & equal) {
+      auto value = *arguments++;
+      if (searchable<key_type>(value)) {
+        begin = self.partition(begin, end, value, false);
+        end = self.partition(begin, end, value, true);
+      }
+    }
+    if (plan & lower) {
+      auto value = *arguments++;
+      if (searchable<key_type>(value)) {
+        begin = self.partition(begin, end, value, false);
+      }
+    }
+    if (plan & upper) {
+      auto value = *arguments++;
+      if (searchable<key_type>(value)) {
+        end = self.partition(begin, end, value, true);
+      }
+    }
+    c->position = begin;
+    c->end = end;
+    return SQLITE_OK;
+  }
+
+  static int next(sqlite3_vtab_cursor* c) {
+    reinterpret_cast<cursor*>(c)->position++;
+    return SQLITE_OK;
+  }
+
+  static int eof(sqlite3_vtab_cursor* c) {
+    return reinterpret_cast<cursor*>(c)->position >= reinterpret_cast<cursor*>(c)->end;
+  }
+
+  static int column(sqlite3_vtab_cursor* base, sqlite3_context* context, int index) {
+    auto& self = *reinterpret_cast<table*>(base->pVtab)->module;
+    self.store_column(reinterpret_cast<cursor*>(base)->position, index, context, std::index_sequence_for<Columns...>());
+    return SQLITE_OK;
+  }
+
+  static int rowid(sqlite3_vtab_cursor* c, sqlite3_int64* id) {
+    *id = static_cast<sqlite3_int64>(reinterpret_cast<cursor*>(c)->position);
+    return SQLITE_OK;
+  }
+
+  static void destroy(void* module) {
+    delete static_cast<table_module*>(module);
+  }
+
+public:
+  table_module(const Range& range, bool sorted, Columns... columns) : range_(range), columns_(columns...), sorted_(sorted) {
+    schema_ = "create table x(";
+    auto first = true;
+    (void)std::initializer_list<int>{ (schema_ += (first ? "" : ", ") + quote(columns.name) + " " + declared_type<typename Columns::type>(), first = false, 0)... };
+    schema_ += ");";
+  }
+
+  // Registers a module for this table and creates the table in the temp schema. Ownership of
+  // the module passes to the connection.
+  static void install(const database& db, const std::string& name, table_module* module) {
+    static const sqlite3_module methods = {
+      1,
+      connect,
+      connect,
+      best_index,
+      disconnect,
+      disconnect,
+      open,
+      close,
+      filter,
+      next,
+      eof,
+      column,
+      rowid,
+      nullptr,
+      nullptr,
+      nullptr,
+      nullptr,
+      nullptr,
+      nullptr,
+      nullptr,
+      nullptr,
+      nullptr,
+      nullptr,
+    };
+    try {
+      db << "drop table if exists temp." + quote(name) + ";";
+    }
+    catch (...) {
+      delete module;
+      throw;
+    }
+    auto module_name = "table_module_" + name;
+    auto hresult = sqlite3_create_module_v2(db.handle(), module_name.data(), &methods, module, destroy);
+    if (hresult != SQLITE_OK) {
+      throw sqlite_exception(sqlite3_errstr(hresult));
+    }
+    db << "create virtual table temp." + quote(name) + " using " + quote(module_name) + ";";
+  }
+};
+
+// Creates the temporary virtual table `name` with a row for every element of `range`.
+template<typename Range, typename... Columns>
+void define_table(const database& db, const std::string& name, const Range& range, Columns... columns) {
+  table_module<Range, Columns...>::install(db, name, new table_module<Range, Columns...>(range, false, columns...));
+}
+
+// Like `define_table` for ranges that are sorted by the first column. Equality and range
+// constraints on it are answered by binary search when their value is of the column's storage
+// class, numbers for numeric and text for string members, and ascending order by it needs no
+// sort.
+template<typename Range, typename... Columns>
+void define_sorted_table(const database& db, const std::string& name, const Range& range, Columns... columns) {
+  table_module<Range, Columns...>::install(db, name, new table_module<Range, Columns...>(range, true, columns...));
+}
+
+}  // namespace sqlite
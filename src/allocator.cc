@@ -0,0 +1,366 @@
+#include <sqlite/allocator.h>
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+
+namespace sqlite {
+namespace {
+
+const std::size_t alignment = 16;
+const std::size_t max_pooled = 64 * 1024;
+const std::size_t max_classes = 64;
+const std::int64_t publish_threshold = 64 * 1024;
+const std::uint32_t large = 0xFFFFFFFF;
+
+// Every allocation is preceded by a header that identifies its size class.
+struct header {
+  std::uint32_t size_class;
+  std::uint32_t reserved;
+  std::uint64_t size;
+};
+
+static_assert(sizeof(header) == alignment, "the header must preserve the alignment");
+
+struct block {
+  block* next;
+};
+
+// Four classes per power of two above 128 bytes keep the internal fragmentation below 25%.
+class size_classes {
+public:
+  std::vector<std::size_t> sizes;
+  std::vector<std::uint8_t> lookup;
+
+  size_classes() {
+    for (std::size_t size = 16; size <= 128; size += 16) {
+      sizes.push_back(size);
+    }
+    for (std::size_t size = 128; size < max_pooled; size *= 2) {
+      for (std::size_t step = 1; step <= 4; step++) {
+        sizes.push_back(size + size * step / 4);
+      }
+    }
+    lookup.resize(max_pooled / alignment + 1);
+    std::size_t index = 0;
+    for (std::size_t i = 0; i < lookup.size(); i++) {
+      while (sizes[index] < i * alignment) {
+        index++;
+      }
+      lookup[i] = static_cast<std::uint8_t>(index);
+    }
+  }
+
+  std::size_t find(std::size_t size) const {
+    return lookup[(size + alignment - 1) / alignment];
+  }
+
+  // Number of blocks moved between a thread cache and the shared pool at once.
+  std::size_t batch(std::size_t size_class) const {
+    return std::max<std::size_t>(std::min<std::size_t>(64 * 1024 / sizes[size_class], 64), 2);
+  }
+};
+
+const size_classes& classes() {
+  static const size_classes* instance = new size_classes();
+  return *instance;
+}
+
+struct thread_cache;
+
+struct shared_list {
+  std::mutex mutex;
+  block* head = nullptr;
+};
+
+struct shared_pool {
+  shared_list lists[max_classes];
+  std::atomic<std::int64_t> current{ 0 };
+  std::atomic<std::int64_t> peak{ 0 };
+  std::atomic<std::uint64_t> retired[max_classes + 1];
+
+  std::mutex mutex;
+  std::vector<thread_cache*> caches;
+
+  shared_pool() {
+    for (auto& counter : retired) {
+      counter = 0;
+    }
+  }
+
+  void publish(std::int64_t delta) {
+    auto current_value = current.fetch_add(delta, std::memory_order_relaxed) + delta;
+    auto peak_value = peak.load(std::memory_order_relaxed);
+    while (current_value > peak_value && !peak.compare_exchange_weak(peak_value, current_value, std::memory_order_relaxed)) {
+    }
+  }
+
+  void push(std::size_t size_class, block* first, block* last) {
+    std::lock_guard<std::mutex> lock(lists[size_class].mutex);
+    last->next = lists[size_class].head;
+    lists[size_class].head = first;
+  }
+
+  // Takes up to `count` blocks from the shared list and carves new ones when it runs empty.
+  block* pop(std::size_t size_class, std::size_t count) {
+    {
+      std::lock_guard<std::mutex> lock(lists[size_class].mutex);
+      auto head = lists[size_class].head;
+      if (head) {
+        auto last = head;
+        for (std::size_t i = 1; i < count && last->next; i++) {
+          last = last->next;
+        }
+        lists[size_class].head = last->next;
+        last->next = nullptr;
+        return head;
+      }
+    }
+    auto stride = alignment + classes().sizes[size_class];
+    auto chunk = static_cast<char*>(std::malloc(stride * count));
+    if (!chunk) {
+      return nullptr;
+    }
+    for (std::size_t i = 0; i < count; i++) {
+      reinterpret_cast<block*>(chunk + i * stride)->next = i + 1 < count ? reinterpret_cast<block*>(chunk + (i + 1) * stride) : nullptr;
+    }
+    return reinterpret_cast<block*>(chunk);
+  }
+};
+
+// The pool outlives static destructors that may still release SQLite memory.
+shared_pool& pool() {
+  static shared_pool* instance = new shared_pool();
+  return *instance;
+}
+
+struct thread_cache {
+  block* heads[max_classes] = {};
+  std::size_t counts[max_classes] = {};
+  std::atomic<std::uint64_t> histogram[max_classes + 1];
+  std::int64_t pending = 0;
+
+  thread_cache() {
+    for (auto& counter : histogram) {
+      counter = 0;
+    }
+    std::lock_guard<std::mutex> lock(pool().mutex);
+    pool().caches.push_back(this);
+  }
+
+  ~thread_cache();
+
+  void count(std::size_t size_class, std::int64_t bytes) {
+    histogram[size_class].store(histogram[size_class].load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    track(bytes);
+  }
+
+  void track(std::int64_t bytes) {
+    pending += bytes;
+    if (pending > publish_threshold || pending < -publish_threshold) {
+      pool().publish(pending);
+      pending = 0;
+    }
+  }
+
+  void release(std::size_t size_class, std::size_t count) {
+    auto first = heads[size_class];
+    auto last = first;
+    for (std::size_t i = 1; i < count; i++) {
+      last = last->next;
+    }
+    heads[size_class] = last->next;
+    counts[size_class] -= count;
+    pool().push(size_class, first, last);
+  }
+};
+
+thread_local bool cache_destroyed = false;
+
+thread_cache::~thread_cache() {
+  for (std::size_t i = 0; i < classes().sizes.size(); i++) {
+    if (counts[i] > 0) {
+      release(i, counts[i]);
+    }
+  }
+  pool().publish(pending);
+  std::lock_guard<std::mutex> lock(pool().mutex);
+  for (std::size_t i = 0; i <= max_classes; i++) {
+    pool().retired[i] += histogram[i].load(std::memory_order_relaxed);
+  }
+  auto& caches = pool().caches;
+  caches.erase(std::find(caches.begin(), caches.end(), this));
+  cache_destroyed = true;
+}
+
+// Returns nullptr while the thread is exiting, after its cache has been destroyed.
+thread_cache* cache() {
+  if (cache_destroyed) {
+    return nullptr;
+  }
+  thread_local thread_cache instance;
+  return &instance;
+}
+
+void* allocate(int bytes) {
+  if (bytes <= 0) {
+    return nullptr;
+  }
+  auto size = static_cast<std::size_t>(bytes);
+  auto local = cache();
+
+  if (size > max_pooled) {
+    auto h = static_cast<header*>(std::malloc(alignment + size));
+    if (!h) {
+      return nullptr;
+    }
+    h->size_class = large;
+    h->size = size;
+    if (local) {
+      local->count(max_classes, static_cast<std::int64_t>(size));
+    } else {
+      pool().publish(static_cast<std::int64_t>(size));
+    }
+    return h + 1;
+  }
+
+  auto size_class = classes().find(size);
+  block* b = nullptr;
+  if (local) {
+    if (!local->heads[size_class]) {
+      auto count = classes().batch(size_class);
+      local->heads[size_class] = pool().pop(size_class, count);
+      for (auto i = local->heads[size_class]; i; i = i->next) {
+        local->counts[size_class]++;
+      }
+    }
+    b = local->heads[size_class];
+    if (b) {
+      local->heads[size_class] = b->next;
+      local->counts[size_class]--;
+      local->count(size_class, static_cast<std::int64_t>(classes().sizes[size_class]));
+    }
+  } else {
+    b = pool().pop(size_class, 1);
+    pool().publish(static_cast<std::int64_t>(classes().sizes[size_class]));
+  }
+  if (!b) {
+    return nullptr;
+  }
+  auto h = reinterpret_cast<header*>(b);
+  h->size_class = static_cast<std::uint32_t>(size_class);
+  h->size = classes().sizes[size_class];
+  return h + 1;
+}
+
+void deallocate(void* data) {
+  if (!data) {
+    return;
+  }
+  auto h = static_cast<header*>(data) - 1;
+  auto local = cache();
+  if (h->size_class == large) {
+    if (local) {
+      local->track(-static_cast<std::int64_t>(h->size));
+    } else {
+      pool().publish(-static_cast<std::int64_t>(h->size));
+    }
+    std::free(h);
+    return;
+  }
+
+  auto size_class = h->size_class;
+  auto b = reinterpret_cast<block*>(h);
+  if (!local) {
+    pool().publish(-static_cast<std::int64_t>(h->size));
+    pool().push(size_class, b, b);
+    return;
+  }
+  local->track(-static_cast<std::int64_t>(h->size));
+  b->next = local->heads[size_class];
+  local->heads[size_class] = b;
+  auto batch = classes().batch(size_class);
+  if (++local->counts[size_class] > 2 * batch) {
+    local->release(size_class, batch);
+  }
+}
+
+int usable_size(void* data) {
+  return data ? static_cast<int>((static_cast<header*>(data) - 1)->size) : 0;
+}
+
+void* reallocate(void* data, int bytes) {
+  if (!data) {
+    return allocate(bytes);
+  }
+  auto size = static_cast<std::size_t>(bytes);
+  auto h = static_cast<header*>(data) - 1;
+  if (h->size_class != large && size <= max_pooled && classes().find(size) == h->size_class) {
+    return data;
+  }
+  auto result = allocate(bytes);
+  if (result) {
+    std::memcpy(result, data, std::min<std::size_t>(size, static_cast<std::size_t>(h->size)));
+    deallocate(data);
+  }
+  return result;
+}
+
+int roundup(int bytes) {
+  auto size = static_cast<std::size_t>(std::max(bytes, 1));
+  if (size > max_pooled) {
+    return static_cast<int>((size + alignment - 1) / alignment * alignment);
+  }
+  return static_cast<int>(classes().sizes[classes().find(size)]);
+}
+
+int initialize(void*) {
+  classes();
+  pool();
+  return SQLITE_OK;
+}
+
+void shutdown(void*) {
+}
+
+const sqlite3_mem_methods methods = {
+  allocate,
+  deallocate,
+  reallocate,
+  usable_size,
+  roundup,
+  initialize,
+  shutdown,
+  nullptr,
+};
+
+}  // namespace
+
+const sqlite3_mem_methods* pool_allocator() {
+  return &methods;
+}
+
+allocator_statistics pool_allocator_statistics() {
+  allocator_statistics statistics;
+  statistics.sizes = classes().sizes;
+  statistics.allocations.resize(statistics.sizes.size() + 1);
+
+  auto& shared = pool();
+  std::lock_guard<std::mutex> lock(shared.mutex);
+  for (std::size_t i = 0; i < statistics.sizes.size(); i++) {
+    statistics.allocations[i] = shared.retired[i];
+  }
+  statistics.allocations.back() = shared.retired[max_classes];
+  for (auto c : shared.caches) {
+    for (std::size_t i = 0; i < statistics.sizes.size(); i++) {
+      statistics.allocations[i] += c->histogram[i].load(std::memory_order_relaxed);
+    }
+    statistics.allocations.back() += c->histogram[max_classes].load(std::memory_order_relaxed);
+  }
+  statistics.current = shared.current.load(std::memory_order_relaxed);
+  statistics.peak = shared.peak.load(std::memory_order_relaxed);
+  return statistics;
+}
+
+}  // namespace sqlite
@@ -0,0 +1,782 @@
+#include <sqlite/ann.h>
+#include <sqlite/vector.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <numeric>
+#include <queue>
+#include <random>
+#include <utility>
+#include <vector>
+
+namespace sqlite {
+namespace {
+
+// Training samples per centroid and k-means iterations.
+const std::size_t samples_per_list = 64;
+const int iterations = 10;
+
+enum {
+  distance_column,
+  embedding_column,
+  k_column,
+  probes_column,
+};
+
+// Bits of the plan, whose arguments are passed to `filter` in this order.
+enum plan {
+  search = 1,
+  count = 2,
+  probe = 4,
+  row = 8,
+};
+
+std::string quote(const std::string& name) {
+  std::string quoted = "\"";
+  for (auto c : name) {
+    quoted += c;
+    if (c == '"') {
+      quoted += c;
+    }
+  }
+  return quoted + "\"";
+}
+
+// Removes the quotes around a module argument.
+std::string unquote(std::string value) {
+  auto begin = value.find_first_not_of(" \t\n");
+  auto end = value.find_last_not_of(" \t\n");
+  value = begin == std::string::npos ? std::string() : value.substr(begin, end - begin + 1);
+  if (value.size() >= 2 && (value[0] == '"' || value[0] == '\'' || value[0] == '`' || value[0] == '[')) {
+    auto close = value[0] == '[' ? ']' : value[0];
+    if (value.back() == close) {
+      std::string unquoted;
+      for (std::size_t i = 1; i + 1 < value.size(); i++) {
+        unquoted += value[i];
+        if (value[i] == close && value[i + 1] == close) {
+          ++i;
+        }
+      }
+      return unquoted;
+    }
+  }
+  return value;
+}
+
+struct statement {
+  sqlite3_stmt* stmt = nullptr;
+
+  ~statement() {
+    sqlite3_finalize(stmt);
+  }
+
+  // Prepares the statement on first use and returns it reset.
+  sqlite3_stmt* get(sqlite3* db, const std::string& sql) {
+    if (stmt) {
+      sqlite3_reset(stmt);
+    } else if (sqlite3_prepare_v2(db, sql.data(), -1, &stmt, nullptr) != SQLITE_OK) {
+      stmt = nullptr;
+    }
+    return stmt;
+  }
+};
+
+struct table {
+  sqlite3_vtab base;
+  sqlite3* db;
+  std::string schema;
+  std::string name;
+  std::string source;
+  std::string column;
+  std::size_t dimensions = 0;
+  int probes = 8;
+  // Row-major, `dimensions` floats per list. Empty when the index was created without rows,
+  // in which case all vectors are in list 0.
+  std::vector<float> centroids;
+
+  statement scan_list;
+  statement find_list;
+  statement find_vector;
+  statement scan_ids;
+  statement insert_vector;
+  statement insert_id;
+  statement delete_vector;
+  statement delete_id;
+
+  std::string shadow(const char* suffix) const {
+    return quote(schema) + "." + quote(name + suffix);
+  }
+
+  std::size_t lists() const {
+    return dimensions ? centroids.size() / dimensions : 0;
+  }
+
+  int fail(const std::string& message) {
+    sqlite3_free(base.zErrMsg);
+    base.zErrMsg = sqlite3_mprintf("%s", message.data());
+    return SQLITE_ERROR;
+  }
+
+  int fail_sqlite() {
+    return fail(sqlite3_errmsg(db));
+  }
+
+  // Lists ordered by the distance of their centroids to `vector`, nearest first.
+  std::vector<std::size_t> nearest_lists(const float* vector, std::size_t limit) const {
+    std::vector<std::pair<float, std::size_t>> distances(lists());
+    for (std::size_t i = 0; i < distances.size(); i++) {
+      distances[i] = { vector_l2(&centroids[i * dimensions], vector, dimensions), i };
+    }
+    limit = std::min(limit, distances.size());
+    std::partial_sort(distances.begin(), distances.begin() + static_cast<std::ptrdiff_t>(limit), distances.end());
+    std::vector<std::size_t> result;
+    for (std::size_t i = 0; i < limit; i++) {
+      result.push_back(distances[i].second);
+    }
+    if (result.empty()) {
+      result.push_back(0);
+    }
+    return result;
+  }
+
+  int remove(sqlite3_int64 id) {
+    auto find = find_list.get(db, "select list from " + shadow("_lists") + " where id = ?;");
+    if (!find) {
+      return fail_sqlite();
+    }
+    sqlite3_bind_int64(find, 1, id);
+    auto hresult = sqlite3_step(find);
+    if (hresult != SQLITE_ROW) {
+      return hresult == SQLITE_DONE ? SQLITE_OK : fail_sqlite();
+    }
+    auto list = sqlite3_column_int64(find, 0);
+    sqlite3_reset(find);
+
+    auto vectors = delete_vector.get(db, "delete from " + shadow("_vectors") + " where list = ? and id = ?;");
+    auto ids = delete_id.get(db, "delete from " + shadow("_lists") + " where id = ?;");
+    if (!vectors || !ids) {
+      return fail_sqlite();
+    }
+    sqlite3_bind_int64(vectors, 1, list);
+    sqlite3_bind_int64(vectors, 2, id);
+    sqlite3_bind_int64(ids, 1, id);
+    if (sqlite3_step(vectors) != SQLITE_DONE || sqlite3_step(ids) != SQLITE_DONE) {
+      return fail_sqlite();
+    }
+    return SQLITE_OK;
+  }
+
+  int insert(sqlite3_int64 id, const void* blob, std::size_t bytes) {
+    if (bytes != dimensions * sizeof(float)) {
+      return fail("ivf_flat: embedding of row " + std::to_string(id) + " does not have " + std::to_string(dimensions) + " dimensions");
+    }
+    std::vector<float> vector(dimensions);
+    std::memcpy(vector.data(), blob, bytes);
+    auto list = static_cast<sqlite3_int64>(nearest_lists(vector.data(), 1).front());
+
+    auto vectors = insert_vector.get(db, "insert into " + shadow("_vectors") + " (list, id, vector) values (?, ?, ?);");
+    auto ids = insert_id.get(db, "insert into " + shadow("_lists") + " (id, list) values (?, ?);");
+    if (!vectors || !ids) {
+      return fail_sqlite();
+    }
+    sqlite3_bind_int64(vectors, 1, list);
+    sqlite3_bind_int64(vectors, 2, id);
+    sqlite3_bind_blob(vectors, 3, vector.data(), static_cast<int>(bytes), SQLITE_STATIC);
+    sqlite3_bind_int64(ids, 1, id);
+    sqlite3_bind_int64(ids, 2, list);
+    if (sqlite3_step(vectors) != SQLITE_DONE || sqlite3_step(ids) != SQLITE_DONE) {
+      return fail_sqlite();
+    }
+    return SQLITE_OK;
+  }
+};
+
+struct cursor {
+  sqlite3_vtab_cursor base;
+  // Rowids and distances of the result, NaN when not searching.
+  std::vector<std::pair<sqlite3_int64, double>> rows;
+  std::size_t position = 0;
+  sqlite3_int64 k = 0;
+  sqlite3_int64 probes = 0;
+};
+
+// Runs k-means on the samples and returns `lists` centroids.
+std::vector<float> train(const std::vector<float>& samples, std::size_t dimensions, std::size_t lists) {
+  auto count = samples.size() / dimensions;
+  std::mt19937_64 random(count);
+  std::vector<std::size_t> order(count);
+  std::iota(order.begin(), order.end(), 0);
+  std::shuffle(order.begin(), order.end(), random);
+
+  std::vector<float> centroids(lists * dimensions);
+  for (std::size_t i = 0; i < lists; i++) {
+    std::copy_n(&samples[order[i] * dimensions], dimensions, &centroids[i * dimensions]);
+  }
+
+  std::vector<std::size_t> assignment(count);
+  std::vector<double> sums(lists * dimensions);
+  std::vector<std::size_t> sizes(lists);
+  for (int iteration = 0; iteration < iterations; iteration++) {
+    for (std::size_t s = 0; s < count; s++) {
+      auto best = std::numeric_limits<float>::max();
+      for (std::size_t c = 0; c < lists; c++) {
+        auto distance = vector_l2(&centroids[c * dimensions], &samples[s * dimensions], dimensions);
+        if (distance < best) {
+          best = distance;
+          assignment[s] = c;
+        }
+      }
+    }
+    std::fill(sums.begin(), sums.end(), 0.0);
+    std::fill(sizes.begin(), sizes.end(), 0);
+    for (std::size_t s = 0; s < count; s++) {
+      auto c = assignment[s];
+      ++sizes[c];
+      for (std::size_t d = 0; d < dimensions; d++) {
+        sums[c * dimensions + d] += samples[s * dimensions + d];
+      }
+    }
+    for (std::size_t c = 0; c < lists; c++) {
+      if (!sizes[c]) {
+        // An empty list restarts at a random sample.
+        std::copy_n(&samples[order[random() % count] * dimensions], dimensions, &centroids[c * dimensions]);
+        continue;
+      }
+      for (std::size_t d = 0; d < dimensions; d++) {
+        centroids[c * dimensions + d] = static_cast<float>(sums[c * dimensions + d] / static_cast<double>(sizes[c]));
+      }
+    }
+  }
+  return centroids;
+}
+
+int exec(sqlite3* db, const std::string& sql, char** error) {
+  return sqlite3_exec(db, sql.data(), nullptr, nullptr, error);
+}
+
+// Creates the shadow tables, trains the centroids on a sample of the base table, fills the
+// lists and creates the triggers.
+int build(table& t, std::size_t lists, char** error) {
+  auto hresult = exec(t.db,
+                      "create table " + t.shadow("_config") + " (source text, column text, dimensions integer, probes integer);"
+                      "create table " + t.shadow("_centroids") + " (list integer primary key, centroid blob);"
+                      "create table " + t.shadow("_vectors") + " (list integer, id integer, vector blob, primary key (list, id)) without rowid;"
+                      "create table " + t.shadow("_lists") + " (id integer primary key, list integer);",
+                      error);
+  if (hresult != SQLITE_OK) {
+    return hresult;
+  }
+
+  sqlite3_stmt* config = nullptr;
+  hresult = sqlite3_prepare_v2(t.db, ("insert into " + t.shadow("_config") + " values (?, ?, ?, ?);").data(), -1, &config, nullptr);
+  if (hresult == SQLITE_OK) {
+    sqlite3_bind_text(config, 1, t.source.data(), static_cast<int>(t.source.size()), SQLITE_STATIC);
+    sqlite3_bind_text(config, 2, t.column.data(), static_cast<int>(t.column.size()), SQLITE_STATIC);
+    sqlite3_bind_int64(config, 3, static_cast<sqlite3_int64>(t.dimensions));
+    sqlite3_bind_int(config, 4, t.probes);
+    sqlite3_step(config);
+    hresult = sqlite3_finalize(config);
+  }
+  if (hresult != SQLITE_OK) {
+    *error = sqlite3_mprintf("%s", sqlite3_errmsg(t.db));
+    return hresult;
+  }
+
+  // Reservoir sample of the embeddings.
+  auto select = "select rowid, " + quote(t.column) + " from " + quote(t.schema) + "." + quote(t.source) + " where " + quote(t.column) +
+                " is not null;";
+  sqlite3_stmt* rows = nullptr;
+  if (sqlite3_prepare_v2(t.db, select.data(), -1, &rows, nullptr) != SQLITE_OK) {
+    *error = sqlite3_mprintf("%s", sqlite3_errmsg(t.db));
+    return SQLITE_ERROR;
+  }
+  if (!lists) {
+    sqlite3_stmt* count = nullptr;
+    auto sql = "select count(*) from " + quote(t.schema) + "." + quote(t.source) + " where " + quote(t.column) + " is not null;";
+    if (sqlite3_prepare_v2(t.db, sql.data(), -1, &count, nullptr) != SQLITE_OK) {
+      *error = sqlite3_mprintf("%s", sqlite3_errmsg(t.db));
+      return SQLITE_ERROR;
+    }
+    if (sqlite3_step(count) == SQLITE_ROW) {
+      lists = static_cast<std::size_t>(std::sqrt(static_cast<double>(sqlite3_column_int64(count, 0))));
+    }
+    sqlite3_finalize(count);
+  }
+
+  auto bytes = t.dimensions * sizeof(float);
+  auto capacity = std::max<std::size_t>(lists, 1) * samples_per_list;
+  std::vector<float> samples;
+  std::size_t seen = 0;
+  std::mt19937_64 random(42);
+  while ((hresult = sqlite3_step(rows)) == SQLITE_ROW) {
+    // Rejected here already, as the lists and the triggers would reject them.
+    if (static_cast<std::size_t>(sqlite3_column_bytes(rows, 1)) != bytes) {
+      *error = sqlite3_mprintf("ivf_flat: embedding of row %lld does not have %d dimensions", sqlite3_column_int64(rows, 0),
+                               static_cast<int>(t.dimensions));
+      sqlite3_finalize(rows);
+      return SQLITE_ERROR;
+    }
+    auto blob = sqlite3_column_blob(rows, 1);
+    auto slot = seen < capacity ? seen : random() % (seen + 1);
+    if (slot < capacity) {
+      if (slot * t.dimensions >= samples.size()) {
+        samples.resize((slot + 1) * t.dimensions);
+      }
+      std::memcpy(&samples[slot * t.dimensions], blob, bytes);
+    }
+    ++seen;
+  }
+  sqlite3_finalize(rows);
+  if (hresult != SQLITE_DONE) {
+    *error = sqlite3_mprintf("%s", sqlite3_errmsg(t.db));
+    return hresult;
+  }
+
+  lists = std::min(std::max<std::size_t>(lists, 1), seen);
+  if (lists) {
+    t.centroids = train(samples, t.dimensions, lists);
+  }
+  sqlite3_stmt* centroid = nullptr;
+  if (sqlite3_prepare_v2(t.db, ("insert into " + t.shadow("_centroids") + " values (?, ?);").data(), -1, &centroid, nullptr) != SQLITE_OK) {
+    *error = sqlite3_mprintf("%s", sqlite3_errmsg(t.db));
+    return SQLITE_ERROR;
+  }
+  for (std::size_t i = 0; i < lists; i++) {
+    sqlite3_bind_int64(centroid, 1, static_cast<sqlite3_int64>(i));
+    sqlite3_bind_blob(centroid, 2, &t.centroids[i * t.dimensions], static_cast<int>(bytes), SQLITE_STATIC);
+    sqlite3_step(centroid);
+    sqlite3_reset(centroid);
+  }
+  if (sqlite3_finalize(centroid) != SQLITE_OK) {
+    *error = sqlite3_mprintf("%s", sqlite3_errmsg(t.db));
+    return SQLITE_ERROR;
+  }
+
+  if (sqlite3_prepare_v2(t.db, select.data(), -1, &rows, nullptr) != SQLITE_OK) {
+    *error = sqlite3_mprintf("%s", sqlite3_errmsg(t.db));
+    return SQLITE_ERROR;
+  }
+  while ((hresult = sqlite3_step(rows)) == SQLITE_ROW) {
+    hresult = t.insert(sqlite3_column_int64(rows, 0), sqlite3_column_blob(rows, 1), static_cast<std::size_t>(sqlite3_column_bytes(rows, 1)));
+    if (hresult != SQLITE_OK) {
+      break;
+    }
+  }
+  sqlite3_finalize(rows);
+  if (hresult != SQLITE_DONE) {
+    *error = sqlite3_mprintf("%s", t.base.zErrMsg ? t.base.zErrMsg : sqlite3_errmsg(t.db));
+    return SQLITE_ERROR;
+  }
+
+  auto index = quote(t.name);
+  auto source = quote(t.source);
+  auto column = quote(t.column);
+  return exec(t.db,
+              "create trigger " + t.shadow("_insert") + " after insert on " + source + " begin insert into " + index +
+                  " (rowid, " + column + ") values (new.rowid, new." + column + "); end;"
+              "create trigger " + t.shadow("_update") + " after update on " + source + " when old.rowid is not new.rowid or old." + column +
+                  " is not new." + column + " begin delete from " + index +
+                  " where rowid = old.rowid; insert into " + index + " (rowid, " + column + ") values (new.rowid, new." + column + "); end;"
+              "create trigger " + t.shadow("_delete") + " after delete on " + source + " begin delete from " + index +
+                  " where rowid = old.rowid; end;",
+              error);
+}
+
+// Reads the configuration and the centroids of an existing index.
+int load(table& t, char** error) {
+  sqlite3_stmt* stmt = nullptr;
+  auto sql = "select source, column, dimensions, probes from " + t.shadow("_config") + ";";
+  if (sqlite3_prepare_v2(t.db, sql.data(), -1, &stmt, nullptr) != SQLITE_OK) {
+    *error = sqlite3_mprintf("%s", sqlite3_errmsg(t.db));
+    return SQLITE_ERROR;
+  }
+  if (sqlite3_step(stmt) == SQLITE_ROW) {
+    auto source = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0));
+    auto column = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1));
+    // A configuration without source or column is treated as missing.
+    if (source && column) {
+      t.source = source;
+      t.column = column;
+      t.dimensions = static_cast<std::size_t>(sqlite3_column_int64(stmt, 2));
+      t.probes = sqlite3_column_int(stmt, 3);
+    }
+  }
+  sqlite3_finalize(stmt);
+  if (!t.dimensions) {
+    *error = sqlite3_mprintf("ivf_flat: %s has no configuration", t.name.data());
+    return SQLITE_CORRUPT;
+  }
+
+  sql = "select centroid from " + t.shadow("_centroids") + " order by list;";
+  if (sqlite3_prepare_v2(t.db, sql.data(), -1, &stmt, nullptr) != SQLITE_OK) {
+    *error = sqlite3_mprintf("%s", sqlite3_errmsg(t.db));
+    return SQLITE_ERROR;
+  }
+  auto bytes = t.dimensions * sizeof(float);
+  while (sqlite3_step(stmt) == SQLITE_ROW) {
+    if (static_cast<std::size_t>(sqlite3_column_bytes(stmt, 0)) != bytes) {
+      continue;
+    }
+    t.centroids.resize(t.centroids.size() + t.dimensions);
+    std::memcpy(&t.centroids[t.centroids.size() - t.dimensions], sqlite3_column_blob(stmt, 0), bytes);
+  }
+  return sqlite3_finalize(stmt);
+}
+
+int open_table(sqlite3* db, int argc, const char* const* argv, sqlite3_vtab** vtab, char** error, bool create) {
+  auto t = new table();
+  t->db = db;
+  t->schema = argv[1];
+  t->name = argv[2];
+
+  int hresult;
+  std::size_t lists = 0;
+  if (create) {
+    for (int i = 3; i < argc; i++) {
+      std::string argument = argv[i];
+      auto equals = argument.find('=');
+      auto key = unquote(argument.substr(0, equals));
+      auto value = equals == std::string::npos ? std::string() : unquote(argument.substr(equals + 1));
+      if (key == "table") {
+        t->source = value;
+      } else if (key == "column") {
+        t->column = value;
+      } else if (key == "dimensions") {
+        t->dimensions = static_cast<std::size_t>(std::max(std::atoi(value.data()), 0));
+      } else if (key == "lists") {
+        lists = static_cast<std::size_t>(std::max(std::atoi(value.data()), 0));
+      } else if (key == "probes") {
+        t->probes = std::max(std::atoi(value.data()), 1);
+      } else {
+        *error = sqlite3_mprintf("ivf_flat: unknown argument %s", argument.data());
+        delete t;
+        return SQLITE_ERROR;
+      }
+    }
+    if (t->source.empty() || t->column.empty() || !t->dimensions) {
+      *error = sqlite3_mprintf("ivf_flat: table, column and dimensions are required");
+      delete t;
+      return SQLITE_ERROR;
+    }
+  } else {
+    hresult = load(*t, error);
+    if (hresult != SQLITE_OK) {
+      delete t;
+      return hresult;
+    }
+  }
+
+  // The query vector is passed to a hidden column named like the indexed column.
+  hresult = sqlite3_declare_vtab(db, ("create table x(distance real, " + quote(t->column) + " hidden, k hidden, probes hidden);").data());
+  if (hresult == SQLITE_OK && create) {
+    hresult = build(*t, lists, error);
+  }
+  if (hresult != SQLITE_OK) {
+    sqlite3_free(t->base.zErrMsg);
+    delete t;
+    return hresult;
+  }
+  *vtab = &t->base;
+  return SQLITE_OK;
+}
+
+int create(sqlite3* db, void*, int argc, const char* const* argv, sqlite3_vtab** vtab, char** error) {
+  return open_table(db, argc, argv, vtab, error, true);
+}
+
+int connect(sqlite3* db, void*, int argc, const char* const* argv, sqlite3_vtab** vtab, char** error) {
+  return open_table(db, argc, argv, vtab, error, false);
+}
+
+int disconnect(sqlite3_vtab* vtab) {
+  sqlite3_free(vtab->zErrMsg);
+  delete reinterpret_cast<table*>(vtab);
+  return SQLITE_OK;
+}
+
+int destroy(sqlite3_vtab* vtab) {
+  auto& t = *reinterpret_cast<table*>(vtab);
+  std::string sql;
+  for (auto trigger : { "_insert", "_update", "_delete" }) {
+    sql += "drop trigger if exists " + t.shadow(trigger) + ";";
+  }
+  for (auto shadow : { "_config", "_centroids", "_vectors", "_lists" }) {
+    sql += "drop table if exists " + t.shadow(shadow) + ";";
+  }
+  auto hresult = exec(t.db, sql, nullptr);
+  if (hresult != SQLITE_OK) {
+    return hresult;
+  }
+  return disconnect(vtab);
+}
+
+int best_index(sqlite3_vtab* vtab, sqlite3_index_info* info) {
+  auto& t = *reinterpret_cast<table*>(vtab);
+  int constraints[4] = { -1, -1, -1, -1 };
+  for (int i = 0; i < info->nConstraint; i++) {
+    auto& c = info->aConstraint[i];
+    if (!c.usable) {
+      continue;
+    }
+    if (c.iColumn == embedding_column && (c.op == SQLITE_INDEX_CONSTRAINT_MATCH || c.op == SQLITE_INDEX_CONSTRAINT_EQ)) {
+      constraints[0] = i;
+    } else if (c.iColumn == k_column && c.op == SQLITE_INDEX_CONSTRAINT_EQ) {
+      constraints[1] = i;
+    } else if (c.iColumn == probes_column && c.op == SQLITE_INDEX_CONSTRAINT_EQ) {
+      constraints[2] = i;
+    } else if (c.iColumn == -1 && c.op == SQLITE_INDEX_CONSTRAINT_EQ) {
+      constraints[3] = i;
+    }
+  }
+  int plan = 0;
+  int argument = 0;
+  for (int bit = 0; bit < 4; bit++) {
+    if (constraints[bit] >= 0) {
+      plan |= 1 << bit;
+      info->aConstraintUsage[constraints[bit]].argvIndex = ++argument;
+      info->aConstraintUsage[constraints[bit]].omit = 1;
+    }
+  }
+  info->idxNum = plan;
+
+  double rows;
+  if (plan & row) {
+    info->estimatedCost = 1;
+    rows = 1;
+  } else if (plan & search) {
+    info->estimatedCost = static_cast<double>(t.lists() + t.probes * 1000);
+    rows = 10;
+    if (info->nOrderBy == 1 && info->aOrderBy[0].iColumn == distance_column && !info->aOrderBy[0].desc) {
+      info->orderByConsumed = 1;
+    }
+  } else {
+    info->estimatedCost = 1e12;
+    rows = 1e6;
+  }
+  if (sqlite3_libversion_number() >= 3008002) {
+    info->estimatedRows = static_cast<sqlite3_int64>(rows);
+  }
+  return SQLITE_OK;
+}
+
+int open(sqlite3_vtab*, sqlite3_vtab_cursor** out) {
+  auto c = new cursor();
+  *out = &c->base;
+  return SQLITE_OK;
+}
+
+int close(sqlite3_vtab_cursor* c) {
+  delete reinterpret_cast<cursor*>(c);
+  return SQLITE_OK;
+}
+
+int filter(sqlite3_vtab_cursor* base, int plan, const char*, int, sqlite3_value** arguments) {
+  auto& c = *reinterpret_cast<cursor*>(base);
+  auto& t = *reinterpret_cast<table*>(base->pVtab);
+  c.rows.clear();
+  c.position = 0;
+  auto none = std::numeric_limits<double>::quiet_NaN();
+
+  sqlite3_value* query = (plan & search) ? *arguments++ : nullptr;
+  c.k = (plan & count) ? sqlite3_value_int64(*arguments++) : 10;
+  c.probes = (plan & probe) ? sqlite3_value_int64(*arguments++) : t.probes;
+
+  if (plan & row) {
+    auto id = sqlite3_value_int64(*arguments++);
+    auto find = t.find_list.get(t.db, "select list from " + t.shadow("_lists") + " where id = ?;");
+    if (!find) {
+      return t.fail_sqlite();
+    }
+    sqlite3_bind_int64(find, 1, id);
+    if (sqlite3_step(find) == SQLITE_ROW) {
+      c.rows.emplace_back(id, none);
+    }
+    sqlite3_reset(find);
+    if (!query) {
+      return SQLITE_OK;
+    }
+  }
+
+  if (!query) {
+    auto scan = t.scan_ids.get(t.db, "select id from " + t.shadow("_lists") + " order by id;");
+    if (!scan) {
+      return t.fail_sqlite();
+    }
+    while (sqlite3_step(scan) == SQLITE_ROW) {
+      c.rows.emplace_back(sqlite3_column_int64(scan, 0), none);
+    }
+    sqlite3_reset(scan);
+    return SQLITE_OK;
+  }
+
+  if (sqlite3_value_type(query) == SQLITE_NULL || c.k <= 0) {
+    c.rows.clear();
+    return SQLITE_OK;
+  }
+  auto bytes = t.dimensions * sizeof(float);
+  if (static_cast<std::size_t>(sqlite3_value_bytes(query)) != bytes) {
+    return t.fail("ivf_flat: the query vector does not have " + std::to_string(t.dimensions) + " dimensions");
+  }
+  std::vector<float> target(t.dimensions);
+  std::memcpy(target.data(), sqlite3_value_blob(query), bytes);
+
+  // With a rowid constraint only that row is a candidate.
+  if (plan & row) {
+    if (c.rows.empty()) {
+      return SQLITE_OK;
+    }
+    auto id = c.rows.front().first;
+    c.rows.clear();
+    auto find = t.find_vector.get(t.db, "select v.vector from " + t.shadow("_lists") + " l join " + t.shadow("_vectors") +
+                                            " v on v.list = l.list and v.id = l.id where l.id = ?;");
+    if (!find) {
+      return t.fail_sqlite();
+    }
+    sqlite3_bind_int64(find, 1, id);
+    if (sqlite3_step(find) == SQLITE_ROW && static_cast<std::size_t>(sqlite3_column_bytes(find, 0)) == bytes) {
+      c.rows.emplace_back(id, vector_l2(static_cast<const float*>(sqlite3_column_blob(find, 0)), target.data(), t.dimensions));
+    }
+    sqlite3_reset(find);
+    return SQLITE_OK;
+  }
+
+  // The k nearest candidates are kept in a max-heap on their distance.
+  std::priority_queue<std::pair<float, sqlite3_int64>> nearest;
+  auto k = static_cast<std::size_t>(c.k);
+  auto scan = t.scan_list.get(t.db, "select id, vector from " + t.shadow("_vectors") + " where list = ?;");
+  if (!scan) {
+    return t.fail_sqlite();
+  }
+  for (auto list : t.nearest_lists(target.data(), static_cast<std::size_t>(std::max<sqlite3_int64>(c.probes, 1)))) {
+    sqlite3_reset(scan);
+    sqlite3_bind_int64(scan, 1, static_cast<sqlite3_int64>(list));
+    while (sqlite3_step(scan) == SQLITE_ROW) {
+      if (static_cast<std::size_t>(sqlite3_column_bytes(scan, 1)) != bytes) {
+        continue;
+      }
+      // Records do not align BLOBs, and the kernels load unaligned.
+      auto distance = vector_l2(static_cast<const float*>(sqlite3_column_blob(scan, 1)), target.data(), t.dimensions);
+      if (nearest.size() < k) {
+        nearest.emplace(distance, sqlite3_column_int64(scan, 0));
+      } else if (distance < nearest.top().first) {
+        nearest.pop();
+        nearest.emplace(distance, sqlite3_column_int64(scan, 0));
+      }
+    }
+  }
+  sqlite3_reset(scan);
+  c.rows.resize(nearest.size());
+  for (auto i = c.rows.size(); i-- > 0;) {
+    c.rows[i] = { nearest.top().second, nearest.top().first };
+    nearest.pop();
+  }
+  return SQLITE_OK;
+}
+
+int next(sqlite3_vtab_cursor* c) {
+  reinterpret_cast<cursor*>(c)->position++;
+  return SQLITE_OK;
+}
+
+int eof(sqlite3_vtab_cursor* c) {
+  auto& self = *reinterpret_cast<cursor*>(c);
+  return self.position >= self.rows.size();
+}
+
+int column(sqlite3_vtab_cursor* base, sqlite3_context* context, int index) {
+  auto& c = *reinterpret_cast<cursor*>(base);
+  auto& row = c.rows[c.position];
+  if (index == distance_column && !std::isnan(row.second)) {
+    sqlite3_result_double(context, row.second);
+  } else if (index == k_column) {
+    sqlite3_result_int64(context, c.k);
+  } else if (index == probes_column) {
+    sqlite3_result_int64(context, c.probes);
+  } else {
+    sqlite3_result_null(context);
+  }
+  return SQLITE_OK;
+}
+
+int rowid(sqlite3_vtab_cursor* base, sqlite3_int64* id) {
+  auto& c = *reinterpret_cast<cursor*>(base);
+  *id = c.rows[c.position].first;
+  return SQLITE_OK;
+}
+
+// Called by the triggers on the base table. Deletes pass the rowid, and inserts and updates
+// the old rowid, or NULL, the new rowid and the columns.
+int update(sqlite3_vtab* vtab, int argc, sqlite3_value** argv, sqlite3_int64* id) {
+  auto& t = *reinterpret_cast<table*>(vtab);
+  if (sqlite3_value_type(argv[0]) != SQLITE_NULL) {
+    auto hresult = t.remove(sqlite3_value_int64(argv[0]));
+    if (hresult != SQLITE_OK || argc == 1) {
+      return hresult;
+    }
+  }
+  if (sqlite3_value_type(argv[1]) == SQLITE_NULL) {
+    return t.fail("ivf_flat: rows are inserted with the rowid of the base table");
+  }
+  *id = sqlite3_value_int64(argv[1]);
+  auto hresult = t.remove(*id);
+  auto embedding = argv[2 + embedding_column];
+  if (hresult != SQLITE_OK || sqlite3_value_type(embedding) == SQLITE_NULL) {
+    return hresult;
+  }
+  return t.insert(*id, sqlite3_value_blob(embedding), static_cast<std::size_t>(sqlite3_value_bytes(embedding)));
+}
+
+const sqlite3_module ann_module = {
+  1,
+  create,
+  connect,
+  best_index,
+  disconnect,
+  destroy,
+  open,
+  close,
+  filter,
+  next,
+  eof,
+  column,
+  rowid,
+  update,
+  nullptr,
+  nullptr,
+  nullptr,
+  nullptr,
+  nullptr,
+  nullptr,
+  nullptr,
+  nullptr,
+  nullptr,
+};
+
+}  // namespace
+
+void define_ann(const database& db) {
+  auto hresult = sqlite3_create_module(db.handle(), "ivf_flat", &ann_module, nullptr);
+  if (hresult != SQLITE_OK) {
+    throw sqlite_exception(sqlite3_errstr(hresult));
+  }
+}
+
+void create_ann_index(const database& db, const std::string& name, const std::string& table, const std::string& column,
+                      const ann_options& options) {
+  // Executed directly, since statements that the binder runs on destruction do not throw.
+  char* error = nullptr;
+  auto hresult = exec(db.handle(),
+                      "create virtual table " + quote(name) + " using ivf_flat(table=" + quote(table) + ", column=" + quote(column) +
+                          ", dimensions=" + std::to_string(options.dimensions) + ", lists=" + std::to_string(options.lists) +
+                          ", probes=" + std::to_string(options.probes) + ");",
+                      &error);
+  if (hresult != SQLITE_OK) {
+    sqlite_exception e(error ? error : sqlite3_errstr(hresult));
+    sqlite3_free(error);
+    throw e;
+  }
+}
+
+}  // namespace sqlite
@@ -0,0 +1,227 @@
+#include <sqlite/approximate.h>
+#include <algorithm>
+#include <cmath>
+#include <memory>
+
+namespace sqlite {
+namespace {
+
+const double pi = 3.14159265358979323846;
+
+struct quantile_aggregate {
+  tdigest digest;
+  double fraction = 0.5;
+
+  void step(sqlite3_value* value, double q) {
+    if (sqlite3_value_type(value) != SQLITE_NULL) {
+      digest.add(sqlite3_value_double(value));
+      fraction = q;
+    }
+  }
+
+  std::unique_ptr<double> final() {
+    if (!digest.count()) {
+      return nullptr;
+    }
+    return std::unique_ptr<double>(new double(digest.quantile(fraction)));
+  }
+};
+
+struct median_aggregate {
+  quantile_aggregate quantile;
+
+  void step(sqlite3_value* value) {
+    quantile.step(value, 0.5);
+  }
+
+  std::unique_ptr<double> final() {
+    return quantile.final();
+  }
+};
+
+struct distinct_count_aggregate {
+  hyperloglog sketch;
+
+  void step(sqlite3_value* value) {
+    auto type = sqlite3_value_type(value);
+    if (type == SQLITE_NULL) {
+      return;
+    }
+    // Reals with an integer value hash like the integer.
+    if (type == SQLITE_FLOAT) {
+      auto real = sqlite3_value_double(value);
+      if (real >= -9.2e18 && real <= 9.2e18 && real == std::floor(real)) {
+        type = SQLITE_INTEGER;
+      }
+    }
+    std::uint64_t hash;
+    if (type == SQLITE_INTEGER) {
+      auto integer = sqlite3_value_int64(value);
+      hash = hyperloglog::hash(&integer, sizeof(integer));
+    } else if (type == SQLITE_FLOAT) {
+      auto real = sqlite3_value_double(value);
+      hash = hyperloglog::hash(&real, sizeof(real)) ^ 0x9e3779b97f4a7c15ull;
+    } else if (type == SQLITE_TEXT) {
+      auto text = sqlite3_value_text(value);
+      hash = hyperloglog::hash(text, static_cast<std::size_t>(sqlite3_value_bytes(value))) ^ 0xc2b2ae3d27d4eb4full;
+    } else {
+      auto blob = sqlite3_value_blob(value);
+      hash = hyperloglog::hash(blob, static_cast<std::size_t>(sqlite3_value_bytes(value))) ^ 0x165667b19e3779f9ull;
+    }
+    sketch.add(hash);
+  }
+
+  sqlite3_int64 final() {
+    return static_cast<sqlite3_int64>(sketch.estimate());
+  }
+};
+
+}  // namespace
+
+tdigest::tdigest(double compression) : compression_(std::max(compression, 10.0)) {
+}
+
+void tdigest::add(double value) {
+  if (std::isnan(value)) {
+    return;
+  }
+  if (count_ == 0) {
+    min_ = max_ = value;
+  } else {
+    min_ = std::min(min_, value);
+    max_ = std::max(max_, value);
+  }
+  count_ += 1;
+  buffer_.push_back(value);
+  if (buffer_.size() >= static_cast<std::size_t>(5 * compression_)) {
+    merge();
+  }
+}
+
+// Merges the buffered values into the centroids. Adjacent centroids are combined as long as
+// the combination spans less than one unit of the scale function
+// k(q) = compression / (2 pi) * asin(2q - 1).
+void tdigest::merge() {
+  if (buffer_.empty()) {
+    return;
+  }
+  std::sort(buffer_.begin(), buffer_.end());
+  std::vector<centroid> all;
+  all.reserve(centroids_.size() + buffer_.size());
+  auto c = centroids_.begin();
+  for (auto value : buffer_) {
+    for (; c != centroids_.end() && c->mean <= value; ++c) {
+      all.push_back(*c);
+    }
+    all.push_back(centroid{ value, 1 });
+  }
+  all.insert(all.end(), c, centroids_.end());
+  buffer_.clear();
+
+  auto scale = [this](double q) {
+    return compression_ / (2 * pi) * std::asin(2 * q - 1);
+  };
+  auto inverse = [this](double k) {
+    return (std::sin(std::min(k * 2 * pi / compression_, pi / 2)) + 1) / 2;
+  };
+
+  centroids_.clear();
+  auto current = all.front();
+  double before = 0;
+  auto limit = count_ * inverse(scale(0) + 1);
+  for (std::size_t i = 1; i < all.size(); i++) {
+    auto& next = all[i];
+    if (before + current.weight + next.weight <= limit) {
+      current.weight += next.weight;
+      current.mean += (next.mean - current.mean) * next.weight / current.weight;
+    } else {
+      before += current.weight;
+      centroids_.push_back(current);
+      limit = count_ * inverse(scale(before / count_) + 1);
+      current = next;
+    }
+  }
+  centroids_.push_back(current);
+}
+
+double tdigest::quantile(double fraction) {
+  merge();
+  if (centroids_.empty()) {
+    return 0;
+  }
+  if (fraction <= 0) {
+    return min_;
+  }
+  if (fraction >= 1) {
+    return max_;
+  }
+  auto target = fraction * count_;
+
+  // Each centroid is placed at the middle of its weight, and the values between two
+  // centroids are interpolated linearly.
+  double position = centroids_.front().weight / 2;
+  if (target < position) {
+    return min_ + (centroids_.front().mean - min_) * target / position;
+  }
+  for (std::size_t i = 1; i < centroids_.size(); i++) {
+    auto next = position + (centroids_[i - 1].weight + centroids_[i].weight) / 2;
+    if (target < next) {
+      auto t = (target - position) / (next - position);
+      return centroids_[i - 1].mean + (centroids_[i].mean - centroids_[i - 1].mean) * t;
+    }
+    position = next;
+  }
+  auto rest = count_ - position;
+  auto t = rest > 0 ? (target - position) / rest : 1;
+  return centroids_.back().mean + (max_ - centroids_.back().mean) * std::min(t, 1.0);
+}
+
+void hyperloglog::add(std::uint64_t hash) {
+  auto index = static_cast<std::size_t>(hash >> (64 - precision));
+  auto rest = (hash << precision) | (std::uint64_t(1) << (precision - 1));
+  std::uint8_t rank = 1;
+  while (!(rest & (std::uint64_t(1) << 63))) {
+    rest <<= 1;
+    ++rank;
+  }
+  registers_[index] = std::max(registers_[index], rank);
+}
+
+std::uint64_t hyperloglog::estimate() const {
+  const double m = static_cast<double>(registers_.size());
+  double sum = 0;
+  std::size_t zeros = 0;
+  for (auto r : registers_) {
+    sum += std::ldexp(1.0, -r);
+    zeros += r == 0;
+  }
+  auto estimate = 0.7213 / (1 + 1.079 / m) * m * m / sum;
+  // Linear counting is more accurate for small cardinalities.
+  if (estimate <= 2.5 * m && zeros) {
+    estimate = m * std::log(m / static_cast<double>(zeros));
+  }
+  return static_cast<std::uint64_t>(std::llround(estimate));
+}
+
+// FNV-1a followed by the MurmurHash3 finalizer, which spreads the bits of short inputs.
+std::uint64_t hyperloglog::hash(const void* data, std::size_t size) {
+  auto bytes = static_cast<const unsigned char*>(data);
+  std::uint64_t h = 0xcbf29ce484222325ull;
+  for (std::size_t i = 0; i < size; i++) {
+    h = (h ^ bytes[i]) * 0x100000001b3ull;
+  }
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdull;
+  h ^= h >> 33;
+  h *= 0xc4ceb9fe1a85ec53ull;
+  h ^= h >> 33;
+  return h;
+}
+
+void define_approximate_aggregates(const database& db) {
+  db.define_aggregate<quantile_aggregate>("approx_quantile");
+  db.define_aggregate<median_aggregate>("approx_median");
+  db.define_aggregate<distinct_count_aggregate>("approx_count_distinct");
+}
+
+}  // namespace sqlite
@@ -0,0 +1,212 @@
+#include <sqlite/backup.h>
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+
+namespace sqlite {
+
+struct backup::state {
+  sqlite3* source = nullptr;
+  sqlite3* destination = nullptr;
+  bool owns_destination = false;
+  backup_options options;
+
+  std::atomic<bool> cancelled{ false };
+  std::mutex mutex;
+  backup_progress progress;
+  int result = SQLITE_OK;
+  std::string message;
+  std::thread thread;
+
+  ~state() {
+    if (owns_destination) {
+      sqlite3_close_v2(destination);
+    }
+  }
+
+  int page_size() const {
+    sqlite3_stmt* stmt = nullptr;
+    int size = 4096;
+    if (sqlite3_prepare_v2(source, "pragma main.page_size;", -1, &stmt, nullptr) == SQLITE_OK && sqlite3_step(stmt) == SQLITE_ROW) {
+      size = sqlite3_column_int(stmt, 0);
+    }
+    sqlite3_finalize(stmt);
+    return size;
+  }
+
+  void run() {
+    auto handle = sqlite3_backup_init(destination, "main", source, "main");
+    if (!handle) {
+      std::lock_guard<std::mutex> lock(mutex);
+      result = sqlite3_errcode(destination);
+      message = sqlite3_errmsg(destination);
+      progress.done = true;
+      return;
+    }
+
+    auto bytes_per_page = static_cast<double>(page_size());
+    auto start = std::chrono::steady_clock::now();
+    double copied = 0;
+    // Pages of the current pass that have been copied. The remaining count also grows when
+    // the source grows, so restarts are found by this count going back instead.
+    int done = 0;
+    std::size_t restarts = 0;
+
+    int hresult = SQLITE_OK;
+    while (!cancelled) {
+      auto pages = options.pages_per_step;
+      if (options.max_restarts && restarts >= options.max_restarts) {
+        if (!options.lock_to_finish) {
+          std::lock_guard<std::mutex> lock(mutex);
+          result = SQLITE_BUSY;
+          message = "backup did not converge after " + std::to_string(restarts) + " restarts";
+          break;
+        }
+        pages = -1;
+      }
+      hresult = sqlite3_backup_step(handle, pages);
+      auto remaining = sqlite3_backup_remaining(handle);
+      auto total = sqlite3_backup_pagecount(handle);
+
+      // A step that succeeds copies `pages` pages unless it reaches the end, and a restart
+      // begins the next step at the first page.
+      auto now_done = total - remaining;
+      auto expected = hresult == SQLITE_OK ? done + pages : done;
+      if (hresult != SQLITE_DONE && now_done < expected) {
+        restarts++;
+        copied += now_done * bytes_per_page;
+      } else {
+        copied += std::max(now_done - done, 0) * bytes_per_page;
+      }
+      done = now_done;
+
+      backup_progress current;
+      current.remaining = remaining;
+      current.total = total;
+      current.restarts = restarts;
+      current.done = hresult == SQLITE_DONE;
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        progress = current;
+      }
+      if (options.progress) {
+        options.progress(current);
+      }
+
+      if (hresult == SQLITE_DONE) {
+        break;
+      }
+      if (hresult == SQLITE_BUSY || hresult == SQLITE_LOCKED) {
+        std::this_thread::sleep_for(options.retry);
+        continue;
+      }
+      if (hresult != SQLITE_OK) {
+        break;
+      }
+
+      if (options.max_rate > 0) {
+        auto due = start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+          std::chrono::duration<double>(copied / (options.max_rate * 1024 * 1024)));
+        std::this_thread::sleep_until(due);
+      }
+    }
+
+    auto finished = sqlite3_backup_finish(handle);
+    std::lock_guard<std::mutex> lock(mutex);
+    if (result != SQLITE_OK) {
+      return;
+    }
+    if (hresult != SQLITE_DONE && hresult != SQLITE_OK) {
+      result = hresult;
+    } else if (finished != SQLITE_OK) {
+      result = finished;
+    }
+    if (result != SQLITE_OK) {
+      message = sqlite3_errmsg(destination);
+    }
+  }
+};
+
+backup::backup(sqlite3* source, sqlite3* destination, bool owns_destination, const backup_options& options)
+  : state_(std::make_shared<state>()) {
+  state_->source = source;
+  state_->destination = destination;
+  state_->owns_destination = owns_destination;
+  state_->options = options;
+  state_->options.pages_per_step = std::max(options.pages_per_step, 1);
+  auto s = state_;
+  state_->thread = std::thread([s]() {
+    s->run();
+  });
+}
+
+backup& backup::operator=(backup&& other) {
+  if (this != &other) {
+    stop();
+    state_ = std::move(other.state_);
+  }
+  return *this;
+}
+
+backup::~backup() {
+  stop();
+}
+
+void backup::stop() {
+  if (state_) {
+    state_->cancelled = true;
+    if (state_->thread.joinable()) {
+      state_->thread.join();
+    }
+  }
+}
+
+void backup::wait() {
+  if (!state_) {
+    throw sqlite_exception("backup was moved");
+  }
+  if (state_->thread.joinable()) {
+    state_->thread.join();
+  }
+  std::lock_guard<std::mutex> lock(state_->mutex);
+  if (state_->result != SQLITE_OK) {
+    throw sqlite_exception(state_->message.data());
+  }
+  if (!state_->progress.done) {
+    throw sqlite_exception("backup was cancelled");
+  }
+}
+
+void backup::cancel() {
+  if (state_) {
+    state_->cancelled = true;
+  }
+}
+
+backup_progress backup::progress() const {
+  if (!state_) {
+    return backup_progress();
+  }
+  std::lock_guard<std::mutex> lock(state_->mutex);
+  return state_->progress;
+}
+
+backup database::backup_to(const std::string& path, const backup_options& options) const {
+  sqlite3* destination = nullptr;
+  if (sqlite3_open_v2(path.data(), &destination, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE, nullptr) != SQLITE_OK) {
+    sqlite_exception e(sqlite3_errmsg(destination));
+    sqlite3_close_v2(destination);
+    throw e;
+  }
+  return backup(db_, destination, true, options);
+}
+
+backup database::backup_to(const database& destination, const backup_options& options) const {
+  return backup(db_, destination.db_, false, options);
+}
+
+}  // namespace sqlite
@@ -0,0 +1,86 @@
+#include "bench.h"
+#include <sqlite/config.h>
+#include <atomic>
+#include <cstring>
+#include <exception>
+
+namespace bench {
+namespace {
+
+// Counts the allocations that are passed to the installed allocator.
+sqlite3_mem_methods installed;
+std::atomic<std::uint64_t> allocations{ 0 };
+
+void* counting_malloc(int size) {
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  return installed.xMalloc(size);
+}
+
+void* counting_realloc(void* data, int size) {
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  return installed.xRealloc(data, size);
+}
+
+}  // namespace
+
+// Compares the system allocator with `sqlite::pool_allocator` on insert and scan workloads.
+void allocator() {
+  for (auto setting : { "system", "pool" }) {
+    if (!spawn("allocator", setting)) {
+      std::printf("%s failed\n", setting);
+    }
+  }
+}
+
+int allocator(const char* setting) {
+  const int rows = 200000;
+  const int scans = 20;
+
+  try {
+    sqlite::config options;
+    if (std::strcmp(setting, "pool") == 0) {
+      options.allocator = sqlite::memory_allocator::pool;
+    }
+    sqlite::initialize(options);
+
+    // The library is initialized, but allocators may still be replaced after a shutdown.
+    sqlite3_shutdown();
+    sqlite3_config(SQLITE_CONFIG_GETMALLOC, &installed);
+    auto methods = installed;
+    methods.xMalloc = counting_malloc;
+    methods.xRealloc = counting_realloc;
+    sqlite3_config(SQLITE_CONFIG_MALLOC, &methods);
+    sqlite3_initialize();
+
+    sqlite::database db(":memory:");
+    db << "create table data (id integer primary key, name text, payload blob);";
+
+    allocations = 0;
+    auto seconds = measure([&]() {
+      sqlite::transaction t(db);
+      for (int i = 0; i < rows; i++) {
+        db << "insert into data (name, payload) values (?, randomblob(?));" << std::to_string(i) << i % 500;
+      }
+      t.commit();
+    });
+    report(std::string(setting) + " insert", rows, seconds);
+    std::printf("%-40s %10llu allocations\n", "", static_cast<unsigned long long>(allocations.load()));
+
+    allocations = 0;
+    seconds = measure([&]() {
+      for (int i = 0; i < scans; i++) {
+        db << "select name, length(payload) from data order by name;" >> [](std::string, int) {
+        };
+      }
+    });
+    report(std::string(setting) + " sorted scan", scans * rows, seconds);
+    std::printf("%-40s %10llu allocations\n", "", static_cast<unsigned long long>(allocations.load()));
+  }
+  catch (const std::exception& e) {
+    std::printf("%s: %s\n", setting, e.what());
+    return 1;
+  }
+  return 0;
+}
+
+}  // namespace bench
@@ -0,0 +1,78 @@
+#include "bench.h"
+#include <sqlite/ann.h>
+#include <sqlite/vector.h>
+#include <random>
+#include <set>
+
+namespace bench {
+
+// Compares the latency and recall@10 of the IVF index for several numbers of probed lists
+// with the exact `order by vec_l2(embedding, ?) limit 10`, over clustered embeddings.
+void ann() {
+  const int rows = 100000;
+  const int dimensions = 64;
+  const int clusters = 200;
+  const int queries = 100;
+  const std::size_t k = 10;
+
+  sqlite::database db(":memory:");
+  sqlite::define_vector_functions(db);
+  sqlite::define_ann(db);
+  db << "create table data (id integer primary key, embedding blob);";
+  std::mt19937 random(42);
+  std::normal_distribution<float> component;
+  std::vector<std::vector<float>> centers(clusters, std::vector<float>(dimensions));
+  for (auto& center : centers) {
+    for (auto& x : center) {
+      x = component(random) * 4;
+    }
+  }
+  auto make = [&]() {
+    auto v = centers[random() % clusters];
+    for (auto& x : v) {
+      x += component(random);
+    }
+    return v;
+  };
+  {
+    sqlite::transaction t(db);
+    for (int i = 0; i < rows; i++) {
+      db << "insert into data (embedding) values (?);" << make();
+    }
+    t.commit();
+  }
+  report("create index", rows, measure([&]() {
+    sqlite::create_ann_index(db, "data_ann", "data", "embedding", sqlite::ann_options{ dimensions });
+  }));
+
+  std::vector<std::vector<float>> targets;
+  std::vector<std::set<sqlite3_int64>> truth(queries);
+  std::vector<double> seconds;
+  for (int i = 0; i < queries; i++) {
+    targets.push_back(make());
+    seconds.push_back(measure([&]() {
+      db << "select id from data order by vec_l2(embedding, ?) limit ?;" << targets[i] << static_cast<int>(k) >> [&](sqlite3_int64 id) {
+        truth[i].insert(id);
+      };
+    }));
+  }
+  report_percentiles("brute force", seconds);
+
+  for (int probes : { 1, 4, 16, 64 }) {
+    std::size_t found = 0;
+    seconds.clear();
+    for (int i = 0; i < queries; i++) {
+      seconds.push_back(measure([&]() {
+        db << "select rowid from data_ann where embedding match ? and k = ? and probes = ?;" << targets[i] << static_cast<int>(k) << probes >>
+            [&](sqlite3_int64 id) {
+              found += truth[i].count(id);
+            };
+      }));
+    }
+    auto label = "ivf probes=" + std::to_string(probes);
+    report_percentiles(label, seconds);
+    std::printf("%-40s recall@10 %.3f\n", label.data(), static_cast<double>(found) / (queries * k));
+  }
+}
+
+}  // namespace bench
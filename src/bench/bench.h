@@ -0,0 +1,56 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace bench {
+
+// Returns the number of seconds it took to call `function`.
+template<typename Function>
+double measure(Function&& function) {
+  auto start = std::chrono::steady_clock::now();
+  function();
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+inline void report(const std::string& name, std::size_t operations, double seconds) {
+  std::printf("%-40s %10zu ops %10.3f s %14.0f ops/s\n", name.data(), operations, seconds, operations / seconds);
+}
+
+// Prints the median, 99th and 99.9th percentile of the given durations in seconds.
+inline void report_percentiles(const std::string& name, std::vector<double> seconds) {
+  std::sort(seconds.begin(), seconds.end());
+  auto at = [&seconds](double fraction) {
+    if (seconds.empty()) {
+      return 0.0;
+    }
+    auto i = std::min(seconds.size() - 1, static_cast<std::size_t>(fraction * seconds.size()));
+    return seconds[i] * 1000;
+  };
+  std::printf("%-40s p50 %9.3f ms  p99 %9.3f ms  p999 %9.3f ms\n", name.data(), at(0.5), at(0.99), at(0.999));
+}
+
+// Runs the child function of the named benchmark with the given setting in a new process.
+// Used for process-wide settings that can only be applied once.
+bool spawn(const char* name, const char* setting);
+
+// Drops the file from the operating system page cache so that the next read of it goes to disk.
+void evict(const char* filename);
+
+void mmap();
+void immutable();
+void uring();
+void readahead();
+void latency();
+void carray();
+void collation();
+void vector();
+void ann();
+void config();
+int config(const char* setting);
+void allocator();
+int allocator(const char* setting);
+
+}  // namespace bench
@@ -0,0 +1,71 @@
+#include "bench.h"
+#include <sqlite/carray.h>
+#include <cstdio>
+#include <random>
+
+namespace bench {
+
+// Compares multi-key lookups with an IN list of one parameter per key, whose SQL text differs
+// for every list length, and with `carray`, which binds the whole list to one parameter.
+void carray() {
+  const int rows = 100000;
+  const int queries = 2000;
+  const int max_keys = 1000;
+  const char* filename = "bench_carray.db";
+
+  std::remove(filename);
+  {
+    sqlite::database db(filename);
+    db << "create table data (id integer primary key, value integer);";
+    db << "insert into data (id, value) "
+          "with recursive ids(i) as (select 1 union all select i + 1 from ids where i < ?) "
+          "select i, i * 2 from ids;" << rows;
+  }
+
+  for (auto mode : { sqlite::open_mode::read_write, sqlite::open_mode::immutable }) {
+    sqlite::database db(filename, mode);
+    sqlite::define_carray(db);
+    auto label = std::string(mode == sqlite::open_mode::immutable ? "immutable" : "read-write");
+
+    std::mt19937 random(42);
+    std::uniform_int_distribution<int> ids(1, rows);
+    std::uniform_int_distribution<int> lengths(1, max_keys);
+    std::vector<std::vector<sqlite3_int64>> lists(queries);
+    std::size_t keys = 0;
+    for (auto& list : lists) {
+      list.resize(static_cast<std::size_t>(lengths(random)));
+      for (auto& id : list) {
+        id = ids(random);
+      }
+      keys += list.size();
+    }
+
+    sqlite3_int64 sum = 0;
+    report(label + " in list", keys, measure([&]() {
+      for (auto& list : lists) {
+        std::string sql = "select sum(value) from data where id in (?";
+        for (std::size_t i = 1; i < list.size(); i++) {
+          sql += ",?";
+        }
+        sql += ");";
+        auto binder = db << sql;
+        for (auto id : list) {
+          std::move(binder) << id;
+        }
+        sqlite3_int64 value = 0;
+        binder >> value;
+        sum += value;
+      }
+    }));
+    report(label + " carray", keys, measure([&]() {
+      for (auto& list : lists) {
+        sqlite3_int64 value = 0;
+        db << "select sum(value) from data where id in carray(?);" << sqlite::carray(list) >> value;
+        sum += value;
+      }
+    }));
+  }
+  std::remove(filename);
+}
+
+}  // namespace bench
@@ -0,0 +1,59 @@
+#include "bench.h"
+#include <sqlite/collation.h>
+#include <cctype>
+#include <random>
+
+namespace bench {
+
+namespace {
+
+// A comparator in the style of a hand-written collation callback.
+int compare_tolower(const char* a, std::size_t a_size, const char* b, std::size_t b_size) {
+  for (std::size_t i = 0; i < a_size && i < b_size; i++) {
+    auto x = std::tolower(static_cast<unsigned char>(a[i]));
+    auto y = std::tolower(static_cast<unsigned char>(b[i]));
+    if (x != y) {
+      return x - y;
+    }
+  }
+  return a_size < b_size ? -1 : (a_size > b_size ? 1 : 0);
+}
+
+}  // namespace
+
+// Compares ORDER BY and index builds over file paths, which share long prefixes, with the
+// built-in NOCASE, a byte-by-byte callback and the vectorized collations.
+void collation() {
+  const int rows = 1000000;
+
+  sqlite::database db(":memory:");
+  sqlite::define_collations(db);
+  db.define_collation("tolower", compare_tolower);
+  db << "create table data (path text);";
+  {
+    std::mt19937 random(42);
+    const char* directories[] = { "Documents/Projects/Reports", "Documents/Projects/Archive", "Pictures/Holidays/Summer" };
+    sqlite::transaction t(db);
+    for (int i = 0; i < rows; i++) {
+      auto path = std::string("/home/Shared/") + directories[random() % 3] + "/Quarterly/File " + std::to_string(random() % 100000) + ".txt";
+      db << "insert into data (path) values (?);" << path;
+    }
+    t.commit();
+  }
+
+  for (auto name : { "nocase", "tolower", "ascii_nocase", "natural_nocase" }) {
+    auto collate = std::string(" collate ") + name;
+    std::size_t bytes = 0;
+    report(std::string(name) + " order by", rows, measure([&]() {
+      db << "select path from data order by path" + collate + ";" >> [&](std::string path) {
+        bytes += path.size();
+      };
+    }));
+    report(std::string(name) + " create index", rows, measure([&]() {
+      db << "create index data_path on data (path" + collate + ");";
+    }));
+    db << "drop index data_path;";
+  }
+}
+
+}  // namespace bench
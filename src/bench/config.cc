@@ -0,0 +1,78 @@
+#include "bench.h"
+#include <sqlite/config.h>
+#include <cstring>
+#include <exception>
+#include <thread>
+#include <vector>
+
+namespace bench {
+
+// Measures the process-wide settings of `sqlite::initialize` with a workload that prepares
+// many small statements on several threads, which is dominated by allocations.
+void config() {
+  for (auto setting : { "default", "memstatus-off", "multi-thread", "lookaside", "page-cache", "pool-allocator", "all" }) {
+    if (!spawn("config", setting)) {
+      std::printf("%s failed\n", setting);
+    }
+  }
+}
+
+int config(const char* setting) {
+  const int threads = 4;
+  const int rows = 20000;
+
+  sqlite::config options;
+  auto all = std::strcmp(setting, "all") == 0;
+  if (all || std::strcmp(setting, "memstatus-off") == 0) {
+    options.memstatus = 0;
+  }
+  if (all || std::strcmp(setting, "multi-thread") == 0) {
+    options.threading = sqlite::threading_mode::multi_thread;
+  }
+  if (all || std::strcmp(setting, "lookaside") == 0) {
+    options.lookaside_size = 512;
+    options.lookaside_count = 512;
+  }
+  if (all || std::strcmp(setting, "pool-allocator") == 0) {
+    options.allocator = sqlite::memory_allocator::pool;
+  }
+  if (all || std::strcmp(setting, "page-cache") == 0) {
+    options.page_cache_size = 4096 + 512;
+    options.page_cache_count = 4096;
+  }
+
+  try {
+    sqlite::initialize(options);
+    std::vector<std::thread> workers;
+    auto seconds = measure([&]() {
+      for (int i = 0; i < threads; i++) {
+        workers.emplace_back([rows]() {
+          sqlite::database db(":memory:");
+          db << "create table data (id integer primary key, value real, name text);";
+          {
+            sqlite::transaction t(db);
+            for (int i = 0; i < rows; i++) {
+              db << "insert into data (value, name) values (?, ?);" << i * 0.5 << std::to_string(i);
+            }
+            t.commit();
+          }
+          for (int i = 0; i < rows; i++) {
+            double value = 0;
+            db << "select value from data where id = ?;" << i + 1 >> value;
+          }
+        });
+      }
+      for (auto& worker : workers) {
+        worker.join();
+      }
+    });
+    report(std::string("config ") + setting, threads * rows * 2, seconds);
+  }
+  catch (const std::exception& e) {
+    std::printf("%s: %s\n", setting, e.what());
+    return 1;
+  }
+  return 0;
+}
+
+}  // namespace bench
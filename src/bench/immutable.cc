@@ -0,0 +1,45 @@
+#include "bench.h"
+#include <sqlite/sqlite.h>
+#include <cstdio>
+#include <random>
+
+namespace bench {
+
+// Compares point lookups through the wrapper on a regular and an immutable connection. The
+// regular connection prepares every statement and takes a shared lock per query.
+void immutable() {
+  const int rows = 100000;
+  const int lookups = 200000;
+  const char* filename = "bench_immutable.db";
+
+  std::remove(filename);
+  {
+    sqlite::database db(filename);
+    db << "create table data (id integer primary key, value integer);";
+    db << "insert into data (id, value) "
+          "with recursive ids(i) as (select 1 union all select i + 1 from ids where i < ?) "
+          "select i, i * 2 from ids;" << rows;
+  }
+
+  for (auto mode : { sqlite::open_mode::read_write, sqlite::open_mode::immutable }) {
+    sqlite::database db(filename, mode);
+    auto label = std::string(mode == sqlite::open_mode::immutable ? "immutable" : "read-write");
+    if (mode == sqlite::open_mode::immutable) {
+      db.prepare("select value from data where id = ?;");
+    }
+
+    std::mt19937 random(42);
+    std::uniform_int_distribution<int> ids(1, rows);
+    sqlite3_int64 sum = 0;
+    report(label + " point lookup", lookups, measure([&]() {
+      for (int i = 0; i < lookups; i++) {
+        int value = 0;
+        db << "select value from data where id = ?;" << ids(random) >> value;
+        sum += value;
+      }
+    }));
+  }
+  std::remove(filename);
+}
+
+}  // namespace bench
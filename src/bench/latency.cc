@@ -0,0 +1,78 @@
+#include "bench.h"
+#include "../test/fault_vfs.h"
+#include <cstdio>
+
+namespace bench {
+
+// Measures the commit latency distribution on the fault VFS without faults, with slow writes,
+// with occasional sync stalls and with failing WAL writes.
+void latency() {
+  using sqlite::test::fault_rule;
+  const int commits = 1000;
+  const int rows = 10;
+  const std::uint64_t seed = 42;
+  const char* filename = "bench_latency.db";
+
+  fault_rule slow_writes;
+  slow_writes.operations = sqlite::test::fault_write;
+  slow_writes.delay = std::chrono::microseconds(50);
+  slow_writes.jitter = std::chrono::microseconds(200);
+
+  fault_rule sync_stalls;
+  sync_stalls.operations = sqlite::test::fault_sync;
+  sync_stalls.probability = 0.02;
+  sync_stalls.delay = std::chrono::milliseconds(20);
+
+  fault_rule wal_errors;
+  wal_errors.files = SQLITE_OPEN_WAL;
+  wal_errors.operations = sqlite::test::fault_write;
+  wal_errors.probability = 0.002;
+  wal_errors.error = SQLITE_IOERR_WRITE;
+
+  struct condition {
+    const char* name;
+    std::vector<fault_rule> rules;
+  };
+  const condition conditions[] = {
+    { "no faults", {} },
+    { "slow writes", { slow_writes } },
+    { "sync stalls", { sync_stalls } },
+    { "wal write errors", { wal_errors } },
+  };
+
+  sqlite::test::fault_vfs();
+  for (auto& c : conditions) {
+    std::remove(filename);
+    std::remove((std::string(filename) + "-wal").data());
+    sqlite::database db(filename, sqlite::open_mode::read_write, "fault");
+    db << "pragma journal_mode=wal;";
+    db << "pragma synchronous=full;";
+    db << "create table data (id integer primary key, payload blob);";
+
+    sqlite::test::set_faults(c.rules, seed);
+    std::vector<double> samples;
+    int failed = 0;
+    for (int i = 0; i < commits; i++) {
+      samples.push_back(measure([&]() {
+        try {
+          sqlite::transaction t(db);
+          for (int j = 0; j < rows; j++) {
+            db << "insert into data (payload) values (randomblob(200));";
+          }
+          t.commit();
+        } catch (const sqlite::sqlite_exception&) {
+          ++failed;
+        }
+      }));
+    }
+    sqlite::test::set_faults({});
+    report_percentiles(std::string(c.name) + " commit", samples);
+    if (failed) {
+      std::printf("%-40s %10d failed commits\n", c.name, failed);
+    }
+  }
+  std::remove(filename);
+  std::remove((std::string(filename) + "-wal").data());
+}
+
+}  // namespace bench
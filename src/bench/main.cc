@@ -0,0 +1,79 @@
+#include "bench.h"
+#include <cstdlib>
+#include <cstring>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+struct benchmark {
+  const char* name;
+  void (*run)();
+
+  // Runs a single setting of benchmarks that need a fresh process for each setting.
+  int (*child)(const char* setting);
+};
+
+const benchmark benchmarks[] = {
+  { "mmap", bench::mmap, nullptr },
+  { "immutable", bench::immutable, nullptr },
+  { "uring", bench::uring, nullptr },
+  { "readahead", bench::readahead, nullptr },
+  { "latency", bench::latency, nullptr },
+  { "carray", bench::carray, nullptr },
+  { "collation", bench::collation, nullptr },
+  { "vector", bench::vector, nullptr },
+  { "ann", bench::ann, nullptr },
+  { "config", bench::config, bench::config },
+  { "allocator", bench::allocator, bench::allocator },
+};
+
+const char* program = "";
+
+}  // namespace
+
+bool bench::spawn(const char* name, const char* setting) {
+  std::fflush(stdout);
+  auto command = std::string(program) + " --child " + name + " " + setting;
+  return std::system(command.data()) == 0;
+}
+
+void bench::evict(const char* filename) {
+#ifdef __linux__
+  auto fd = open(filename, O_RDONLY);
+  if (fd >= 0) {
+    fdatasync(fd);
+    posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+    close(fd);
+  }
+#endif
+}
+
+// Runs the benchmarks given on the command line or all of them.
+int main(int argc, char* argv[]) {
+  program = argv[0];
+
+  if (argc == 4 && std::strcmp(argv[1], "--child") == 0) {
+    for (const auto& b : benchmarks) {
+      if (b.child && std::strcmp(argv[2], b.name) == 0) {
+        return b.child(argv[3]);
+      }
+    }
+    return 1;
+  }
+
+  for (const auto& b : benchmarks) {
+    bool selected = argc < 2;
+    for (int i = 1; i < argc; i++) {
+      selected = selected || std::strcmp(argv[i], b.name) == 0;
+    }
+    if (selected) {
+      std::printf("%s\n", b.name);
+      std::fflush(stdout);
+      b.run();
+    }
+  }
+}
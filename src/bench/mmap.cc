@@ -0,0 +1,56 @@
+#include "bench.h"
+#include <sqlite/sqlite.h>
+#include <cstdio>
+#include <random>
+
+namespace bench {
+
+// Compares point lookups and full scans with and without memory-mapped I/O on the same file.
+void mmap() {
+  const int rows = 200000;
+  const int lookups = 200000;
+  const char* filename = "bench_mmap.db";
+
+  std::remove(filename);
+  {
+    sqlite::database db(filename);
+    db << "create table data (id integer primary key, payload blob);";
+    db << "insert into data (id, payload) "
+          "with recursive ids(i) as (select 1 union all select i + 1 from ids where i < ?) "
+          "select i, randomblob(200) from ids;" << rows;
+  }
+
+  for (sqlite3_int64 size : { sqlite3_int64(0), sqlite3_int64(1) << 30 }) {
+    sqlite::database db(filename);
+    db.mmap_size(size);
+    auto label = std::string(size ? "mmap" : "read");
+
+    db.mmap_advise(sqlite::mmap_advice::random);
+    sqlite3_stmt* stmt = nullptr;
+    sqlite3_prepare_v2(db.handle(), "select length(payload) from data where id = ?;", -1, &stmt, nullptr);
+    std::mt19937 random(42);
+    std::uniform_int_distribution<int> ids(1, rows);
+    sqlite3_int64 bytes = 0;
+    report(label + " point lookup", lookups, measure([&]() {
+      for (int i = 0; i < lookups; i++) {
+        sqlite3_bind_int(stmt, 1, ids(random));
+        if (sqlite3_step(stmt) == SQLITE_ROW) {
+          bytes += sqlite3_column_int(stmt, 0);
+        }
+        sqlite3_reset(stmt);
+      }
+    }));
+    sqlite3_finalize(stmt);
+
+    db.mmap_advise(sqlite::mmap_advice::sequential);
+    const int scans = 20;
+    report(label + " full scan", scans * rows, measure([&]() {
+      for (int i = 0; i < scans; i++) {
+        db << "select sum(length(payload)) from data;" >> bytes;
+      }
+    }));
+  }
+  std::remove(filename);
+}
+
+}  // namespace bench
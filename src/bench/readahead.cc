@@ -0,0 +1,56 @@
+#include "bench.h"
+#include <sqlite/readahead.h>
+#include <cstdio>
+
+namespace bench {
+
+// Compares cold full scans on the default VFS and on the readahead VFS, once over a table that
+// was filled in key order and once over an index that was filled in random order, whose leaf
+// pages are scattered over the file.
+void readahead() {
+  const int rows = 200000;
+  const int scans = 5;
+  const char* filename = "bench_readahead.db";
+
+  sqlite::readahead_vfs();
+
+  std::remove(filename);
+  {
+    sqlite::database db(filename);
+    db << "create table data (id integer primary key, key text, payload blob);";
+    db << "insert into data (id, key, payload) "
+          "with recursive ids(i) as (select 1 union all select i + 1 from ids where i < ?) "
+          "select i, hex(randomblob(8)), randomblob(200) from ids;" << rows;
+    db << "create table keys (key text primary key, id integer) without rowid;";
+    db << "insert into keys select key, id from data order by random();";
+  }
+
+  for (auto vfs : { "unix", "readahead" }) {
+    sqlite::database db(filename, sqlite::open_mode::read_write, vfs);
+    db << "pragma cache_size=-2000;";
+    auto label = std::string(vfs);
+
+    sqlite3_int64 bytes = 0;
+    report(label + " cold ordered scan", scans * rows, measure([&]() {
+      for (int i = 0; i < scans; i++) {
+        evict(filename);
+        db << "select sum(length(payload)) from data;" >> bytes;
+      }
+    }));
+
+    sqlite3_int64 count = 0;
+    report(label + " cold fragmented scan", scans * rows, measure([&]() {
+      for (int i = 0; i < scans; i++) {
+        evict(filename);
+        db << "select count(id) from keys;" >> count;
+      }
+    }));
+  }
+
+  auto s = sqlite::readahead_vfs_statistics();
+  std::printf("readahead: %llu hits, %llu misses, %llu reads of %llu bytes\n", static_cast<unsigned long long>(s.hits), static_cast<unsigned long long>(s.misses),
+              static_cast<unsigned long long>(s.readaheads), static_cast<unsigned long long>(s.bytes_read_ahead));
+  std::remove(filename);
+}
+
+}  // namespace bench
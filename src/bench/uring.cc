@@ -0,0 +1,59 @@
+#include "bench.h"
+#include <sqlite/uring.h>
+#include <cstdio>
+#include <random>
+
+namespace bench {
+
+// Compares cold full scans and commits of many scattered pages on the default VFS and on the
+// io_uring VFS.
+void uring() {
+  const int rows = 200000;
+  const int scans = 5;
+  const int commits = 20;
+  const int updates = 2000;
+  const char* filename = "bench_uring.db";
+
+  sqlite::uring_vfs();
+  if (!sqlite::uring_available()) {
+    std::printf("io_uring is not available, the uring VFS falls back to the default VFS\n");
+  }
+
+  std::remove(filename);
+  {
+    sqlite::database db(filename);
+    db << "create table data (id integer primary key, payload blob);";
+    db << "insert into data (id, payload) "
+          "with recursive ids(i) as (select 1 union all select i + 1 from ids where i < ?) "
+          "select i, randomblob(200) from ids;" << rows;
+  }
+
+  for (auto vfs : { "unix", "uring" }) {
+    sqlite::database db(filename, sqlite::open_mode::read_write, vfs);
+    db << "pragma cache_size=-2000;";
+    auto label = std::string(vfs);
+
+    sqlite3_int64 bytes = 0;
+    report(label + " cold full scan", scans * rows, measure([&]() {
+      for (int i = 0; i < scans; i++) {
+        evict(filename);
+        db << "select sum(length(payload)) from data;" >> bytes;
+      }
+    }));
+
+    std::mt19937 random(42);
+    std::uniform_int_distribution<int> ids(1, rows);
+    report(label + " scattered commit", commits * updates, measure([&]() {
+      for (int i = 0; i < commits; i++) {
+        sqlite::transaction t(db);
+        for (int j = 0; j < updates; j++) {
+          db << "update data set payload = randomblob(200) where id = ?;" << ids(random);
+        }
+        t.commit();
+      }
+    }));
+  }
+  std::remove(filename);
+}
+
+}  // namespace bench
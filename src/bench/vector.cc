@@ -0,0 +1,59 @@
+#include "bench.h"
+#include <sqlite/vector.h>
+#include <random>
+#include <utility>
+
+namespace bench {
+
+// Compares nearest-neighbour queries that pull every embedding into C++ with
+// `order by vec_l2(embedding, ?) limit 10`, which computes the distances inside SQLite.
+void vector() {
+  const int rows = 100000;
+  const int dimensions = 128;
+  const int queries = 50;
+
+  sqlite::database db(":memory:");
+  sqlite::define_vector_functions(db);
+  db << "create table data (id integer primary key, embedding blob);";
+  std::mt19937 random(42);
+  std::normal_distribution<float> component;
+  auto make = [&]() {
+    std::vector<float> v(dimensions);
+    for (auto& x : v) {
+      x = component(random);
+    }
+    return v;
+  };
+  {
+    sqlite::transaction t(db);
+    for (int i = 0; i < rows; i++) {
+      db << "insert into data (embedding) values (?);" << make();
+    }
+    t.commit();
+  }
+  std::vector<std::vector<float>> targets;
+  for (int i = 0; i < queries; i++) {
+    targets.push_back(make());
+  }
+
+  sqlite3_int64 checksum = 0;
+  report("rows into C++", queries, measure([&]() {
+    for (auto& target : targets) {
+      std::vector<std::pair<float, sqlite3_int64>> distances;
+      db << "select id, embedding from data;" >> [&](sqlite3_int64 id, std::vector<float> embedding) {
+        distances.emplace_back(sqlite::vector_l2(embedding.data(), target.data(), embedding.size()), id);
+      };
+      std::partial_sort(distances.begin(), distances.begin() + 10, distances.end());
+      checksum += distances.front().second;
+    }
+  }));
+  report("order by vec_l2 limit 10", queries, measure([&]() {
+    for (auto& target : targets) {
+      db << "select id from data order by vec_l2(embedding, ?) limit 10;" << target >> [&](sqlite3_int64 id) {
+        checksum += id;
+      };
+    }
+  }));
+}
+
+}  // namespace bench
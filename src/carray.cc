@@ -0,0 +1,309 @@
+#include <sqlite/carray.h>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <unordered_map>
+
+namespace sqlite {
+namespace {
+
+struct array_entry {
+  array_type type;
+  const void* data;
+  std::size_t size;
+};
+
+// Arrays bound to statements of one connection. Only statements of that connection can read
+// them, and the registry is only used with the connection's mutex held, so that an array is
+// never read while the statement that bound it is finished on another thread. Connections in
+// the multi-thread mode have no mutex, but are not used by two threads at the same time.
+struct array_registry {
+  sqlite3* db;
+  std::unordered_map<sqlite3_int64, array_entry> arrays;
+  // Handles are random, so that SQL text can not guess the handle of another statement.
+  std::mt19937_64 random;
+  // Counts unregistrations, so that cursors know when to look up their array again.
+  std::uint64_t generation = 0;
+};
+
+// The registry of every connection that carray is defined on.
+std::mutex registries_mutex;
+std::unordered_map<sqlite3*, array_registry*> registries;
+
+array_registry* find_registry(sqlite3* db) {
+  std::lock_guard<std::mutex> lock(registries_mutex);
+  auto found = registries.find(db);
+  return found == registries.end() ? nullptr : found->second;
+}
+
+void destroy_registry(void* data) {
+  auto r = static_cast<array_registry*>(data);
+  {
+    std::lock_guard<std::mutex> lock(registries_mutex);
+    auto found = registries.find(r->db);
+    if (found != registries.end() && found->second == r) {
+      registries.erase(found);
+    }
+  }
+  delete r;
+}
+
+class connection_lock {
+private:
+  sqlite3_mutex* mutex_;
+
+public:
+  explicit connection_lock(sqlite3* db) : mutex_(sqlite3_db_mutex(db)) {
+    sqlite3_mutex_enter(mutex_);
+  }
+
+  connection_lock(const connection_lock& other) = delete;
+  connection_lock& operator=(const connection_lock& other) = delete;
+
+  ~connection_lock() {
+    sqlite3_mutex_leave(mutex_);
+  }
+};
+
+struct table {
+  sqlite3_vtab base;
+  array_registry* registry;
+};
+
+enum {
+  value_column,
+  handle_column,
+};
+
+struct cursor {
+  sqlite3_vtab_cursor base;
+  sqlite3_int64 handle;
+  array_entry array;
+  std::uint64_t generation;
+  std::size_t position;
+};
+
+int connect(sqlite3* db, void* registry, int, const char* const*, sqlite3_vtab** vtab, char**) {
+  auto hresult = sqlite3_declare_vtab(db, "create table x(value, handle hidden);");
+  if (hresult != SQLITE_OK) {
+    return hresult;
+  }
+  auto t = static_cast<table*>(sqlite3_malloc(sizeof(table)));
+  if (!t) {
+    return SQLITE_NOMEM;
+  }
+  std::memset(t, 0, sizeof(table));
+  t->registry = static_cast<array_registry*>(registry);
+  *vtab = &t->base;
+  return SQLITE_OK;
+}
+
+int disconnect(sqlite3_vtab* vtab) {
+  sqlite3_free(vtab);
+  return SQLITE_OK;
+}
+
+// The table is only usable with its handle, which the table-valued function syntax passes as
+// an equality constraint on the hidden column. Without it, SQLite looks for another plan and
+// fails the statement when there is none.
+int best_index(sqlite3_vtab*, sqlite3_index_info* info) {
+  for (int i = 0; i < info->nConstraint; i++) {
+    auto& c = info->aConstraint[i];
+    if (c.usable && c.iColumn == handle_column && c.op == SQLITE_INDEX_CONSTRAINT_EQ) {
+      info->aConstraintUsage[i].argvIndex = 1;
+      info->aConstraintUsage[i].omit = 1;
+      info->idxNum = 1;
+      info->estimatedCost = 1;
+      if (sqlite3_libversion_number() >= 3008002) {
+        info->estimatedRows = 100;
+      }
+      return SQLITE_OK;
+    }
+  }
+  return SQLITE_CONSTRAINT;
+}
+
+int open(sqlite3_vtab*, sqlite3_vtab_cursor** out) {
+  auto c = static_cast<cursor*>(sqlite3_malloc(sizeof(cursor)));
+  if (!c) {
+    return SQLITE_NOMEM;
+  }
+  std::memset(c, 0, sizeof(cursor));
+  *out = &c->base;
+  return SQLITE_OK;
+}
+
+int close(sqlite3_vtab_cursor* c) {
+  sqlite3_free(c);
+  return SQLITE_OK;
+}
+
+// Looks up the array again if an array was unregistered since the last lookup. The array of
+// a cursor whose statement was finished in the meantime reads as empty.
+void refresh(cursor& c) {
+  auto& r = *reinterpret_cast<table*>(c.base.pVtab)->registry;
+  if (c.generation == r.generation) {
+    return;
+  }
+  auto found = r.arrays.find(c.handle);
+  if (found == r.arrays.end()) {
+    c.array = array_entry{ array_type::int64, nullptr, 0 };
+  } else {
+    c.array = found->second;
+  }
+  c.generation = r.generation;
+}
+
+int filter(sqlite3_vtab_cursor* base, int, const char*, int, sqlite3_value** arguments) {
+  auto c = reinterpret_cast<cursor*>(base);
+  auto& r = *reinterpret_cast<table*>(base->pVtab)->registry;
+  c->position = 0;
+  c->array = array_entry{ array_type::int64, nullptr, 0 };
+  c->generation = r.generation;
+  if (sqlite3_value_type(arguments[0]) == SQLITE_NULL) {
+    return SQLITE_OK;
+  }
+  c->handle = sqlite3_value_int64(arguments[0]);
+  auto found = r.arrays.find(c->handle);
+  if (found == r.arrays.end()) {
+    sqlite3_free(base->pVtab->zErrMsg);
+    base->pVtab->zErrMsg = sqlite3_mprintf("carray: no array is bound to handle %lld", c->handle);
+    return SQLITE_ERROR;
+  }
+  c->array = found->second;
+  return SQLITE_OK;
+}
+
+int next(sqlite3_vtab_cursor* c) {
+  reinterpret_cast<cursor*>(c)->position++;
+  return SQLITE_OK;
+}
+
+int eof(sqlite3_vtab_cursor* base) {
+  auto c = reinterpret_cast<cursor*>(base);
+  refresh(*c);
+  return c->position >= c->array.size;
+}
+
+int column(sqlite3_vtab_cursor* base, sqlite3_context* context, int index) {
+  auto c = reinterpret_cast<cursor*>(base);
+  if (index == handle_column) {
+    sqlite3_result_int64(context, c->handle);
+    return SQLITE_OK;
+  }
+  refresh(*c);
+  auto i = c->position;
+  if (i >= c->array.size) {
+    sqlite3_result_null(context);
+    return SQLITE_OK;
+  }
+  switch (c->array.type) {
+  case array_type::int32:
+    sqlite3_result_int(context, static_cast<const int*>(c->array.data)[i]);
+    break;
+  case array_type::int64:
+    sqlite3_result_int64(context, static_cast<const sqlite3_int64*>(c->array.data)[i]);
+    break;
+  case array_type::real:
+    sqlite3_result_double(context, static_cast<const double*>(c->array.data)[i]);
+    break;
+  case array_type::text: {
+    auto text = static_cast<const char* const*>(c->array.data)[i];
+    if (text) {
+      sqlite3_result_text(context, text, -1, SQLITE_STATIC);
+    } else {
+      sqlite3_result_null(context);
+    }
+    break;
+  }
+  case array_type::string: {
+    auto& text = static_cast<const std::string*>(c->array.data)[i];
+    sqlite3_result_text(context, text.data(), static_cast<int>(text.size()), SQLITE_STATIC);
+    break;
+  }
+  }
+  return SQLITE_OK;
+}
+
+int rowid(sqlite3_vtab_cursor* c, sqlite3_int64* id) {
+  *id = static_cast<sqlite3_int64>(reinterpret_cast<cursor*>(c)->position) + 1;
+  return SQLITE_OK;
+}
+
+// Eponymous, since `create` and `connect` are the same function.
+const sqlite3_module carray_module = {
+  1,
+  connect,
+  connect,
+  best_index,
+  disconnect,
+  disconnect,
+  open,
+  close,
+  filter,
+  next,
+  eof,
+  column,
+  rowid,
+  nullptr,
+  nullptr,
+  nullptr,
+  nullptr,
+  nullptr,
+  nullptr,
+  nullptr,
+  nullptr,
+  nullptr,
+  nullptr,
+};
+
+}  // namespace
+
+sqlite3_int64 register_array(sqlite3* db, array_type type, const void* data, std::size_t size) {
+  auto r = find_registry(db);
+  if (!r) {
+    throw sqlite_exception("carray is not defined on this connection");
+  }
+  connection_lock lock(db);
+  sqlite3_int64 handle;
+  do {
+    handle = static_cast<sqlite3_int64>(r->random() & 0x7fffffffffffffffull);
+  } while (!handle || r->arrays.count(handle));
+  r->arrays.emplace(handle, array_entry{ type, data, size });
+  return handle;
+}
+
+void unregister_array(sqlite3* db, sqlite3_int64 handle) {
+  auto r = find_registry(db);
+  if (!r) {
+    return;
+  }
+  connection_lock lock(db);
+  r->arrays.erase(handle);
+  r->generation++;
+}
+
+void define_carray(const database& db) {
+  std::unique_ptr<array_registry> r(new array_registry());
+  r->db = db.handle();
+  std::random_device random;
+  r->random.seed((static_cast<std::uint64_t>(random()) << 32) ^ random());
+  {
+    // Defining it again keeps the module and the arrays that are bound, since registering
+    // the module again would replace or fail depending on the SQLite version.
+    std::lock_guard<std::mutex> lock(registries_mutex);
+    if (registries.count(r->db)) {
+      return;
+    }
+    registries[r->db] = r.get();
+  }
+  // The registry is destroyed by SQLite with the module, also when the registration fails.
+  auto hresult = sqlite3_create_module_v2(db.handle(), "carray", &carray_module, r.release(), destroy_registry);
+  if (hresult != SQLITE_OK) {
+    throw sqlite_exception(sqlite3_errstr(hresult));
+  }
+}
+
+}  // namespace sqlite
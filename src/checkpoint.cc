@@ -0,0 +1,153 @@
+#include <sqlite/checkpoint.h>
+#include <algorithm>
+#include <cstring>
+#include <string>
+
+namespace sqlite {
+namespace {
+
+// SQLITE_FCNTL_VFS_POINTER, answered by SQLite itself since 3.15, which is newer than the
+// bundled header.
+const int fcntl_vfs_pointer = 27;
+
+// SQLITE_CHECKPOINT_TRUNCATE, which SQLite supports since 3.8.8 and the bundled header does
+// not define.
+const int checkpoint_truncate = 3;
+
+// Name of the VFS that `db` opened its main database with.
+std::string vfs_name(sqlite3* db) {
+  sqlite3_vfs* vfs = nullptr;
+  if (sqlite3_file_control(db, "main", fcntl_vfs_pointer, &vfs) == SQLITE_OK && vfs) {
+    return vfs->zName;
+  }
+  // Older versions only have the names of the VFS stack, outermost first and separated by
+  // slashes, and only when the VFS reports them.
+  char* names = nullptr;
+  std::string name;
+  if (sqlite3_file_control(db, "main", SQLITE_FCNTL_VFSNAME, &names) == SQLITE_OK && names) {
+    name = names;
+    name = name.substr(0, name.find('/'));
+  }
+  sqlite3_free(names);
+  return name;
+}
+
+}  // namespace
+
+checkpointer::checkpointer(const database& db, checkpoint_options options) : db_(db.handle()), options_(options) {
+  auto filename = sqlite3_db_filename(db_, "main");
+  if (!filename || !*filename) {
+    throw sqlite_exception("checkpoints require a database file");
+  }
+  auto vfs = vfs_name(db_);
+  if (sqlite3_open_v2(filename, &connection_, SQLITE_OPEN_READWRITE, vfs.empty() ? nullptr : vfs.data()) != SQLITE_OK) {
+    sqlite_exception e(sqlite3_errmsg(connection_));
+    sqlite3_close_v2(connection_);
+    throw e;
+  }
+  sqlite3_busy_timeout(connection_, static_cast<int>(options_.busy_timeout.count()));
+
+  // Checkpoints are no-ops until the connection has read the schema and found the WAL.
+  if (sqlite3_exec(connection_, "select count(*) from sqlite_master;", nullptr, nullptr, nullptr) != SQLITE_OK) {
+    sqlite_exception e(sqlite3_errmsg(connection_));
+    sqlite3_close_v2(connection_);
+    throw e;
+  }
+  thread_ = std::thread(&checkpointer::run, this);
+  sqlite3_wal_hook(db_, &checkpointer::hook, this);
+}
+
+checkpointer::~checkpointer() {
+  sqlite3_wal_hook(db_, nullptr, nullptr);
+  sqlite3_wal_autocheckpoint(db_, options_.autocheckpoint);
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  condition_.notify_one();
+  thread_.join();
+  sqlite3_close_v2(connection_);
+}
+
+int checkpointer::hook(void* data, sqlite3*, const char* name, int pages) {
+  auto& self = *static_cast<checkpointer*>(data);
+  if (std::strcmp(name, "main") != 0) {
+    return SQLITE_OK;
+  }
+  bool notify = false;
+  {
+    std::lock_guard<std::mutex> lock(self.mutex_);
+    self.metrics_.wal_pages = pages;
+    if (pages >= self.options_.passive_pages && !self.requested_) {
+      self.requested_ = true;
+      notify = true;
+    }
+  }
+  if (notify) {
+    self.condition_.notify_one();
+  }
+  return SQLITE_OK;
+}
+
+void checkpointer::run() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    condition_.wait(lock, [this]() {
+      return requested_ || stopping_;
+    });
+    if (stopping_) {
+      break;
+    }
+    requested_ = false;
+    auto pages = metrics_.wal_pages;
+    lock.unlock();
+    checkpoint(pages);
+    lock.lock();
+  }
+}
+
+void checkpointer::checkpoint(int pages) {
+  int mode = SQLITE_CHECKPOINT_PASSIVE;
+  if (pages >= options_.truncate_pages) {
+    // The version is that of the library at runtime, which can be newer than the header.
+    mode = sqlite3_libversion_number() >= 3008008 ? checkpoint_truncate : SQLITE_CHECKPOINT_RESTART;
+  } else if (pages >= options_.restart_pages) {
+    mode = SQLITE_CHECKPOINT_RESTART;
+  }
+
+  int log = 0;
+  int checkpointed = 0;
+  auto start = std::chrono::steady_clock::now();
+  auto hresult = sqlite3_wal_checkpoint_v2(connection_, "main", mode, &log, &checkpointed);
+  auto duration = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  metrics_.checkpointed_pages = std::max(checkpointed, 0);
+  metrics_.checkpoints++;
+  if (mode == SQLITE_CHECKPOINT_RESTART) {
+    metrics_.restarts++;
+  } else if (mode != SQLITE_CHECKPOINT_PASSIVE) {
+    metrics_.truncates++;
+  }
+  if (hresult == SQLITE_BUSY || (hresult == SQLITE_OK && checkpointed < log)) {
+    metrics_.busy++;
+  }
+  metrics_.last_duration = duration;
+  metrics_.max_duration = std::max(metrics_.max_duration, duration);
+  metrics_.total_duration += duration;
+}
+
+void checkpointer::request() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    requested_ = true;
+  }
+  condition_.notify_one();
+}
+
+checkpoint_metrics checkpointer::metrics() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return metrics_;
+}
+
+}  // namespace sqlite
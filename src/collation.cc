@@ -0,0 +1,170 @@
+#include <sqlite/collation.h>
+#include <algorithm>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define SQLITE_COLLATION_X86 1
+#include <immintrin.h>
+#endif
+
+namespace sqlite {
+namespace {
+
+inline unsigned char fold(unsigned char c) {
+  return c >= 'A' && c <= 'Z' ? c | 0x20 : c;
+}
+
+inline bool digit(char c) {
+  return c >= '0' && c <= '9';
+}
+
+inline int sign(std::ptrdiff_t value) {
+  return value < 0 ? -1 : (value > 0 ? 1 : 0);
+}
+
+// Returns the index of the first of `size` bytes at which the strings differ after folding,
+// or `size`.
+std::size_t mismatch_scalar(const char* a, const char* b, std::size_t size, std::size_t i = 0) {
+  for (; i < size; i++) {
+    if (a[i] != b[i] && fold(static_cast<unsigned char>(a[i])) != fold(static_cast<unsigned char>(b[i]))) {
+      break;
+    }
+  }
+  return i;
+}
+
+#ifdef SQLITE_COLLATION_X86
+
+// 'A'..'Z' are moved to the bottom of the signed range, so that one signed comparison finds
+// them, and get bit 0x20 set.
+inline __m128i fold(__m128i x) {
+  auto shifted = _mm_add_epi8(x, _mm_set1_epi8(static_cast<char>(0x80 - 'A')));
+  auto upper = _mm_cmpgt_epi8(_mm_set1_epi8(static_cast<char>(0x80 + 'Z' - 'A' + 1)), shifted);
+  return _mm_or_si128(x, _mm_and_si128(upper, _mm_set1_epi8(0x20)));
+}
+
+std::size_t mismatch_sse2(const char* a, const char* b, std::size_t size) {
+  std::size_t i = 0;
+  for (; i + 16 <= size; i += 16) {
+    auto x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+    auto y = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i));
+    auto equal = static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(fold(x), fold(y))));
+    if (equal != 0xffff) {
+      return i + static_cast<std::size_t>(__builtin_ctz(~equal));
+    }
+  }
+  return mismatch_scalar(a, b, size, i);
+}
+
+__attribute__((target("avx2"))) inline __m256i fold(__m256i x) {
+  auto shifted = _mm256_add_epi8(x, _mm256_set1_epi8(static_cast<char>(0x80 - 'A')));
+  auto upper = _mm256_cmpgt_epi8(_mm256_set1_epi8(static_cast<char>(0x80 + 'Z' - 'A' + 1)), shifted);
+  return _mm256_or_si256(x, _mm256_and_si256(upper, _mm256_set1_epi8(0x20)));
+}
+
+__attribute__((target("avx2"))) std::size_t mismatch_avx2(const char* a, const char* b, std::size_t size) {
+  std::size_t i = 0;
+  for (; i + 32 <= size; i += 32) {
+    auto x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+    auto y = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i));
+    auto equal = static_cast<unsigned>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(fold(x), fold(y))));
+    if (equal != 0xffffffffu) {
+      return i + static_cast<std::size_t>(__builtin_ctz(~equal));
+    }
+  }
+  return mismatch_scalar(a, b, size, i);
+}
+
+#endif
+
+typedef std::size_t (*mismatch_function)(const char*, const char*, std::size_t);
+
+mismatch_function select_mismatch() {
+#ifdef SQLITE_COLLATION_X86
+  if (__builtin_cpu_supports("avx2")) {
+    return mismatch_avx2;
+  }
+  return mismatch_sse2;
+#else
+  return [](const char* a, const char* b, std::size_t size) {
+    return mismatch_scalar(a, b, size);
+  };
+#endif
+}
+
+std::size_t mismatch(const char* a, const char* b, std::size_t size) {
+  static const mismatch_function function = select_mismatch();
+  return function(a, b, size);
+}
+
+}  // namespace
+
+int compare_nocase(const char* a, std::size_t a_size, const char* b, std::size_t b_size) {
+  auto size = std::min(a_size, b_size);
+  auto i = mismatch(a, b, size);
+  if (i < size) {
+    return fold(static_cast<unsigned char>(a[i])) - fold(static_cast<unsigned char>(b[i]));
+  }
+  return sign(static_cast<std::ptrdiff_t>(a_size) - static_cast<std::ptrdiff_t>(b_size));
+}
+
+int compare_natural(const char* a, std::size_t a_size, const char* b, std::size_t b_size) {
+  int tie = 0;
+  for (;;) {
+    auto size = std::min(a_size, b_size);
+    auto i = mismatch(a, b, size);
+
+    // The difference lies in a number when digits precede it, which both strings share, or
+    // when both strings continue with digits.
+    auto start = i;
+    while (start > 0 && digit(a[start - 1])) {
+      --start;
+    }
+    if (start == i && !(i < size && digit(a[i]) && digit(b[i]))) {
+      if (i < size) {
+        return fold(static_cast<unsigned char>(a[i])) - fold(static_cast<unsigned char>(b[i]));
+      }
+      auto order = sign(static_cast<std::ptrdiff_t>(a_size) - static_cast<std::ptrdiff_t>(b_size));
+      return order ? order : tie;
+    }
+
+    auto a_end = i;
+    while (a_end < a_size && digit(a[a_end])) {
+      ++a_end;
+    }
+    auto b_end = i;
+    while (b_end < b_size && digit(b[b_end])) {
+      ++b_end;
+    }
+    auto a_first = start;
+    while (a_first + 1 < a_end && a[a_first] == '0') {
+      ++a_first;
+    }
+    auto b_first = start;
+    while (b_first + 1 < b_end && b[b_first] == '0') {
+      ++b_first;
+    }
+    auto length = static_cast<std::ptrdiff_t>(a_end - a_first) - static_cast<std::ptrdiff_t>(b_end - b_first);
+    if (length) {
+      return sign(length);
+    }
+    for (auto j = a_first; j < a_end; j++) {
+      if (a[j] != b[j - a_first + b_first]) {
+        return a[j] - b[j - a_first + b_first];
+      }
+    }
+    if (!tie) {
+      tie = sign(static_cast<std::ptrdiff_t>(a_end) - static_cast<std::ptrdiff_t>(b_end));
+    }
+    a += a_end;
+    a_size -= a_end;
+    b += b_end;
+    b_size -= b_end;
+  }
+}
+
+void define_collations(const database& db) {
+  db.define_collation("ascii_nocase", compare_nocase);
+  db.define_collation("natural_nocase", compare_natural);
+}
+
+}  // namespace sqlite
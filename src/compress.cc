@@ -0,0 +1,758 @@
+#include <sqlite/compress.h>
+#include "lz4.h"
+#include "shim.h"
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace sqlite {
+namespace {
+
+compressed_vfs_options options;
+sqlite3_vfs vfs;
+std::once_flag registered;
+
+std::atomic<std::uint64_t> pages_written{ 0 };
+std::atomic<std::uint64_t> pages_read{ 0 };
+std::atomic<std::uint64_t> bytes_in{ 0 };
+std::atomic<std::uint64_t> bytes_out{ 0 };
+std::atomic<std::int64_t> compress_time{ 0 };
+std::atomic<std::int64_t> decompress_time{ 0 };
+
+// A compressed database file starts with two superblock slots that are written alternately,
+// so that one of them is intact when a write is torn. The newest valid slot points to the map
+// directory, which points to the map blocks, which point to the page records. Everything
+// behind the slots is allocated in multiples of `granularity` and never overwritten while a
+// superblock that was written refers to it.
+const char magic[8] = { 'S', 'Q', 'L', 'C', 'P', 'P', 'Z', '1' };
+const int slot_size = 512;
+const int slot_length = 64;
+const sqlite3_int64 data_start = 4096;
+const std::uint32_t granularity = 256;
+const std::size_t entries_per_block = 256;
+const std::size_t entry_size = 16;
+const std::size_t block_size = entries_per_block * entry_size;
+const std::uint32_t stored_raw = 1;
+
+// SQLITE_IOCAP_BATCH_ATOMIC of SQLite 3.21, which is newer than the bundled header.
+const int iocap_batch_atomic = 0x4000;
+
+struct entry {
+  std::uint64_t offset = 0;
+  std::uint32_t length = 0;
+  std::uint32_t flags = 0;
+};
+
+struct block {
+  entry entries[entries_per_block];
+  bool dirty = false;
+};
+
+struct superblock {
+  std::uint64_t generation = 0;
+  std::uint32_t unit = 0;
+  std::uint32_t blocks = 0;
+  std::uint64_t size = 0;
+  std::uint64_t directory = 0;
+  std::uint32_t checksum = 0;
+};
+
+void put32(unsigned char* p, std::uint32_t value) {
+  for (int i = 0; i < 4; i++) {
+    p[i] = static_cast<unsigned char>(value >> (8 * i));
+  }
+}
+
+void put64(unsigned char* p, std::uint64_t value) {
+  for (int i = 0; i < 8; i++) {
+    p[i] = static_cast<unsigned char>(value >> (8 * i));
+  }
+}
+
+std::uint32_t get32(const unsigned char* p) {
+  std::uint32_t value = 0;
+  for (int i = 0; i < 4; i++) {
+    value |= static_cast<std::uint32_t>(p[i]) << (8 * i);
+  }
+  return value;
+}
+
+std::uint64_t get64(const unsigned char* p) {
+  std::uint64_t value = 0;
+  for (int i = 0; i < 8; i++) {
+    value |= static_cast<std::uint64_t>(p[i]) << (8 * i);
+  }
+  return value;
+}
+
+std::uint32_t checksum(const unsigned char* data, std::size_t size) {
+  std::uint32_t hash = 2166136261u;
+  for (std::size_t i = 0; i < size; i++) {
+    hash = (hash ^ data[i]) * 16777619u;
+  }
+  return hash;
+}
+
+std::uint32_t round(std::uint32_t length) {
+  return (length + granularity - 1) / granularity * granularity;
+}
+
+struct file : shim::file {
+  // The superblock that was read or written last and the slot it is stored in.
+  superblock super;
+  int slot = 0;
+
+  // Page size of the file, the logical file size and the map.
+  std::uint32_t unit = 0;
+  std::uint64_t size = 0;
+  std::vector<std::uint64_t> directory;
+  std::vector<std::unique_ptr<block>> blocks;
+
+  // Free extents by offset, merged with their neighbours, and by size. Extents that were
+  // replaced since the last superblock are released and only become free once the next
+  // superblock no longer refers to them.
+  std::map<std::uint64_t, std::uint64_t> free;
+  std::multimap<std::uint64_t, std::uint64_t> free_by_size;
+  std::vector<std::pair<std::uint64_t, std::uint32_t>> released;
+  bool free_valid = true;
+  std::uint64_t end = data_start;
+
+  bool dirty = false;
+  int lock = SQLITE_LOCK_NONE;
+
+  // The last page that was decompressed.
+  std::vector<unsigned char> page;
+  std::vector<unsigned char> packed;
+  sqlite3_int64 cached = -1;
+};
+
+file& self(sqlite3_file* f) {
+  return *reinterpret_cast<file*>(f);
+}
+
+int read_at(file& f, void* buffer, std::size_t amount, std::uint64_t offset) {
+  auto hresult = shim::methods(&f.base)->xRead(f.real, buffer, static_cast<int>(amount), static_cast<sqlite3_int64>(offset));
+  return hresult == SQLITE_IOERR_SHORT_READ ? SQLITE_CORRUPT : hresult;
+}
+
+int write_at(file& f, const void* buffer, std::size_t amount, std::uint64_t offset) {
+  return shim::methods(&f.base)->xWrite(f.real, buffer, static_cast<int>(amount), static_cast<sqlite3_int64>(offset));
+}
+
+std::uint64_t physical_size(file& f) {
+  sqlite3_int64 size = 0;
+  shim::methods(&f.base)->xFileSize(f.real, &size);
+  return static_cast<std::uint64_t>(size);
+}
+
+bool decode(const unsigned char* slot, superblock& s) {
+  if (std::memcmp(slot, magic, sizeof(magic)) != 0 || get32(slot + 60) != checksum(slot, 60)) {
+    return false;
+  }
+  s.generation = get64(slot + 8);
+  s.unit = get32(slot + 16);
+  s.blocks = get32(slot + 20);
+  s.size = get64(slot + 24);
+  s.directory = get64(slot + 32);
+  s.checksum = get32(slot + 40);
+  return true;
+}
+
+void encode(const superblock& s, unsigned char* slot) {
+  std::memset(slot, 0, slot_length);
+  std::memcpy(slot, magic, sizeof(magic));
+  put64(slot + 8, s.generation);
+  put32(slot + 16, s.unit);
+  put32(slot + 20, s.blocks);
+  put64(slot + 24, s.size);
+  put64(slot + 32, s.directory);
+  put32(slot + 40, s.checksum);
+  put32(slot + 60, checksum(slot, 60));
+}
+
+int load_block(file& f, std::uint64_t offset, block& b) {
+  unsigned char data[block_size];
+  auto hresult = read_at(f, data, block_size, offset);
+  if (hresult != SQLITE_OK) {
+    return hresult;
+  }
+  for (std::size_t i = 0; i < entries_per_block; i++) {
+    auto p = data + i * entry_size;
+    b.entries[i].offset = get64(p);
+    b.entries[i].length = get32(p + 8);
+    b.entries[i].flags = get32(p + 12);
+  }
+  return SQLITE_OK;
+}
+
+// Reads the newest superblock and the whole map if another connection wrote a newer one.
+// Sets `found` to false when the file has no valid superblock.
+//
+// The map is read up front, since the extents of the directory and the map blocks are
+// reused once a later superblock no longer refers to them. In WAL mode a read transaction
+// can outlive several checkpoints of other connections, and a map block read lazily by it
+// could already hold other data. The page records that its map points to stay valid: a
+// checkpoint only writes back pages that such a reader reads from the WAL.
+int refresh(file& f, bool& found) {
+  unsigned char slots[slot_size + slot_length] = {};
+  auto hresult = shim::methods(&f.base)->xRead(f.real, slots, sizeof(slots), 0);
+  if (hresult != SQLITE_OK && hresult != SQLITE_IOERR_SHORT_READ) {
+    return hresult;
+  }
+  superblock candidates[2];
+  bool valid[2] = { decode(slots, candidates[0]), decode(slots + slot_size, candidates[1]) };
+  found = valid[0] || valid[1];
+  if (!found) {
+    return SQLITE_OK;
+  }
+  int newest = !valid[0] || (valid[1] && candidates[1].generation > candidates[0].generation) ? 1 : 0;
+  auto& s = candidates[newest];
+  if (s.generation == f.super.generation) {
+    return SQLITE_OK;
+  }
+
+  std::vector<unsigned char> directory(s.blocks * 8);
+  if (s.blocks) {
+    hresult = read_at(f, directory.data(), directory.size(), s.directory);
+    if (hresult != SQLITE_OK) {
+      return hresult;
+    }
+    if (checksum(directory.data(), directory.size()) != s.checksum) {
+      return SQLITE_CORRUPT;
+    }
+  }
+  std::vector<std::uint64_t> offsets(s.blocks, 0);
+  std::vector<std::unique_ptr<block>> blocks(s.blocks);
+  for (std::size_t i = 0; i < s.blocks; i++) {
+    offsets[i] = get64(directory.data() + i * 8);
+    if (offsets[i]) {
+      blocks[i].reset(new block());
+      hresult = load_block(f, offsets[i], *blocks[i]);
+      if (hresult != SQLITE_OK) {
+        return hresult;
+      }
+    }
+  }
+  f.super = s;
+  f.slot = newest;
+  f.unit = s.unit;
+  f.size = s.size;
+  f.directory.swap(offsets);
+  f.blocks.swap(blocks);
+  f.cached = -1;
+  f.free.clear();
+  f.free_by_size.clear();
+  f.free_valid = false;
+  return SQLITE_OK;
+}
+
+// Returns the map block with the given number. Returns null when it does not exist and
+// `create` is false.
+block* get_block(file& f, std::size_t number, bool create) {
+  if (number >= f.blocks.size()) {
+    if (!create) {
+      return nullptr;
+    }
+    f.blocks.resize(number + 1);
+    f.directory.resize(number + 1, 0);
+  }
+  auto& b = f.blocks[number];
+  if (!b) {
+    if (!create) {
+      return nullptr;
+    }
+    b.reset(new block());
+  }
+  return b.get();
+}
+
+void erase_free(file& f, std::map<std::uint64_t, std::uint64_t>::iterator it) {
+  auto range = f.free_by_size.equal_range(it->second);
+  for (auto i = range.first; i != range.second; ++i) {
+    if (i->second == it->first) {
+      f.free_by_size.erase(i);
+      break;
+    }
+  }
+  f.free.erase(it);
+}
+
+void add_free(file& f, std::uint64_t offset, std::uint64_t size) {
+  auto next = f.free.lower_bound(offset);
+  if (next != f.free.end() && offset + size == next->first) {
+    size += next->second;
+    erase_free(f, next);
+  }
+  next = f.free.lower_bound(offset);
+  if (next != f.free.begin()) {
+    auto previous = std::prev(next);
+    if (previous->first + previous->second == offset) {
+      offset = previous->first;
+      size += previous->second;
+      erase_free(f, previous);
+    }
+  }
+  f.free.emplace(offset, size);
+  f.free_by_size.emplace(size, offset);
+}
+
+// Rebuilds the free extents from the gaps between the extents that are in use.
+int rebuild_free(file& f) {
+  std::vector<std::pair<std::uint64_t, std::uint64_t>> used;
+  used.emplace_back(0, data_start);
+  if (f.super.blocks) {
+    used.emplace_back(f.super.directory, f.super.directory + round(f.super.blocks * 8));
+  }
+  for (std::size_t number = 0; number < f.directory.size(); number++) {
+    auto b = get_block(f, number, false);
+    if (!b) {
+      continue;
+    }
+    if (f.directory[number]) {
+      used.emplace_back(f.directory[number], f.directory[number] + block_size);
+    }
+    for (auto& e : b->entries) {
+      if (e.offset) {
+        used.emplace_back(e.offset, e.offset + round(e.length));
+      }
+    }
+  }
+  std::sort(used.begin(), used.end());
+  f.free.clear();
+  f.free_by_size.clear();
+  std::uint64_t position = 0;
+  for (auto& extent : used) {
+    if (extent.first > position) {
+      add_free(f, position, extent.first - position);
+    }
+    position = std::max(position, extent.second);
+  }
+  f.end = position;
+  f.free_valid = true;
+  return SQLITE_OK;
+}
+
+std::uint64_t allocate(file& f, std::uint32_t length) {
+  auto size = round(length);
+  auto it = f.free_by_size.lower_bound(size);
+  if (it != f.free_by_size.end()) {
+    auto offset = it->second;
+    auto rest = it->first - size;
+    erase_free(f, f.free.find(offset));
+    if (rest) {
+      add_free(f, offset + size, rest);
+    }
+    return offset;
+  }
+  auto offset = f.end;
+  f.end += size;
+  return offset;
+}
+
+void release(file& f, std::uint64_t offset, std::uint32_t length) {
+  if (offset) {
+    f.released.emplace_back(offset, round(length));
+  }
+}
+
+// Stores a page of `unit` bytes, uncompressed when compression does not save space.
+int store(file& f, sqlite3_int64 index, const unsigned char* data) {
+  auto start = std::chrono::steady_clock::now();
+  auto length = lz4::compress(data, f.unit, f.packed.data(), f.packed.size());
+  compress_time += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+
+  const unsigned char* stored = f.packed.data();
+  std::uint32_t flags = 0;
+  if (length == 0 || round(static_cast<std::uint32_t>(length)) >= f.unit) {
+    stored = data;
+    length = f.unit;
+    flags = stored_raw;
+  }
+
+  auto b = get_block(f, static_cast<std::size_t>(index / entries_per_block), true);
+  auto& e = b->entries[index % entries_per_block];
+  auto offset = allocate(f, static_cast<std::uint32_t>(length));
+  auto hresult = write_at(f, stored, length, offset);
+  if (hresult != SQLITE_OK) {
+    return hresult;
+  }
+  release(f, e.offset, e.length);
+  e.offset = offset;
+  e.length = static_cast<std::uint32_t>(length);
+  e.flags = flags;
+  b->dirty = true;
+  f.dirty = true;
+  if (f.cached == index) {
+    f.cached = -1;
+  }
+
+  pages_written++;
+  bytes_in += f.unit;
+  bytes_out += length;
+  return SQLITE_OK;
+}
+
+// Decompresses a page into `file::page`. Pages that were never written read as zeros.
+int load(file& f, sqlite3_int64 index) {
+  if (f.cached == index) {
+    return SQLITE_OK;
+  }
+  f.page.resize(f.unit);
+  auto hresult = SQLITE_OK;
+  auto b = get_block(f, static_cast<std::size_t>(index / entries_per_block), false);
+  const entry* e = b ? &b->entries[index % entries_per_block] : nullptr;
+  if (!e || !e->offset) {
+    std::memset(f.page.data(), 0, f.unit);
+  } else if (e->flags & stored_raw) {
+    hresult = read_at(f, f.page.data(), f.unit, e->offset);
+  } else {
+    f.packed.resize(std::max<std::size_t>(f.packed.size(), e->length));
+    hresult = read_at(f, f.packed.data(), e->length, e->offset);
+    if (hresult == SQLITE_OK) {
+      auto start = std::chrono::steady_clock::now();
+      bool decompressed = lz4::decompress(f.packed.data(), e->length, f.page.data(), f.unit);
+      decompress_time += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+      hresult = decompressed ? SQLITE_OK : SQLITE_CORRUPT;
+    }
+    pages_read++;
+  }
+  f.cached = hresult == SQLITE_OK ? index : -1;
+  return hresult;
+}
+
+// Writes the changed map blocks, the directory and a new superblock. With `flags` the
+// records and the map are synced before the superblock is written, and the superblock after.
+int persist(file& f, int flags) {
+  if (!f.dirty) {
+    return flags ? shim::methods(&f.base)->xSync(f.real, flags) : SQLITE_OK;
+  }
+
+  unsigned char data[block_size];
+  for (std::size_t number = 0; number < f.blocks.size(); number++) {
+    auto& b = f.blocks[number];
+    if (!b || !b->dirty) {
+      continue;
+    }
+    for (std::size_t i = 0; i < entries_per_block; i++) {
+      auto p = data + i * entry_size;
+      put64(p, b->entries[i].offset);
+      put32(p + 8, b->entries[i].length);
+      put32(p + 12, b->entries[i].flags);
+    }
+    auto offset = allocate(f, block_size);
+    auto hresult = write_at(f, data, block_size, offset);
+    if (hresult != SQLITE_OK) {
+      return hresult;
+    }
+    release(f, f.directory[number], block_size);
+    f.directory[number] = offset;
+    b->dirty = false;
+  }
+
+  superblock next;
+  next.generation = f.super.generation + 1;
+  next.unit = f.unit;
+  next.blocks = static_cast<std::uint32_t>(f.directory.size());
+  next.size = f.size;
+  if (next.blocks) {
+    std::vector<unsigned char> directory(next.blocks * 8);
+    for (std::size_t i = 0; i < f.directory.size(); i++) {
+      put64(directory.data() + i * 8, f.directory[i]);
+    }
+    next.directory = allocate(f, static_cast<std::uint32_t>(directory.size()));
+    next.checksum = checksum(directory.data(), directory.size());
+    auto hresult = write_at(f, directory.data(), directory.size(), next.directory);
+    if (hresult != SQLITE_OK) {
+      return hresult;
+    }
+  }
+  if (f.super.blocks) {
+    release(f, f.super.directory, f.super.blocks * 8);
+  }
+
+  if (flags) {
+    auto hresult = shim::methods(&f.base)->xSync(f.real, flags);
+    if (hresult != SQLITE_OK) {
+      return hresult;
+    }
+  }
+  unsigned char slot[slot_length];
+  encode(next, slot);
+  auto position = 1 - f.slot;
+  auto hresult = write_at(f, slot, slot_length, static_cast<std::uint64_t>(position) * slot_size);
+  if (hresult == SQLITE_OK && flags) {
+    hresult = shim::methods(&f.base)->xSync(f.real, flags);
+  }
+  if (hresult != SQLITE_OK) {
+    return hresult;
+  }
+
+  f.super = next;
+  f.slot = position;
+  f.dirty = false;
+  for (auto& extent : f.released) {
+    add_free(f, extent.first, extent.second);
+  }
+  f.released.clear();
+
+  // Free space at the end of the file is given back.
+  if (!f.free.empty()) {
+    auto last = std::prev(f.free.end());
+    if (last->first + last->second >= f.end) {
+      f.end = last->first;
+      erase_free(f, last);
+      shim::methods(&f.base)->xTruncate(f.real, static_cast<sqlite3_int64>(f.end));
+    }
+  }
+  return SQLITE_OK;
+}
+
+int compressed_close(sqlite3_file* f) {
+  auto hresult = persist(self(f), 0);
+  auto closed = shim::close<file>(f);
+  return hresult != SQLITE_OK ? hresult : closed;
+}
+
+int compressed_read(sqlite3_file* f, void* buffer, int amount, sqlite3_int64 offset) {
+  auto& s = self(f);
+  auto out = static_cast<unsigned char*>(buffer);
+  auto end = static_cast<std::uint64_t>(offset + amount);
+  auto available = s.unit ? std::max<std::uint64_t>(std::min(end, s.size), offset) : offset;
+  for (auto position = static_cast<std::uint64_t>(offset); position < available;) {
+    auto index = static_cast<sqlite3_int64>(position / s.unit);
+    auto within = position % s.unit;
+    auto n = std::min<std::uint64_t>(s.unit - within, available - position);
+    auto hresult = load(s, index);
+    if (hresult != SQLITE_OK) {
+      return hresult;
+    }
+    std::memcpy(out + (position - offset), s.page.data() + within, n);
+    position += n;
+  }
+  if (available < end) {
+    std::memset(out + (available - offset), 0, end - available);
+    return SQLITE_IOERR_SHORT_READ;
+  }
+  return SQLITE_OK;
+}
+
+int compressed_write(sqlite3_file* f, const void* buffer, int amount, sqlite3_int64 offset) {
+  auto& s = self(f);
+  if (!s.free_valid) {
+    auto hresult = rebuild_free(s);
+    if (hresult != SQLITE_OK) {
+      return hresult;
+    }
+  }
+  if (!s.unit) {
+    s.unit = amount >= 512 && amount <= 65536 && (amount & (amount - 1)) == 0 ? amount : 4096;
+  }
+  s.packed.resize(std::max<std::size_t>(s.packed.size(), s.unit));
+
+  auto data = static_cast<const unsigned char*>(buffer);
+  auto end = static_cast<std::uint64_t>(offset + amount);
+  for (auto position = static_cast<std::uint64_t>(offset); position < end;) {
+    auto index = static_cast<sqlite3_int64>(position / s.unit);
+    auto within = position % s.unit;
+    auto n = std::min<std::uint64_t>(s.unit - within, end - position);
+    int hresult;
+    if (n == s.unit) {
+      hresult = store(s, index, data + (position - offset));
+    } else {
+      // Partial pages are merged with their current content.
+      hresult = load(s, index);
+      if (hresult == SQLITE_OK) {
+        std::memcpy(s.page.data() + within, data + (position - offset), n);
+        hresult = store(s, index, s.page.data());
+        s.cached = index;
+      }
+    }
+    if (hresult != SQLITE_OK) {
+      return hresult;
+    }
+    position += n;
+  }
+  if (end > s.size) {
+    s.size = end;
+    s.dirty = true;
+  }
+  return SQLITE_OK;
+}
+
+int compressed_truncate(sqlite3_file* f, sqlite3_int64 size) {
+  auto& s = self(f);
+  if (!s.unit || static_cast<std::uint64_t>(size) >= s.size) {
+    return SQLITE_OK;
+  }
+  if (!s.free_valid) {
+    auto hresult = rebuild_free(s);
+    if (hresult != SQLITE_OK) {
+      return hresult;
+    }
+  }
+  auto keep = (static_cast<std::uint64_t>(size) + s.unit - 1) / s.unit;
+  auto pages = (s.size + s.unit - 1) / s.unit;
+  for (auto index = keep; index < pages; index++) {
+    auto b = get_block(s, static_cast<std::size_t>(index / entries_per_block), false);
+    if (b && b->entries[index % entries_per_block].offset) {
+      auto& e = b->entries[index % entries_per_block];
+      release(s, e.offset, e.length);
+      e = entry();
+      b->dirty = true;
+    }
+  }
+  s.size = static_cast<std::uint64_t>(size);
+  s.cached = -1;
+  s.dirty = true;
+  return SQLITE_OK;
+}
+
+int compressed_sync(sqlite3_file* f, int flags) {
+  return persist(self(f), flags);
+}
+
+int compressed_file_size(sqlite3_file* f, sqlite3_int64* size) {
+  *size = static_cast<sqlite3_int64>(self(f).size);
+  return SQLITE_OK;
+}
+
+// Other connections may have written a new superblock while this one held no lock.
+int compressed_lock(sqlite3_file* f, int level) {
+  auto& s = self(f);
+  auto hresult = shim::lock(f, level);
+  if (hresult == SQLITE_OK && s.lock == SQLITE_LOCK_NONE && !s.dirty) {
+    bool found;
+    hresult = refresh(s, found);
+  }
+  if (hresult == SQLITE_OK) {
+    s.lock = level;
+  }
+  return hresult;
+}
+
+int compressed_unlock(sqlite3_file* f, int level) {
+  auto& s = self(f);
+  auto hresult = persist(s, 0);
+  if (hresult != SQLITE_OK) {
+    return hresult;
+  }
+  hresult = shim::unlock(f, level);
+  if (hresult == SQLITE_OK) {
+    s.lock = level;
+  }
+  return hresult;
+}
+
+int compressed_file_control(sqlite3_file* f, int op, void* argument) {
+  switch (op) {
+  case SQLITE_FCNTL_MMAP_SIZE:
+    *static_cast<sqlite3_int64*>(argument) = 0;
+    return SQLITE_OK;
+  case SQLITE_FCNTL_SIZE_HINT:
+  case SQLITE_FCNTL_CHUNK_SIZE:
+    // The physical size has no relation to the logical size.
+    return SQLITE_OK;
+  }
+  return shim::file_control(f, op, argument);
+}
+
+// Pages are never overwritten in place, so atomic write capabilities do not carry over.
+int compressed_device_characteristics(sqlite3_file* f) {
+  int atomic = SQLITE_IOCAP_ATOMIC | SQLITE_IOCAP_ATOMIC512 | SQLITE_IOCAP_ATOMIC1K | SQLITE_IOCAP_ATOMIC2K |
+               SQLITE_IOCAP_ATOMIC4K | SQLITE_IOCAP_ATOMIC8K | SQLITE_IOCAP_ATOMIC16K | SQLITE_IOCAP_ATOMIC32K |
+               SQLITE_IOCAP_ATOMIC64K;
+  return shim::device_characteristics(f) & ~(atomic | iocap_batch_atomic);
+}
+
+int compressed_shm_lock(sqlite3_file* f, int offset, int count, int flags) {
+  auto& s = self(f);
+  if (flags & SQLITE_SHM_UNLOCK) {
+    auto hresult = persist(s, 0);
+    if (hresult != SQLITE_OK) {
+      return hresult;
+    }
+  }
+  auto hresult = shim::shm_lock(f, offset, count, flags);
+  if (hresult == SQLITE_OK && (flags & SQLITE_SHM_LOCK) && (flags & SQLITE_SHM_SHARED) && !s.dirty) {
+    bool found;
+    hresult = refresh(s, found);
+  }
+  return hresult;
+}
+
+const sqlite3_io_methods compressed_methods = {
+  3,
+  compressed_close,
+  compressed_read,
+  compressed_write,
+  compressed_truncate,
+  compressed_sync,
+  compressed_file_size,
+  compressed_lock,
+  compressed_unlock,
+  shim::check_reserved_lock,
+  compressed_file_control,
+  shim::sector_size,
+  compressed_device_characteristics,
+  shim::shm_map,
+  compressed_shm_lock,
+  shim::shm_barrier,
+  shim::shm_unmap,
+  shim::no_fetch,
+  shim::no_unfetch,
+};
+
+int open(sqlite3_vfs* v, const char* name, sqlite3_file* f, int flags, int* out_flags) {
+  int hresult;
+  auto self = shim::open<file>(v, name, f, flags, out_flags, hresult);
+  if (!self) {
+    return hresult;
+  }
+  if (!(flags & SQLITE_OPEN_MAIN_DB)) {
+    f->pMethods = shim::passthrough<file>();
+    return SQLITE_OK;
+  }
+
+  f->pMethods = &compressed_methods;
+  if (physical_size(*self) > 0) {
+    bool found = false;
+    hresult = refresh(*self, found);
+    if (hresult == SQLITE_OK && !found) {
+      hresult = SQLITE_NOTADB;
+    }
+    if (hresult != SQLITE_OK) {
+      shim::close<file>(f);
+      f->pMethods = nullptr;
+      return hresult;
+    }
+  }
+  return SQLITE_OK;
+}
+
+}  // namespace
+
+sqlite3_vfs* compressed_vfs(const compressed_vfs_options& o) {
+  std::call_once(registered, [&o]() {
+    options = o;
+    shim::install<file>(vfs, sqlite3_vfs_find(nullptr), "compressed", open, options.make_default);
+  });
+  return &vfs;
+}
+
+compression_statistics compressed_vfs_statistics() {
+  compression_statistics s;
+  s.pages_written = pages_written;
+  s.pages_read = pages_read;
+  s.bytes_in = bytes_in;
+  s.bytes_out = bytes_out;
+  s.compress_time = std::chrono::nanoseconds(compress_time.load());
+  s.decompress_time = std::chrono::nanoseconds(decompress_time.load());
+  return s;
+}
+
+}  // namespace sqlite
@@ -0,0 +1,101 @@
+#include <sqlite/config.h>
+#include <cstdint>
+
+namespace sqlite {
+namespace {
+
+template<typename... Arguments>
+void configure(int option, Arguments... arguments) {
+  auto hresult = sqlite3_config(option, arguments...);
+  if (hresult == SQLITE_MISUSE) {
+    throw sqlite_exception("sqlite::initialize must be called once, before the first database is opened");
+  }
+  if (hresult != SQLITE_OK) {
+    throw sqlite_exception(sqlite3_errstr(hresult));
+  }
+}
+
+// Buffers handed to SQLite must stay valid until the process exits.
+void* allocate(int size, int count) {
+  auto words = (static_cast<std::size_t>(size) * count + sizeof(std::uint64_t) - 1) / sizeof(std::uint64_t);
+  return new std::uint64_t[words];
+}
+
+}  // namespace
+
+void initialize(const config& options) {
+  // Every option is refused once the library is initialized, and reading the allocator
+  // changes nothing, so this fails even when the settings would not call sqlite3_config.
+  sqlite3_mem_methods methods;
+  configure(SQLITE_CONFIG_GETMALLOC, &methods);
+
+  switch (options.threading) {
+  case threading_mode::unchanged:
+    break;
+  case threading_mode::single_thread:
+    configure(SQLITE_CONFIG_SINGLETHREAD);
+    break;
+  case threading_mode::multi_thread:
+    configure(SQLITE_CONFIG_MULTITHREAD);
+    break;
+  case threading_mode::serialized:
+    configure(SQLITE_CONFIG_SERIALIZED);
+    break;
+  }
+
+  switch (options.allocator) {
+  case memory_allocator::system:
+    break;
+  case memory_allocator::pool:
+    configure(SQLITE_CONFIG_MALLOC, pool_allocator());
+    break;
+  }
+
+  switch (options.mutex) {
+  case mutex_implementation::system:
+    break;
+  case mutex_implementation::futex:
+    configure(SQLITE_CONFIG_MUTEX, futex_mutex(options.futex));
+    break;
+  }
+
+  switch (options.page_cache) {
+  case page_cache_implementation::system:
+    break;
+  case page_cache_implementation::clock:
+    configure(SQLITE_CONFIG_PCACHE2, clock_page_cache(options.clock_cache));
+    break;
+  }
+
+  if (options.memstatus >= 0) {
+    configure(SQLITE_CONFIG_MEMSTATUS, options.memstatus);
+  }
+
+  if (options.lookaside_size >= 0 && options.lookaside_count >= 0) {
+    configure(SQLITE_CONFIG_LOOKASIDE, options.lookaside_size, options.lookaside_count);
+  }
+
+  if (options.page_cache_size > 0 && options.page_cache_count > 0) {
+    auto buffer = allocate(options.page_cache_size, options.page_cache_count);
+    configure(SQLITE_CONFIG_PAGECACHE, buffer, options.page_cache_size, options.page_cache_count);
+  }
+
+  if (options.scratch_size > 0 && options.scratch_count > 0 && sqlite3_libversion_number() < 3021000) {
+    auto buffer = allocate(options.scratch_size, options.scratch_count);
+    configure(SQLITE_CONFIG_SCRATCH, buffer, options.scratch_size, options.scratch_count);
+  }
+
+  if (options.mmap_size >= 0 || options.mmap_limit >= 0) {
+    auto limit = options.mmap_limit >= 0 ? options.mmap_limit : options.mmap_size;
+    // A negative size keeps the compile-time default.
+    auto size = options.mmap_size >= 0 ? options.mmap_size : -1;
+    configure(SQLITE_CONFIG_MMAP_SIZE, size, limit);
+  }
+
+  auto hresult = sqlite3_initialize();
+  if (hresult != SQLITE_OK) {
+    throw sqlite_exception(sqlite3_errstr(hresult));
+  }
+}
+
+}  // namespace sqlite
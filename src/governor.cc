@@ -0,0 +1,103 @@
+#include <sqlite/governor.h>
+#include <algorithm>
+
+namespace sqlite {
+
+memory_governor::memory_governor(governor_options options) : options_(options) {
+  previous_limit_ = sqlite3_soft_heap_limit64(options_.budget);
+  if (options_.interval.count() > 0) {
+    thread_ = std::thread([this]() {
+      std::unique_lock<std::mutex> lock(mutex_);
+      while (!condition_.wait_for(lock, options_.interval, [this]() {
+        return stopping_;
+      })) {
+        lock.unlock();
+        check();
+        lock.lock();
+      }
+    });
+  }
+}
+
+memory_governor::~memory_governor() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  condition_.notify_one();
+  if (thread_.joinable()) {
+    thread_.join();
+  }
+  sqlite3_soft_heap_limit64(previous_limit_);
+}
+
+void memory_governor::attach(const database& db) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  databases_.push_back(&db);
+}
+
+void memory_governor::detach(const database& db) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  databases_.erase(std::remove(databases_.begin(), databases_.end(), &db), databases_.end());
+}
+
+void memory_governor::on_pressure(std::function<void(const memory_pressure&)> callback) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  callbacks_.push_back(std::move(callback));
+}
+
+sqlite3_int64 memory_governor::usage() const {
+  sqlite3_int64 caches = 0;
+  for (auto db : databases_) {
+    int current = 0;
+    int highwater = 0;
+    if (sqlite3_db_status(db->handle(), SQLITE_DBSTATUS_CACHE_USED, &current, &highwater, 0) == SQLITE_OK) {
+      caches += current;
+    }
+  }
+  return std::max(sqlite3_memory_used(), caches);
+}
+
+sqlite3_int64 memory_governor::used() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return usage();
+}
+
+sqlite3_int64 memory_governor::check() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  if (options_.budget <= 0) {
+    return 0;
+  }
+  auto target = static_cast<sqlite3_int64>(options_.budget * options_.threshold);
+  memory_pressure pressure;
+  pressure.budget = options_.budget;
+  pressure.before = usage();
+  pressure.after = pressure.before;
+  if (pressure.before <= target) {
+    return 0;
+  }
+
+  // Least recently used connections give up their caches first.
+  auto order = databases_;
+  std::sort(order.begin(), order.end(), [](const database* a, const database* b) {
+    return a->last_used() < b->last_used();
+  });
+  for (auto db : order) {
+    if (pressure.after <= target) {
+      break;
+    }
+    sqlite3_db_release_memory(db->handle());
+    pressure.released++;
+    pressure.after = usage();
+  }
+
+  // Callbacks may attach or detach connections.
+  auto callbacks = callbacks_;
+  lock.unlock();
+  for (const auto& callback : callbacks) {
+    callback(pressure);
+  }
+  return std::max<sqlite3_int64>(pressure.before - pressure.after, 0);
+}
+
+}  // namespace sqlite
@@ -0,0 +1,353 @@
+#include <sqlite/instrument.h>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include "shim.h"
+
+namespace sqlite {
+namespace {
+
+constexpr std::size_t bucket_count = sizeof(io_histogram::buckets) / sizeof(io_histogram::buckets[0]);
+
+struct counters {
+  std::atomic<std::uint64_t> count{ 0 };
+  std::atomic<std::uint64_t> bytes{ 0 };
+  std::atomic<std::uint64_t> time{ 0 };
+  std::atomic<std::uint64_t> buckets[bucket_count] = {};
+
+  void record(std::chrono::steady_clock::time_point start, std::uint64_t amount) {
+    auto ns = static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+    std::size_t bucket = 0;
+    for (auto n = ns; n > 1 && bucket + 1 < bucket_count; n >>= 1) {
+      ++bucket;
+    }
+    count.fetch_add(1, std::memory_order_relaxed);
+    bytes.fetch_add(amount, std::memory_order_relaxed);
+    time.fetch_add(ns, std::memory_order_relaxed);
+    buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+  }
+
+  void copy(io_histogram& h) const {
+    h.count = count.load(std::memory_order_relaxed);
+    h.bytes = bytes.load(std::memory_order_relaxed);
+    h.time = std::chrono::nanoseconds(time.load(std::memory_order_relaxed));
+    for (std::size_t i = 0; i < bucket_count; i++) {
+      h.buckets[i] = buckets[i].load(std::memory_order_relaxed);
+    }
+  }
+
+  void reset() {
+    count = 0;
+    bytes = 0;
+    time = 0;
+    for (auto& b : buckets) {
+      b = 0;
+    }
+  }
+};
+
+struct entry {
+  file_kind kind = file_kind::other;
+  counters operations[4];
+};
+
+sqlite3_vfs vfs;
+std::once_flag registered;
+
+// Entries are never removed, so files keep plain pointers to them.
+std::mutex mutex;
+std::map<std::string, std::unique_ptr<entry>> entries;
+
+file_kind kind_of(int flags) {
+  if (flags & SQLITE_OPEN_MAIN_DB) {
+    return file_kind::main;
+  }
+  if (flags & SQLITE_OPEN_WAL) {
+    return file_kind::wal;
+  }
+  if (flags & (SQLITE_OPEN_MAIN_JOURNAL | SQLITE_OPEN_MASTER_JOURNAL)) {
+    return file_kind::journal;
+  }
+  return file_kind::other;
+}
+
+entry* find(const char* name, int flags) {
+  std::string path = name ? name : "(temporary)";
+  std::lock_guard<std::mutex> lock(mutex);
+  auto& e = entries[path];
+  if (!e) {
+    e.reset(new entry());
+    e->kind = kind_of(flags);
+  }
+  return e.get();
+}
+
+struct file : shim::file {
+  entry* stats = nullptr;
+};
+
+counters& of(sqlite3_file* f, io_operation operation) {
+  return reinterpret_cast<file*>(f)->stats->operations[static_cast<int>(operation)];
+}
+
+int read(sqlite3_file* f, void* buffer, int amount, sqlite3_int64 offset) {
+  auto start = std::chrono::steady_clock::now();
+  auto hresult = shim::read(f, buffer, amount, offset);
+  of(f, io_operation::read).record(start, static_cast<std::uint64_t>(amount));
+  return hresult;
+}
+
+int write(sqlite3_file* f, const void* buffer, int amount, sqlite3_int64 offset) {
+  auto start = std::chrono::steady_clock::now();
+  auto hresult = shim::write(f, buffer, amount, offset);
+  of(f, io_operation::write).record(start, static_cast<std::uint64_t>(amount));
+  return hresult;
+}
+
+int sync(sqlite3_file* f, int flags) {
+  auto start = std::chrono::steady_clock::now();
+  auto hresult = shim::sync(f, flags);
+  of(f, io_operation::sync).record(start, 0);
+  return hresult;
+}
+
+int lock(sqlite3_file* f, int level) {
+  auto start = std::chrono::steady_clock::now();
+  auto hresult = shim::lock(f, level);
+  of(f, io_operation::lock).record(start, 0);
+  return hresult;
+}
+
+int unlock(sqlite3_file* f, int level) {
+  auto start = std::chrono::steady_clock::now();
+  auto hresult = shim::unlock(f, level);
+  of(f, io_operation::lock).record(start, 0);
+  return hresult;
+}
+
+int shm_lock(sqlite3_file* f, int offset, int count, int flags) {
+  auto start = std::chrono::steady_clock::now();
+  auto hresult = shim::shm_lock(f, offset, count, flags);
+  of(f, io_operation::lock).record(start, 0);
+  return hresult;
+}
+
+const sqlite3_io_methods methods = {
+  3,
+  shim::close<file>,
+  read,
+  write,
+  shim::truncate,
+  sync,
+  shim::file_size,
+  lock,
+  unlock,
+  shim::check_reserved_lock,
+  shim::file_control,
+  shim::sector_size,
+  shim::device_characteristics,
+  shim::shm_map,
+  shm_lock,
+  shim::shm_barrier,
+  shim::shm_unmap,
+  shim::fetch,
+  shim::unfetch,
+};
+
+int open(sqlite3_vfs* v, const char* name, sqlite3_file* f, int flags, int* out_flags) {
+  int hresult;
+  auto self = shim::open<file>(v, name, f, flags, out_flags, hresult);
+  if (!self) {
+    return hresult;
+  }
+  self->stats = find(name, flags);
+  f->pMethods = &methods;
+  return SQLITE_OK;
+}
+
+const char* name_of(file_kind kind) {
+  switch (kind) {
+  case file_kind::main:
+    return "main";
+  case file_kind::wal:
+    return "wal";
+  case file_kind::journal:
+    return "journal";
+  default:
+    return "other";
+  }
+}
+
+const char* const operation_names[] = { "read", "write", "sync", "lock" };
+
+void quote(std::ostream& out, const std::string& s) {
+  out << '"';
+  for (auto c : s) {
+    switch (c) {
+    case '"':
+      out << "\\\"";
+      break;
+    case '\\':
+      out << "\\\\";
+      break;
+    case '\n':
+      out << "\\n";
+      break;
+    default:
+      if (static_cast<unsigned char>(c) < 0x20) {
+        char buffer[8];
+        std::snprintf(buffer, sizeof(buffer), "\\u%04x", static_cast<unsigned>(c));
+        out << buffer;
+      } else {
+        out << c;
+      }
+    }
+  }
+  out << '"';
+}
+
+void to_json(std::ostream& out, const std::vector<file_statistics>& statistics) {
+  out << "[";
+  for (std::size_t i = 0; i < statistics.size(); i++) {
+    auto& s = statistics[i];
+    out << (i ? "," : "") << "{\"path\":";
+    quote(out, s.path);
+    out << ",\"kind\":\"" << name_of(s.kind) << "\"";
+    for (int op = 0; op < 4; op++) {
+      auto& h = s.operations[op];
+      out << ",\"" << operation_names[op] << "\":{\"count\":" << h.count << ",\"bytes\":" << h.bytes << ",\"time_ns\":" << h.time.count()
+          << ",\"p50_ns\":" << h.percentile(0.5).count() << ",\"p99_ns\":" << h.percentile(0.99).count() << ",\"buckets\":[";
+      // Trailing empty buckets are left out.
+      auto last = bucket_count;
+      while (last > 0 && !h.buckets[last - 1]) {
+        --last;
+      }
+      for (std::size_t b = 0; b < last; b++) {
+        out << (b ? "," : "") << h.buckets[b];
+      }
+      out << "]}";
+    }
+    out << "}";
+  }
+  out << "]";
+}
+
+void to_prometheus(std::ostream& out, const std::vector<file_statistics>& statistics) {
+  out << "# TYPE sqlite_io_duration_seconds histogram\n";
+  for (auto& s : statistics) {
+    for (int op = 0; op < 4; op++) {
+      auto& h = s.operations[op];
+      std::ostringstream labels;
+      labels << "path=";
+      quote(labels, s.path);
+      labels << ",kind=\"" << name_of(s.kind) << "\",operation=\"" << operation_names[op] << "\"";
+      std::uint64_t cumulative = 0;
+      for (std::size_t b = 0; b < bucket_count; b++) {
+        cumulative += h.buckets[b];
+        out << "sqlite_io_duration_seconds_bucket{" << labels.str() << ",le=\"" << std::ldexp(1e-9, static_cast<int>(b) + 1) << "\"} " << cumulative << "\n";
+      }
+      out << "sqlite_io_duration_seconds_bucket{" << labels.str() << ",le=\"+Inf\"} " << h.count << "\n";
+      out << "sqlite_io_duration_seconds_sum{" << labels.str() << "} " << std::chrono::duration<double>(h.time).count() << "\n";
+      out << "sqlite_io_duration_seconds_count{" << labels.str() << "} " << h.count << "\n";
+    }
+  }
+  out << "# TYPE sqlite_io_bytes_total counter\n";
+  for (auto& s : statistics) {
+    for (int op = 0; op < 2; op++) {
+      out << "sqlite_io_bytes_total{path=";
+      quote(out, s.path);
+      out << ",kind=\"" << name_of(s.kind) << "\",operation=\"" << operation_names[op] << "\"} " << s.operations[op].bytes << "\n";
+    }
+  }
+}
+
+file_statistics snapshot(const std::string& path, const entry& e) {
+  file_statistics s;
+  s.path = path;
+  s.kind = e.kind;
+  for (int op = 0; op < 4; op++) {
+    e.operations[op].copy(s.operations[op]);
+  }
+  return s;
+}
+
+}  // namespace
+
+std::chrono::nanoseconds io_histogram::percentile(double fraction) const {
+  if (!count) {
+    return std::chrono::nanoseconds(0);
+  }
+  auto target = static_cast<std::uint64_t>(std::ceil(fraction * static_cast<double>(count)));
+  std::uint64_t seen = 0;
+  for (std::size_t i = 0; i < bucket_count; i++) {
+    seen += buckets[i];
+    if (seen >= target) {
+      return std::chrono::nanoseconds(std::int64_t(1) << (i + 1));
+    }
+  }
+  return std::chrono::nanoseconds(std::int64_t(1) << bucket_count);
+}
+
+sqlite3_vfs* instrumented_vfs(const instrumented_vfs_options& options) {
+  std::call_once(registered, [&options]() {
+    auto base = sqlite3_vfs_find(options.wrap);
+    if (options.wrap && !base) {
+      throw sqlite_exception(("no such VFS: " + std::string(options.wrap)).c_str());
+    }
+    shim::install<file>(vfs, base, "instrumented", open, options.make_default);
+  });
+  return &vfs;
+}
+
+std::vector<file_statistics> instrumented_vfs_statistics() {
+  std::vector<file_statistics> result;
+  std::lock_guard<std::mutex> lock(mutex);
+  for (auto& e : entries) {
+    result.push_back(snapshot(e.first, *e.second));
+  }
+  return result;
+}
+
+void reset_instrumented_vfs_statistics() {
+  std::lock_guard<std::mutex> lock(mutex);
+  for (auto& e : entries) {
+    for (auto& c : e.second->operations) {
+      c.reset();
+    }
+  }
+}
+
+std::string export_statistics(const std::vector<file_statistics>& statistics, export_format format) {
+  std::ostringstream out;
+  if (format == export_format::json) {
+    to_json(out, statistics);
+  } else {
+    to_prometheus(out, statistics);
+  }
+  return out.str();
+}
+
+std::vector<file_statistics> database::io_statistics() const {
+  std::vector<file_statistics> result;
+  auto name = sqlite3_db_filename(db_, "main");
+  if (!name || !*name) {
+    return result;
+  }
+  std::string path = name;
+  std::lock_guard<std::mutex> lock(mutex);
+  for (auto& candidate : { path, path + "-wal", path + "-journal" }) {
+    auto it = entries.find(candidate);
+    if (it != entries.end()) {
+      result.push_back(snapshot(it->first, *it->second));
+    }
+  }
+  return result;
+}
+
+}  // namespace sqlite
@@ -0,0 +1,162 @@
+#include "lz4.h"
+#include <cstdint>
+#include <cstring>
+
+namespace sqlite {
+namespace lz4 {
+namespace {
+
+const int hash_bits = 12;
+const std::size_t min_match = 4;
+
+// The last match starts at least 12 bytes and ends at least 5 bytes before the end.
+const std::size_t match_start_limit = 12;
+const std::size_t last_literals = 5;
+
+std::uint32_t read32(const unsigned char* p) {
+  std::uint32_t value;
+  std::memcpy(&value, p, sizeof(value));
+  return value;
+}
+
+std::uint32_t hash(std::uint32_t sequence) {
+  return (sequence * 2654435761u) >> (32 - hash_bits);
+}
+
+// Writes the remainder of a length that did not fit into its token nibble.
+unsigned char* put_length(unsigned char* out, std::size_t length) {
+  while (length >= 255) {
+    *out++ = 255;
+    length -= 255;
+  }
+  *out++ = static_cast<unsigned char>(length);
+  return out;
+}
+
+// Reads the remainder of a length. Returns false at the end of the input.
+bool get_length(const unsigned char*& in, const unsigned char* end, std::size_t& length) {
+  unsigned char byte;
+  do {
+    if (in >= end) {
+      return false;
+    }
+    byte = *in++;
+    length += byte;
+  } while (byte == 255);
+  return true;
+}
+
+}  // namespace
+
+std::size_t compress(const unsigned char* data, std::size_t size, unsigned char* out, std::size_t capacity) {
+  std::uint16_t table[1 << hash_bits] = {};
+  auto op = out;
+  auto out_end = out + capacity;
+  std::size_t anchor = 0;
+  std::size_t ip = 0;
+
+  // Emits the literals since `anchor` followed by a match, or only the literals at the end.
+  auto emit = [&](std::size_t literals, std::size_t offset, std::size_t match) -> bool {
+    auto needed = 1 + literals + literals / 255 + 1 + (offset ? 2 + match / 255 + 1 : 0);
+    if (static_cast<std::size_t>(out_end - op) < needed) {
+      return false;
+    }
+    auto token = op++;
+    *token = static_cast<unsigned char>((literals >= 15 ? 15 : literals) << 4);
+    if (literals >= 15) {
+      op = put_length(op, literals - 15);
+    }
+    std::memcpy(op, data + anchor, literals);
+    op += literals;
+    if (offset) {
+      *op++ = static_cast<unsigned char>(offset & 0xff);
+      *op++ = static_cast<unsigned char>(offset >> 8);
+      auto rest = match - min_match;
+      *token |= static_cast<unsigned char>(rest >= 15 ? 15 : rest);
+      if (rest >= 15) {
+        op = put_length(op, rest - 15);
+      }
+    }
+    return true;
+  };
+
+  if (size > match_start_limit) {
+    auto start_limit = size - match_start_limit;
+    auto match_limit = size - last_literals;
+    while (ip < start_limit) {
+      auto sequence = read32(data + ip);
+      auto& slot = table[hash(sequence)];
+      std::size_t candidate = slot;
+      slot = static_cast<std::uint16_t>(ip);
+      if (candidate < ip && ip - candidate <= 65535 && read32(data + candidate) == sequence) {
+        auto length = min_match;
+        while (ip + length < match_limit && data[candidate + length] == data[ip + length]) {
+          length++;
+        }
+        if (!emit(ip - anchor, ip - candidate, length)) {
+          return 0;
+        }
+        ip += length;
+        anchor = ip;
+        if (ip < start_limit) {
+          table[hash(read32(data + ip - 2))] = static_cast<std::uint16_t>(ip - 2);
+        }
+      } else {
+        ip++;
+      }
+    }
+  }
+  if (!emit(size - anchor, 0, 0)) {
+    return 0;
+  }
+  return static_cast<std::size_t>(op - out);
+}
+
+bool decompress(const unsigned char* data, std::size_t length, unsigned char* out, std::size_t size) {
+  auto in = data;
+  auto in_end = data + length;
+  std::size_t op = 0;
+  while (in < in_end) {
+    auto token = *in++;
+    std::size_t literals = token >> 4;
+    if (literals == 15 && !get_length(in, in_end, literals)) {
+      return false;
+    }
+    if (literals > static_cast<std::size_t>(in_end - in) || literals > size - op) {
+      return false;
+    }
+    std::memcpy(out + op, in, literals);
+    in += literals;
+    op += literals;
+    if (in == in_end) {
+      break;
+    }
+
+    if (in_end - in < 2) {
+      return false;
+    }
+    std::size_t offset = in[0] | (in[1] << 8);
+    in += 2;
+    std::size_t match = token & 15;
+    if (match == 15 && !get_length(in, in_end, match)) {
+      return false;
+    }
+    match += min_match;
+    if (offset == 0 || offset > op || match > size - op) {
+      return false;
+    }
+    auto from = out + op - offset;
+    if (offset >= match) {
+      std::memcpy(out + op, from, match);
+    } else {
+      for (std::size_t i = 0; i < match; i++) {
+        out[op + i] = from[i];
+      }
+    }
+    op += match;
+  }
+  return op == size;
+}
+
+}  // namespace lz4
+}  // namespace sqlite
@@ -0,0 +1,18 @@
+#pragma once
+#include <cstddef>
+
+// Compressor and decompressor for the LZ4 block format, which is fast enough to be applied
+// to every page that is read or written.
+namespace sqlite {
+namespace lz4 {
+
+// Compresses `size` bytes into `out` and returns the compressed size, or zero when the result
+// does not fit into `capacity` bytes. Inputs of up to 64 KiB are supported.
+std::size_t compress(const unsigned char* data, std::size_t size, unsigned char* out, std::size_t capacity);
+
+// Decompresses a block and returns true when it expands to exactly `size` bytes. Malformed
+// blocks are rejected without reading or writing out of bounds.
+bool decompress(const unsigned char* data, std::size_t length, unsigned char* out, std::size_t size);
+
+}  // namespace lz4
+}  // namespace sqlite
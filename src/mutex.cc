@@ -0,0 +1,281 @@
+#include <sqlite/mutex.h>
+#include <atomic>
+#include <cstdlib>
+#include <mutex>
+#include <new>
+#include <thread>
+
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace sqlite {
+namespace {
+
+const std::size_t cache_line = 64;
+const int first_static = SQLITE_MUTEX_STATIC_MASTER;
+const int static_count = 16;
+
+futex_mutex_options options;
+
+// The lock word is 0 when unlocked, 1 when locked and 2 when locked with waiters.
+struct alignas(cache_line) mutex {
+  std::atomic<std::uint32_t> state{ 0 };
+  std::atomic<std::thread::id> owner{ std::thread::id() };
+  std::uint32_t depth = 0;
+  int type = SQLITE_MUTEX_FAST;
+
+  std::atomic<std::uint64_t> acquires{ 0 };
+  std::atomic<std::uint64_t> contended{ 0 };
+  std::atomic<std::uint64_t> wait{ 0 };
+
+  // Start of the allocation of a dynamic mutex, which is aligned by hand.
+  void* allocation = nullptr;
+};
+
+mutex* cast(sqlite3_mutex* p) {
+  return reinterpret_cast<mutex*>(p);
+}
+
+void park(std::atomic<std::uint32_t>& state, std::uint32_t value) {
+#ifdef __linux__
+  syscall(SYS_futex, reinterpret_cast<std::uint32_t*>(&state), FUTEX_WAIT_PRIVATE, value, nullptr, nullptr, 0);
+#else
+  if (state.load(std::memory_order_relaxed) == value) {
+    std::this_thread::yield();
+  }
+#endif
+}
+
+void wake(std::atomic<std::uint32_t>& state) {
+#ifdef __linux__
+  syscall(SYS_futex, reinterpret_cast<std::uint32_t*>(&state), FUTEX_WAKE_PRIVATE, 1, nullptr, nullptr, 0);
+#else
+  (void)state;
+#endif
+}
+
+void add(std::atomic<std::uint64_t>& counter, std::uint64_t value) {
+  counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+}
+
+mutex statics[static_count];
+
+struct totals {
+  std::atomic<std::uint64_t> acquires{ 0 };
+  std::atomic<std::uint64_t> contended{ 0 };
+  std::atomic<std::uint64_t> wait{ 0 };
+};
+
+// Counters of freed dynamic mutexes and the list of live ones, indexed by type.
+std::mutex registry_mutex;
+totals retired[2];
+std::vector<mutex*> live;
+
+void lock(mutex& m) {
+  std::uint32_t expected = 0;
+  if (m.state.compare_exchange_strong(expected, 1, std::memory_order_acquire)) {
+    if (options.statistics) {
+      m.acquires.fetch_add(1, std::memory_order_relaxed);
+    }
+    return;
+  }
+
+  // The acquisition is contended from the first failed attempt on, whether it then spins or
+  // parks.
+  std::chrono::steady_clock::time_point start;
+  if (options.statistics) {
+    start = std::chrono::steady_clock::now();
+  }
+  auto acquired = [&]() {
+    if (options.statistics) {
+      m.acquires.fetch_add(1, std::memory_order_relaxed);
+      m.contended.fetch_add(1, std::memory_order_relaxed);
+      auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+      m.wait.fetch_add(static_cast<std::uint64_t>(elapsed.count()), std::memory_order_relaxed);
+    }
+  };
+
+  for (int i = 0; i < options.spin; i++) {
+    expected = 0;
+    if (m.state.load(std::memory_order_relaxed) == 0 && m.state.compare_exchange_weak(expected, 1, std::memory_order_acquire)) {
+      acquired();
+      return;
+    }
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#endif
+  }
+
+  auto value = m.state.exchange(2, std::memory_order_acquire);
+  while (value != 0) {
+    park(m.state, 2);
+    value = m.state.exchange(2, std::memory_order_acquire);
+  }
+  acquired();
+}
+
+void unlock(mutex& m) {
+  if (m.state.exchange(0, std::memory_order_release) == 2) {
+    wake(m.state);
+  }
+}
+
+int initialize() {
+  return SQLITE_OK;
+}
+
+int end() {
+  return SQLITE_OK;
+}
+
+sqlite3_mutex* allocate(int type) {
+  if (type == SQLITE_MUTEX_FAST || type == SQLITE_MUTEX_RECURSIVE) {
+    auto allocation = std::malloc(sizeof(mutex) + cache_line);
+    if (!allocation) {
+      return nullptr;
+    }
+    auto address = (reinterpret_cast<std::uintptr_t>(allocation) + cache_line - 1) / cache_line * cache_line;
+    auto m = new (reinterpret_cast<void*>(address)) mutex();
+    m->type = type;
+    m->allocation = allocation;
+    std::lock_guard<std::mutex> guard(registry_mutex);
+    live.push_back(m);
+    return reinterpret_cast<sqlite3_mutex*>(m);
+  }
+  if (type < first_static || type >= first_static + static_count) {
+    return nullptr;
+  }
+  auto& m = statics[type - first_static];
+  m.type = type;
+  return reinterpret_cast<sqlite3_mutex*>(&m);
+}
+
+void deallocate(sqlite3_mutex* p) {
+  auto m = cast(p);
+  if (m->type != SQLITE_MUTEX_FAST && m->type != SQLITE_MUTEX_RECURSIVE) {
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> guard(registry_mutex);
+    auto& t = retired[m->type];
+    add(t.acquires, m->acquires);
+    add(t.contended, m->contended);
+    add(t.wait, m->wait);
+    for (auto i = live.begin(); i != live.end(); ++i) {
+      if (*i == m) {
+        live.erase(i);
+        break;
+      }
+    }
+  }
+  auto allocation = m->allocation;
+  m->~mutex();
+  std::free(allocation);
+}
+
+void enter(sqlite3_mutex* p) {
+  auto& m = *cast(p);
+  auto self = std::this_thread::get_id();
+  if (m.type == SQLITE_MUTEX_RECURSIVE && m.owner.load(std::memory_order_relaxed) == self) {
+    m.depth++;
+    return;
+  }
+  lock(m);
+  m.owner.store(self, std::memory_order_relaxed);
+  m.depth = 1;
+}
+
+int attempt(sqlite3_mutex* p) {
+  auto& m = *cast(p);
+  auto self = std::this_thread::get_id();
+  if (m.type == SQLITE_MUTEX_RECURSIVE && m.owner.load(std::memory_order_relaxed) == self) {
+    m.depth++;
+    return SQLITE_OK;
+  }
+  std::uint32_t expected = 0;
+  if (!m.state.compare_exchange_strong(expected, 1, std::memory_order_acquire)) {
+    return SQLITE_BUSY;
+  }
+  if (options.statistics) {
+    m.acquires.fetch_add(1, std::memory_order_relaxed);
+  }
+  m.owner.store(self, std::memory_order_relaxed);
+  m.depth = 1;
+  return SQLITE_OK;
+}
+
+void leave(sqlite3_mutex* p) {
+  auto& m = *cast(p);
+  if (--m.depth > 0) {
+    return;
+  }
+  m.owner.store(std::thread::id(), std::memory_order_relaxed);
+  unlock(m);
+}
+
+int held(sqlite3_mutex* p) {
+  return !p || cast(p)->owner.load(std::memory_order_relaxed) == std::this_thread::get_id();
+}
+
+int notheld(sqlite3_mutex* p) {
+  return !p || cast(p)->owner.load(std::memory_order_relaxed) != std::this_thread::get_id();
+}
+
+const sqlite3_mutex_methods methods = {
+  initialize,
+  end,
+  allocate,
+  deallocate,
+  enter,
+  attempt,
+  leave,
+  held,
+  notheld,
+};
+
+}  // namespace
+
+const sqlite3_mutex_methods* futex_mutex(const futex_mutex_options& mutex_options) {
+  options = mutex_options;
+  return &methods;
+}
+
+std::vector<mutex_statistics> futex_mutex_statistics() {
+  static const char* names[] = {
+    "main", "mem", "open", "prng", "lru", "pmem", "app1", "app2", "app3", "vfs1", "vfs2", "vfs3",
+  };
+
+  std::vector<mutex_statistics> statistics;
+  for (int i = 0; i < static_count; i++) {
+    mutex_statistics s;
+    s.name = i < static_cast<int>(sizeof(names) / sizeof(names[0])) ? names[i] : "static" + std::to_string(i + first_static);
+    s.acquires = statics[i].acquires;
+    s.contended = statics[i].contended;
+    s.wait = std::chrono::nanoseconds(statics[i].wait);
+    statistics.push_back(s);
+  }
+
+  std::lock_guard<std::mutex> guard(registry_mutex);
+  for (int type : { SQLITE_MUTEX_FAST, SQLITE_MUTEX_RECURSIVE }) {
+    mutex_statistics s;
+    s.name = type == SQLITE_MUTEX_FAST ? "fast" : "recursive";
+    s.acquires = retired[type].acquires;
+    s.contended = retired[type].contended;
+    auto wait = retired[type].wait.load();
+    for (auto m : live) {
+      if (m->type == type) {
+        s.acquires += m->acquires;
+        s.contended += m->contended;
+        wait += m->wait;
+      }
+    }
+    s.wait = std::chrono::nanoseconds(wait);
+    statistics.push_back(s);
+  }
+  return statistics;
+}
+
+}  // namespace sqlite
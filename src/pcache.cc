@@ -0,0 +1,560 @@
+#include <sqlite/pcache.h>
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#endif
+
+namespace sqlite {
+namespace {
+
+const std::size_t alignment = 16;
+const std::size_t min_slab = 64 * 1024;
+const std::size_t max_slab = 2 * 1024 * 1024;
+
+page_cache_options options;
+
+std::atomic<std::uint64_t> reserved{ 0 };
+
+// Page header followed by the page buffer and the extra bytes.
+struct entry {
+  sqlite3_pcache_page page;
+  entry* next;
+  unsigned key;
+  std::uint32_t position;
+  bool pinned;
+  bool referenced;
+};
+
+struct slab {
+  char* data;
+  std::size_t size;
+  bool mapped;
+};
+
+slab allocate_slab(std::size_t size) {
+#ifndef _WIN32
+  if (size == max_slab) {
+    void* data = MAP_FAILED;
+#ifdef MAP_HUGETLB
+    if (options.huge_pages) {
+      data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    }
+#endif
+    if (data == MAP_FAILED) {
+      data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+#ifdef MADV_HUGEPAGE
+      if (data != MAP_FAILED && options.huge_pages) {
+        madvise(data, size, MADV_HUGEPAGE);
+      }
+#endif
+    }
+    if (data != MAP_FAILED) {
+      return { static_cast<char*>(data), size, true };
+    }
+    return { nullptr, 0, false };
+  }
+#endif
+  return { static_cast<char*>(std::malloc(size)), size, false };
+}
+
+void free_slab(const slab& s) {
+#ifndef _WIN32
+  if (s.mapped) {
+    munmap(s.data, s.size);
+    return;
+  }
+#endif
+  std::free(s.data);
+}
+
+// Slabs and free pages shared by all caches with the same page and extra size, so that a page
+// that one cache evicts for another can be reused by it.
+class arena {
+private:
+  std::mutex mutex_;
+  std::vector<slab> slabs_;
+  std::size_t slab_used_ = 0;
+  entry* free_ = nullptr;
+  std::size_t live_ = 0;
+
+  // Reserves `size` bytes unless that exceeds the budget.
+  static bool reserve(std::size_t size, bool limited) {
+    auto total = reserved.fetch_add(size) + size;
+    if (limited && total > options.budget) {
+      reserved -= size;
+      return false;
+    }
+    return true;
+  }
+
+public:
+  const int page_size;
+  const int extra_size;
+  const std::size_t entry_size;
+
+  arena(int page_size, int extra_size, std::size_t entry_size)
+    : page_size(page_size), extra_size(extra_size), entry_size(entry_size) {
+  }
+
+  // Returns a free page, or one from a new slab. With `limited`, returns null instead of
+  // growing the slabs beyond the budget.
+  entry* allocate(bool limited) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (free_) {
+      auto e = free_;
+      free_ = e->next;
+      live_++;
+      return e;
+    }
+    if (slabs_.empty() || slab_used_ + entry_size > slabs_.back().size) {
+      auto size = slabs_.empty() ? min_slab : std::min(slabs_.back().size * 2, max_slab);
+      size = std::max(size, entry_size);
+      if (limited && reserved + size > options.budget && size > entry_size) {
+        // The rest of the budget may still hold a smaller slab.
+        auto left = options.budget > reserved ? options.budget - reserved : 0;
+        size = std::max(left / entry_size * entry_size, entry_size);
+      }
+      if (!reserve(size, limited)) {
+        return nullptr;
+      }
+      auto s = allocate_slab(size);
+      if (!s.data) {
+        reserved -= size;
+        return nullptr;
+      }
+      slabs_.push_back(s);
+      slab_used_ = 0;
+    }
+    auto e = reinterpret_cast<entry*>(slabs_.back().data + slab_used_);
+    e->page.pBuf = reinterpret_cast<char*>(e) + (sizeof(entry) + alignment - 1) / alignment * alignment;
+    e->page.pExtra = static_cast<char*>(e->page.pBuf) + page_size;
+    slab_used_ += entry_size;
+    live_++;
+    return e;
+  }
+
+  void free(entry* e) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    e->next = free_;
+    free_ = e;
+    live_--;
+  }
+
+  // Returns the slabs to the system once no cache holds any of their pages.
+  void trim() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (live_ > 0) {
+      return;
+    }
+    for (const auto& s : slabs_) {
+      reserved -= s.size;
+      free_slab(s);
+    }
+    slabs_.clear();
+    slab_used_ = 0;
+    free_ = nullptr;
+  }
+};
+
+class cache;
+
+std::mutex registry_mutex;
+std::vector<cache*> registry;
+std::size_t registry_hand = 0;
+// Arenas live as long as the process, since caches of the same size come and go with
+// connections.
+std::vector<std::unique_ptr<arena>> arenas;
+
+// Counters of caches that have been destroyed.
+std::uint64_t retired_hits = 0;
+std::uint64_t retired_misses = 0;
+std::uint64_t retired_evictions = 0;
+
+arena& find_arena(int page_size, int extra_size, std::size_t entry_size) {
+  for (auto& a : arenas) {
+    if (a->page_size == page_size && a->extra_size == extra_size) {
+      return *a;
+    }
+  }
+  arenas.emplace_back(new arena(page_size, extra_size, entry_size));
+  return *arenas.back();
+}
+
+class cache {
+private:
+  std::mutex mutex_;
+  std::size_t page_size_;
+  std::size_t extra_size_;
+  std::size_t entry_size_;
+  bool purgeable_;
+  std::size_t max_pages_ = 100;
+  arena* arena_;
+
+  std::vector<entry*> buckets_;
+  std::vector<entry*> ring_;
+  std::size_t hand_ = 0;
+  std::size_t pinned_ = 0;
+
+  // Counted under `mutex_` and summed when statistics are read, so that fetches do not
+  // contend on shared counters.
+  std::uint64_t hits_ = 0;
+  std::uint64_t misses_ = 0;
+  std::uint64_t evictions_ = 0;
+
+  std::size_t bucket(unsigned key) const {
+    return (key * 2654435761u) & (buckets_.size() - 1);
+  }
+
+  entry* find(unsigned key) const {
+    for (auto e = buckets_[bucket(key)]; e; e = e->next) {
+      if (e->key == key) {
+        return e;
+      }
+    }
+    return nullptr;
+  }
+
+  void link(entry* e) {
+    if (ring_.size() >= buckets_.size()) {
+      std::vector<entry*> buckets(buckets_.size() * 2);
+      buckets_.swap(buckets);
+      for (auto head : buckets) {
+        while (head) {
+          auto next = head->next;
+          auto& b = buckets_[bucket(head->key)];
+          head->next = b;
+          b = head;
+          head = next;
+        }
+      }
+    }
+    auto& b = buckets_[bucket(e->key)];
+    e->next = b;
+    b = e;
+    e->position = static_cast<std::uint32_t>(ring_.size());
+    ring_.push_back(e);
+  }
+
+  void unlink(entry* e) {
+    for (auto p = &buckets_[bucket(e->key)]; *p; p = &(*p)->next) {
+      if (*p == e) {
+        *p = e->next;
+        break;
+      }
+    }
+    auto last = ring_.back();
+    ring_[e->position] = last;
+    last->position = e->position;
+    ring_.pop_back();
+    if (hand_ >= ring_.size()) {
+      hand_ = 0;
+    }
+    if (e->pinned) {
+      pinned_--;
+    }
+  }
+
+  void release(entry* e) {
+    unlink(e);
+    arena_->free(e);
+  }
+
+  // Advances the clock hand to the next unpinned page that was not referenced since the hand
+  // passed it last and removes it from the cache.
+  entry* evict() {
+    if (ring_.size() == pinned_) {
+      return nullptr;
+    }
+    for (std::size_t i = 0; i < 2 * ring_.size(); i++) {
+      auto e = ring_[hand_];
+      hand_ = hand_ + 1 < ring_.size() ? hand_ + 1 : 0;
+      if (e->pinned) {
+        continue;
+      }
+      if (e->referenced) {
+        e->referenced = false;
+        continue;
+      }
+      unlink(e);
+      evictions_++;
+      return e;
+    }
+    return nullptr;
+  }
+
+  // Evicts one page of another cache of the same arena, which makes it free for this one.
+  static bool evict_other(cache* self) {
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    for (std::size_t i = 0; i < registry.size(); i++) {
+      auto other = registry[registry_hand++ % registry.size()];
+      if (other == self || other->arena_ != self->arena_ || !other->purgeable_) {
+        continue;
+      }
+      std::unique_lock<std::mutex> other_lock(other->mutex_, std::try_to_lock);
+      if (!other_lock.owns_lock()) {
+        continue;
+      }
+      if (auto e = other->evict()) {
+        other->arena_->free(e);
+        return true;
+      }
+    }
+    return false;
+  }
+
+  void pin(entry* e) {
+    if (!e->pinned) {
+      e->pinned = true;
+      pinned_++;
+    }
+  }
+
+public:
+  cache(int page_size, int extra_size, bool purgeable)
+    : page_size_(page_size), extra_size_(extra_size), purgeable_(purgeable), buckets_(64) {
+    auto header = (sizeof(entry) + alignment - 1) / alignment * alignment;
+    entry_size_ = (header + page_size_ + extra_size_ + alignment - 1) / alignment * alignment;
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    arena_ = &find_arena(page_size, extra_size, entry_size_);
+    registry.push_back(this);
+  }
+
+  ~cache() {
+    {
+      std::lock_guard<std::mutex> lock(registry_mutex);
+      registry.erase(std::find(registry.begin(), registry.end(), this));
+      retired_hits += hits_;
+      retired_misses += misses_;
+      retired_evictions += evictions_;
+    }
+    for (auto e : ring_) {
+      arena_->free(e);
+    }
+    arena_->trim();
+  }
+
+  void resize(int max_pages) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    max_pages_ = static_cast<std::size_t>(std::max(max_pages, 0));
+  }
+
+  int count() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return static_cast<int>(ring_.size());
+  }
+
+  sqlite3_pcache_page* fetch(unsigned key, int create) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (auto e = find(key)) {
+      pin(e);
+      e->referenced = true;
+      hits_++;
+      return &e->page;
+    }
+    // A fetch with create flag 2 always retries a failed fetch with create flag 1.
+    if (create < 2) {
+      misses_++;
+    }
+    if (create == 0) {
+      return nullptr;
+    }
+
+    entry* e = nullptr;
+    auto limited = purgeable_ && options.budget > 0;
+    if (purgeable_ && !limited && ring_.size() >= max_pages_) {
+      e = evict();
+      if (!e && create == 1) {
+        return nullptr;
+      }
+    }
+    if (!e) {
+      // Within the budget, free and new pages come first, then pages of this cache and then
+      // pages of other caches.
+      e = arena_->allocate(limited);
+      if (!e && limited) {
+        e = evict();
+      }
+      if (!e && limited) {
+        lock.unlock();
+        auto evicted = evict_other(this);
+        lock.lock();
+        // The key may have been added while the lock was released.
+        if (auto existing = find(key)) {
+          pin(existing);
+          return &existing->page;
+        }
+        if (evicted) {
+          e = arena_->allocate(true);
+        }
+        if (!e && create == 1) {
+          return nullptr;
+        }
+      }
+      if (!e) {
+        e = arena_->allocate(false);
+        if (!e) {
+          return nullptr;
+        }
+      }
+    }
+
+    e->key = key;
+    e->pinned = true;
+    e->referenced = true;
+    std::memset(e->page.pExtra, 0, extra_size_);
+    link(e);
+    pinned_++;
+    return &e->page;
+  }
+
+  void unpin(sqlite3_pcache_page* page, bool discard) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto e = reinterpret_cast<entry*>(page);
+    if (discard || (purgeable_ && options.budget == 0 && ring_.size() > max_pages_)) {
+      release(e);
+      return;
+    }
+    if (e->pinned) {
+      e->pinned = false;
+      pinned_--;
+    }
+  }
+
+  void rekey(sqlite3_pcache_page* page, unsigned old_key, unsigned new_key) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (auto existing = find(new_key)) {
+      release(existing);
+    }
+    auto e = reinterpret_cast<entry*>(page);
+    for (auto p = &buckets_[bucket(old_key)]; *p; p = &(*p)->next) {
+      if (*p == e) {
+        *p = e->next;
+        break;
+      }
+    }
+    e->key = new_key;
+    auto& b = buckets_[bucket(new_key)];
+    e->next = b;
+    b = e;
+  }
+
+  void truncate(unsigned limit) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (std::size_t i = ring_.size(); i > 0; i--) {
+      if (i - 1 < ring_.size() && ring_[i - 1]->key >= limit) {
+        release(ring_[i - 1]);
+      }
+    }
+  }
+
+  // Evicts all unpinned pages and returns the slabs of the arena if no cache holds pages in
+  // them anymore.
+  void shrink() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      for (std::size_t i = ring_.size(); i > 0; i--) {
+        if (i - 1 < ring_.size() && !ring_[i - 1]->pinned) {
+          release(ring_[i - 1]);
+        }
+      }
+    }
+    arena_->trim();
+  }
+
+  void add(page_cache_statistics& statistics) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    statistics.hits += hits_;
+    statistics.misses += misses_;
+    statistics.evictions += evictions_;
+    statistics.pages += ring_.size();
+    statistics.bytes += ring_.size() * entry_size_;
+  }
+};
+
+int initialize(void*) {
+  return SQLITE_OK;
+}
+
+void shutdown(void*) {
+}
+
+sqlite3_pcache* create(int page_size, int extra_size, int purgeable) {
+  return reinterpret_cast<sqlite3_pcache*>(new cache(page_size, extra_size, purgeable != 0));
+}
+
+void cachesize(sqlite3_pcache* c, int max_pages) {
+  reinterpret_cast<cache*>(c)->resize(max_pages);
+}
+
+int pagecount(sqlite3_pcache* c) {
+  return reinterpret_cast<cache*>(c)->count();
+}
+
+sqlite3_pcache_page* fetch(sqlite3_pcache* c, unsigned key, int create) {
+  return reinterpret_cast<cache*>(c)->fetch(key, create);
+}
+
+void unpin(sqlite3_pcache* c, sqlite3_pcache_page* page, int discard) {
+  reinterpret_cast<cache*>(c)->unpin(page, discard != 0);
+}
+
+void rekey(sqlite3_pcache* c, sqlite3_pcache_page* page, unsigned old_key, unsigned new_key) {
+  reinterpret_cast<cache*>(c)->rekey(page, old_key, new_key);
+}
+
+void truncate(sqlite3_pcache* c, unsigned limit) {
+  reinterpret_cast<cache*>(c)->truncate(limit);
+}
+
+void destroy(sqlite3_pcache* c) {
+  delete reinterpret_cast<cache*>(c);
+}
+
+void shrink(sqlite3_pcache* c) {
+  reinterpret_cast<cache*>(c)->shrink();
+}
+
+const sqlite3_pcache_methods2 methods = {
+  1,
+  nullptr,
+  initialize,
+  shutdown,
+  create,
+  cachesize,
+  pagecount,
+  fetch,
+  unpin,
+  rekey,
+  truncate,
+  destroy,
+  shrink,
+};
+
+}  // namespace
+
+const sqlite3_pcache_methods2* clock_page_cache(const page_cache_options& page_options) {
+  options = page_options;
+  return &methods;
+}
+
+page_cache_statistics clock_page_cache_statistics() {
+  page_cache_statistics statistics;
+  std::lock_guard<std::mutex> lock(registry_mutex);
+  statistics.hits = retired_hits;
+  statistics.misses = retired_misses;
+  statistics.evictions = retired_evictions;
+  for (auto c : registry) {
+    c->add(statistics);
+  }
+  statistics.reserved = reserved;
+  return statistics;
+}
+
+}  // namespace sqlite
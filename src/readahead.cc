@@ -0,0 +1,384 @@
+#include <sqlite/readahead.h>
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "shim.h"
+
+namespace sqlite {
+namespace {
+
+sqlite3_vfs vfs;
+std::once_flag registered;
+readahead_vfs_options options;
+
+std::atomic<std::uint64_t> hits{ 0 };
+std::atomic<std::uint64_t> misses{ 0 };
+std::atomic<std::uint64_t> readaheads{ 0 };
+std::atomic<std::uint64_t> bytes_read_ahead{ 0 };
+std::atomic<std::uint64_t> evictions{ 0 };
+std::atomic<std::uint64_t> invalidations{ 0 };
+
+// Offsets of the file change counter in the database header, and of the first salt and
+// of the number of backfilled frames in the WAL index.
+const sqlite3_int64 change_counter_offset = 24;
+const std::size_t wal_salt_offset = 32;
+const std::size_t wal_backfill_offset = 96;
+const int wal_read_lock = 3;
+
+// State of a database file shared by all connections that open it. Entries are never
+// removed, so files keep plain pointers to them.
+struct shared_file {
+  std::uint64_t id = 0;
+
+  // Blocks that were cached in an older epoch are stale.
+  std::uint64_t epoch = 0;
+
+  // Incremented by every change of the file. A block read from the file is only cached if
+  // no change happened while it was read.
+  std::uint64_t generation = 0;
+
+  bool counter_known = false;
+  unsigned char counter[4] = {};
+
+  bool wal_known = false;
+  std::uint32_t wal_salt = 0;
+  std::uint32_t wal_backfill = 0;
+};
+
+struct block {
+  std::uint64_t key;
+  std::uint64_t epoch;
+
+  // Shorter than the block size for the last block of a file.
+  std::vector<char> data;
+};
+
+// The cache and the shared file states are protected by `mutex`.
+std::mutex mutex;
+std::map<std::string, std::unique_ptr<shared_file>> files;
+std::list<block> blocks;
+std::unordered_map<std::uint64_t, std::list<block>::iterator> index;
+std::size_t cached_bytes = 0;
+
+std::uint64_t key_of(const shared_file& s, std::uint64_t block_number) {
+  return (s.id << 40) | block_number;
+}
+
+void evict(std::unordered_map<std::uint64_t, std::list<block>::iterator>::iterator it) {
+  cached_bytes -= it->second->data.size();
+  blocks.erase(it->second);
+  index.erase(it);
+}
+
+void drop(shared_file& s) {
+  ++s.epoch;
+  ++s.generation;
+}
+
+// Copies the range from cached blocks. Returns false when a part of it is not cached.
+bool lookup(shared_file& s, void* buffer, int amount, sqlite3_int64 offset) {
+  auto out = static_cast<char*>(buffer);
+  auto position = static_cast<std::uint64_t>(offset);
+  auto end = position + static_cast<std::uint64_t>(amount);
+  while (position < end) {
+    auto block_number = position / options.block_size;
+    auto it = index.find(key_of(s, block_number));
+    if (it == index.end()) {
+      return false;
+    }
+    if (it->second->epoch != s.epoch) {
+      evict(it);
+      return false;
+    }
+    auto& data = it->second->data;
+    auto from = position - block_number * options.block_size;
+    auto length = std::min<std::uint64_t>(end - position, options.block_size - from);
+    if (from + length > data.size()) {
+      return false;
+    }
+    std::memcpy(out, data.data() + from, length);
+    blocks.splice(blocks.begin(), blocks, it->second);
+    out += length;
+    position += length;
+  }
+  return true;
+}
+
+void insert(shared_file& s, std::uint64_t block_number, const char* data, std::size_t size) {
+  auto key = key_of(s, block_number);
+  auto it = index.find(key);
+  if (it != index.end()) {
+    evict(it);
+  }
+  blocks.push_front(block{ key, s.epoch, std::vector<char>(data, data + size) });
+  index[key] = blocks.begin();
+  cached_bytes += size;
+  while (cached_bytes > options.cache_size && !blocks.empty()) {
+    evict(index.find(blocks.back().key));
+    ++evictions;
+  }
+}
+
+void erase(shared_file& s, sqlite3_int64 offset, int amount) {
+  if (amount <= 0) {
+    return;
+  }
+  auto first = static_cast<std::uint64_t>(offset) / options.block_size;
+  auto last = (static_cast<std::uint64_t>(offset) + static_cast<std::uint64_t>(amount) - 1) / options.block_size;
+  for (auto n = first; n <= last; n++) {
+    auto it = index.find(key_of(s, n));
+    if (it != index.end()) {
+      evict(it);
+    }
+  }
+}
+
+shared_file* find(const std::string& path) {
+  std::lock_guard<std::mutex> lock(mutex);
+  auto& s = files[path];
+  if (!s) {
+    s.reset(new shared_file());
+    s->id = files.size();
+  }
+  return s.get();
+}
+
+struct file : shim::file {
+  shared_file* shared = nullptr;
+  int level = SQLITE_LOCK_NONE;
+  void volatile* wal_index = nullptr;
+
+  // Stream detection of this connection.
+  sqlite3_int64 last_offset = -1;
+  sqlite3_int64 last_end = 0;
+  int forward_reads = 0;
+  std::size_t window = 0;
+
+  // Records a read and returns whether readahead applies to it. Cache hits do not break
+  // a stream, since leaf pages of a scan are only loosely ordered.
+  bool advance(sqlite3_int64 offset, int amount, bool hit) {
+    auto gap = static_cast<sqlite3_int64>(std::max(options.block_size, window));
+    if (last_offset >= 0 && offset >= last_offset && offset <= last_end + gap) {
+      ++forward_reads;
+    } else if (!hit) {
+      forward_reads = 0;
+      window = 0;
+    }
+    last_offset = offset;
+    last_end = offset + amount;
+    if (window == 0 && forward_reads >= options.sequential_reads) {
+      window = std::min(2 * options.block_size, options.max_window);
+    }
+    return window > 0;
+  }
+};
+
+file* self(sqlite3_file* f) {
+  return reinterpret_cast<file*>(f);
+}
+
+int read(sqlite3_file* f, void* buffer, int amount, sqlite3_int64 offset) {
+  auto s = self(f);
+  auto& shared = *s->shared;
+  std::uint64_t epoch, generation;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (lookup(shared, buffer, amount, offset)) {
+      ++hits;
+      s->advance(offset, amount, true);
+      return SQLITE_OK;
+    }
+    epoch = shared.epoch;
+    generation = shared.generation;
+  }
+  ++misses;
+  if (!s->advance(offset, amount, false)) {
+    return shim::read(f, buffer, amount, offset);
+  }
+
+  sqlite3_int64 size;
+  if (shim::file_size(f, &size) != SQLITE_OK || offset + amount > size) {
+    return shim::read(f, buffer, amount, offset);
+  }
+  auto block_size = static_cast<sqlite3_int64>(options.block_size);
+  auto start = offset / block_size * block_size;
+  auto end = std::min(size, std::max(start + static_cast<sqlite3_int64>(s->window), offset + amount));
+  std::vector<char> data(static_cast<std::size_t>(end - start));
+  if (shim::read(f, data.data(), static_cast<int>(data.size()), start) != SQLITE_OK) {
+    return shim::read(f, buffer, amount, offset);
+  }
+  std::memcpy(buffer, data.data() + (offset - start), static_cast<std::size_t>(amount));
+  ++readaheads;
+  bytes_read_ahead += data.size();
+  s->window = std::min(2 * s->window, options.max_window);
+
+  std::lock_guard<std::mutex> lock(mutex);
+  if (shared.generation == generation && shared.epoch == epoch) {
+    for (auto position = start; position < end; position += block_size) {
+      auto length = std::min(block_size, end - position);
+      insert(shared, static_cast<std::uint64_t>(position / block_size), data.data() + (position - start), static_cast<std::size_t>(length));
+    }
+  }
+  return SQLITE_OK;
+}
+
+int write(sqlite3_file* f, const void* buffer, int amount, sqlite3_int64 offset) {
+  auto hresult = shim::write(f, buffer, amount, offset);
+  auto& shared = *self(f)->shared;
+  std::lock_guard<std::mutex> lock(mutex);
+  erase(shared, offset, amount);
+  ++shared.generation;
+  // Keeps the change counter current so that the own commits do not drop the cache.
+  if (hresult == SQLITE_OK && offset <= change_counter_offset && offset + amount >= change_counter_offset + 4) {
+    std::memcpy(shared.counter, static_cast<const char*>(buffer) + (change_counter_offset - offset), 4);
+    shared.counter_known = true;
+  }
+  return hresult;
+}
+
+int truncate(sqlite3_file* f, sqlite3_int64 size) {
+  auto hresult = shim::truncate(f, size);
+  std::lock_guard<std::mutex> lock(mutex);
+  drop(*self(f)->shared);
+  return hresult;
+}
+
+// Drops the cached blocks of the file when another connection changed its change counter.
+void validate(file* s) {
+  unsigned char counter[4] = {};
+  auto hresult = shim::read(&s->base, counter, 4, change_counter_offset);
+  if (hresult != SQLITE_OK && hresult != SQLITE_IOERR_SHORT_READ) {
+    return;
+  }
+  auto& shared = *s->shared;
+  std::lock_guard<std::mutex> lock(mutex);
+  if (shared.counter_known && std::memcmp(shared.counter, counter, 4) != 0) {
+    drop(shared);
+    ++invalidations;
+  }
+  std::memcpy(shared.counter, counter, 4);
+  shared.counter_known = true;
+}
+
+int lock(sqlite3_file* f, int level) {
+  auto s = self(f);
+  auto hresult = shim::lock(f, level);
+  if (hresult == SQLITE_OK) {
+    if (s->level == SQLITE_LOCK_NONE && level >= SQLITE_LOCK_SHARED) {
+      validate(s);
+    }
+    s->level = level;
+  }
+  return hresult;
+}
+
+int unlock(sqlite3_file* f, int level) {
+  auto hresult = shim::unlock(f, level);
+  if (hresult == SQLITE_OK) {
+    self(f)->level = level;
+  }
+  return hresult;
+}
+
+int shm_map(sqlite3_file* f, int region, int size, int extend, void volatile** address) {
+  auto hresult = shim::shm_map(f, region, size, extend, address);
+  if (hresult == SQLITE_OK && region == 0) {
+    self(f)->wal_index = *address;
+  }
+  return hresult;
+}
+
+// Checkpoints of other connections write to the database file. They are detected by the
+// number of backfilled frames and the salt of the WAL when a read transaction starts.
+int shm_lock(sqlite3_file* f, int offset, int count, int flags) {
+  auto hresult = shim::shm_lock(f, offset, count, flags);
+  auto s = self(f);
+  if (hresult == SQLITE_OK && s->wal_index && offset >= wal_read_lock && flags == (SQLITE_SHM_LOCK | SQLITE_SHM_SHARED)) {
+    auto header = static_cast<const volatile char*>(s->wal_index);
+    auto salt = *reinterpret_cast<const volatile std::uint32_t*>(header + wal_salt_offset);
+    auto backfill = *reinterpret_cast<const volatile std::uint32_t*>(header + wal_backfill_offset);
+    auto& shared = *s->shared;
+    std::lock_guard<std::mutex> lock(mutex);
+    if (shared.wal_known && (shared.wal_salt != salt || shared.wal_backfill != backfill)) {
+      drop(shared);
+      ++invalidations;
+    }
+    shared.wal_salt = salt;
+    shared.wal_backfill = backfill;
+    shared.wal_known = true;
+  }
+  return hresult;
+}
+
+int shm_unmap(sqlite3_file* f, int remove) {
+  self(f)->wal_index = nullptr;
+  return shim::shm_unmap(f, remove);
+}
+
+const sqlite3_io_methods readahead_methods = {
+  3,
+  shim::close<file>,
+  read,
+  write,
+  truncate,
+  shim::sync,
+  shim::file_size,
+  lock,
+  unlock,
+  shim::check_reserved_lock,
+  shim::file_control,
+  shim::sector_size,
+  shim::device_characteristics,
+  shm_map,
+  shm_lock,
+  shim::shm_barrier,
+  shm_unmap,
+  shim::fetch,
+  shim::unfetch,
+};
+
+int open(sqlite3_vfs* v, const char* name, sqlite3_file* f, int flags, int* out_flags) {
+  int hresult;
+  auto self = shim::open<file>(v, name, f, flags, out_flags, hresult);
+  if (!self) {
+    return hresult;
+  }
+  f->pMethods = shim::passthrough<file>();
+  if (name && (flags & SQLITE_OPEN_MAIN_DB)) {
+    self->shared = find(name);
+    f->pMethods = &readahead_methods;
+  }
+  return SQLITE_OK;
+}
+
+}  // namespace
+
+sqlite3_vfs* readahead_vfs(const readahead_vfs_options& o) {
+  std::call_once(registered, [&o]() {
+    options = o;
+    options.block_size = std::max<std::size_t>(options.block_size, 512);
+    options.max_window = std::max(options.max_window, options.block_size);
+    shim::install<file>(vfs, sqlite3_vfs_find(nullptr), "readahead", open, options.make_default);
+  });
+  return &vfs;
+}
+
+readahead_statistics readahead_vfs_statistics() {
+  readahead_statistics s;
+  s.hits = hits;
+  s.misses = misses;
+  s.readaheads = readaheads;
+  s.bytes_read_ahead = bytes_read_ahead;
+  s.evictions = evictions;
+  s.invalidations = invalidations;
+  return s;
+}
+
+}  // namespace sqlite
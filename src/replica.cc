@@ -0,0 +1,125 @@
+#include <sqlite/replica.h>
+
+namespace sqlite {
+
+database database::open_in_memory_copy(const std::string& path) {
+  sqlite3* source = nullptr;
+  if (sqlite3_open_v2(path.data(), &source, SQLITE_OPEN_READONLY, nullptr) != SQLITE_OK) {
+    sqlite_exception e(sqlite3_errmsg(source));
+    sqlite3_close_v2(source);
+    throw e;
+  }
+
+  database db(":memory:");
+  if (!db) {
+    sqlite3_close_v2(source);
+    throw sqlite_exception(sqlite3_errmsg(db.handle()));
+  }
+
+  // A single step copies all pages under one read lock, which is the fastest way to load
+  // the file and yields a consistent snapshot.
+  auto backup = sqlite3_backup_init(db.handle(), "main", source, "main");
+  if (!backup) {
+    sqlite_exception e(sqlite3_errmsg(db.handle()));
+    sqlite3_close_v2(source);
+    throw e;
+  }
+  auto hresult = sqlite3_backup_step(backup, -1);
+  sqlite3_backup_finish(backup);
+  sqlite3_close_v2(source);
+  if (hresult != SQLITE_DONE) {
+    throw sqlite_exception(sqlite3_errstr(hresult));
+  }
+  return db;
+}
+
+replica::replica(const std::string& path, replica_options options) : path_(path), options_(options) {
+  if (sqlite3_open_v2(path_.data(), &source_, SQLITE_OPEN_READONLY, nullptr) != SQLITE_OK) {
+    sqlite_exception e(sqlite3_errmsg(source_));
+    sqlite3_close_v2(source_);
+    throw e;
+  }
+  try {
+    version_ = data_version();
+    current_ = std::make_shared<database>(database::open_in_memory_copy(path_));
+  }
+  catch (...) {
+    sqlite3_close_v2(source_);
+    throw;
+  }
+  generation_ = 1;
+  if (options_.refresh.count() > 0) {
+    thread_ = std::thread(&replica::run, this);
+  }
+}
+
+replica::~replica() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  condition_.notify_one();
+  if (thread_.joinable()) {
+    thread_.join();
+  }
+  sqlite3_close_v2(source_);
+}
+
+// The data version of a connection changes whenever another connection commits to the file.
+// Returns -1 when the pragma is not supported, which makes every refresh reload the file.
+sqlite3_int64 replica::data_version() {
+  sqlite3_stmt* stmt = nullptr;
+  sqlite3_int64 version = -1;
+  if (sqlite3_prepare_v2(source_, "pragma data_version;", -1, &stmt, nullptr) != SQLITE_OK) {
+    throw sqlite_exception(sqlite3_errmsg(source_));
+  }
+  auto hresult = sqlite3_step(stmt);
+  if (hresult == SQLITE_ROW) {
+    version = sqlite3_column_int64(stmt, 0);
+  } else if (hresult != SQLITE_DONE) {
+    sqlite_exception e(sqlite3_errmsg(source_));
+    sqlite3_finalize(stmt);
+    throw e;
+  }
+  sqlite3_finalize(stmt);
+  return version;
+}
+
+void replica::run() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (!condition_.wait_for(lock, options_.refresh, [this]() { return stopping_; })) {
+    lock.unlock();
+    try {
+      refresh();
+    }
+    catch (const sqlite_exception&) {
+      // The current generation keeps being served until a refresh succeeds.
+    }
+    lock.lock();
+  }
+}
+
+std::shared_ptr<database> replica::get() const {
+  return std::atomic_load(&current_);
+}
+
+bool replica::refresh() {
+  std::lock_guard<std::mutex> refresh_lock(refresh_mutex_);
+  auto version = data_version();
+  if (version >= 0 && version == version_) {
+    return false;
+  }
+  auto next = std::make_shared<database>(database::open_in_memory_copy(path_));
+  std::atomic_store(&current_, next);
+  version_ = version;
+  std::lock_guard<std::mutex> lock(mutex_);
+  generation_++;
+  return true;
+}
+
+std::uint64_t replica::generation() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return generation_;
+}
+
+}  // namespace sqlite
@@ -0,0 +1,143 @@
+#include <sqlite/scheduler.h>
+#include <algorithm>
+
+namespace sqlite {
+
+scheduler::scheduler(const std::string& db_name, scheduler_options options) : options_(options) {
+  for (auto& running : running_) {
+    running = 0;
+  }
+  for (auto& waiting : waiting_) {
+    waiting = 0;
+  }
+  for (auto& limit : options_.limits) {
+    limit = std::max<std::size_t>(limit, 1);
+  }
+  for (std::size_t i = 0; i < std::max<std::size_t>(options_.connections, 1); i++) {
+    std::unique_ptr<slot> s(new slot());
+    s->owner = this;
+    s->db.reset(new database(db_name));
+    if (!*s->db) {
+      throw sqlite_exception(sqlite3_errmsg(s->db->handle()));
+    }
+    if (options_.preempt) {
+      sqlite3_progress_handler(s->db->handle(), options_.yield_interval, &scheduler::progress, s.get());
+    }
+    slots_.push_back(std::move(s));
+  }
+}
+
+scheduler::~scheduler() {
+  for (auto& s : slots_) {
+    sqlite3_progress_handler(s->db->handle(), 0, nullptr, nullptr);
+  }
+}
+
+int scheduler::progress(void* data) {
+  auto& s = *static_cast<slot*>(data);
+  auto& self = *s.owner;
+
+  // Lower priority work gives way as soon as higher priority work waits for a connection,
+  // unless that work only waits for its own class limit. Returning non-zero interrupts the
+  // statement, which releases its locks and, when the error ends `run`, the connection.
+  for (std::size_t i = 0; i < s.rank; i++) {
+    if (self.waiting_[i].load(std::memory_order_relaxed) > 0 &&
+        self.running_[i].load(std::memory_order_relaxed) < self.options_.limits[i]) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+bool scheduler::eligible(const waiter& w) const {
+  if (running_[index(w.level)] >= options_.limits[index(w.level)]) {
+    return false;
+  }
+  return std::any_of(slots_.begin(), slots_.end(), [](const std::unique_ptr<slot>& s) {
+    return !s->busy;
+  });
+}
+
+std::size_t scheduler::effective(const waiter& w, std::chrono::steady_clock::time_point now) const {
+  auto level = index(w.level);
+  if (options_.aging.count() > 0) {
+    auto steps = static_cast<std::size_t>((now - w.since) / options_.aging);
+    level -= std::min(level, steps);
+  }
+  return level;
+}
+
+bool scheduler::next(const waiter& w) const {
+  if (!eligible(w)) {
+    return false;
+  }
+  auto now = std::chrono::steady_clock::now();
+  auto level = effective(w, now);
+  for (const auto& other : waiters_) {
+    if (other.ticket == w.ticket || !eligible(other)) {
+      continue;
+    }
+    auto other_level = effective(other, now);
+    if (other_level < level || (other_level == level && other.ticket < w.ticket)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+scheduler::slot& scheduler::acquire(priority level) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  waiter w{ level, std::chrono::steady_clock::now(), next_ticket_++ };
+  waiters_.push_back(w);
+  waiting_[index(level)]++;
+  // Waits time out once per aging interval, since effective priorities change with time
+  // alone and not only when a connection is released.
+  while (!next(w)) {
+    if (options_.aging.count() > 0) {
+      released_.wait_for(lock, options_.aging);
+    } else {
+      released_.wait(lock);
+    }
+  }
+  auto rank = effective(w, std::chrono::steady_clock::now());
+  waiting_[index(level)]--;
+  waiters_.erase(std::find_if(waiters_.begin(), waiters_.end(), [&w](const waiter& other) {
+    return other.ticket == w.ticket;
+  }));
+
+  auto& s = **std::find_if(slots_.begin(), slots_.end(), [](const std::unique_ptr<slot>& s) {
+    return !s->busy;
+  });
+  s.busy = true;
+  // Limits count the request in its own class, and preemption in the class it aged into, so
+  // that long waits are not lost to the next higher request.
+  s.current = level;
+  s.rank = rank;
+  running_[index(level)]++;
+
+  // Another connection may still be free for the next waiter in line.
+  released_.notify_all();
+  return s;
+}
+
+void scheduler::release(slot& s) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    s.busy = false;
+    running_[index(s.current)]--;
+  }
+  released_.notify_all();
+}
+
+std::size_t scheduler::waiting(priority level) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return std::count_if(waiters_.begin(), waiters_.end(), [level](const waiter& w) {
+    return w.level == level;
+  });
+}
+
+std::size_t scheduler::running(priority level) const {
+  return running_[index(level)];
+}
+
+}  // namespace sqlite
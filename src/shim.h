@@ -0,0 +1,260 @@
+#pragma once
+#include <sqlite/sqlite.h>
+#include <new>
+
+// Building blocks for VFS shims that wrap the default VFS. A shim file starts with
+// `shim::file`, and the file of the wrapped VFS follows the shim's own structure in the same
+// allocation.
+namespace sqlite {
+namespace shim {
+
+struct file {
+  sqlite3_file base;
+  sqlite3_file* real;
+};
+
+inline std::size_t real_offset(std::size_t size) {
+  return (size + 15) & ~std::size_t(15);
+}
+
+inline sqlite3_file* real(sqlite3_file* f) {
+  return reinterpret_cast<file*>(f)->real;
+}
+
+inline const sqlite3_io_methods* methods(sqlite3_file* f) {
+  return real(f)->pMethods;
+}
+
+inline sqlite3_vfs* wrapped(sqlite3_vfs* vfs) {
+  return static_cast<sqlite3_vfs*>(vfs->pAppData);
+}
+
+// Constructs a `File` in `f` and opens the wrapped file behind it. Returns null and leaves
+// `f` closed when the wrapped VFS fails to open the file.
+template<typename File>
+File* open(sqlite3_vfs* vfs, const char* name, sqlite3_file* f, int flags, int* out_flags, int& hresult) {
+  auto self = new (f) File();
+  self->real = reinterpret_cast<sqlite3_file*>(reinterpret_cast<char*>(f) + real_offset(sizeof(File)));
+  auto base = wrapped(vfs);
+  hresult = base->xOpen(base, name, self->real, flags, out_flags);
+  if (hresult != SQLITE_OK) {
+    self->~File();
+    f->pMethods = nullptr;
+    return nullptr;
+  }
+  return self;
+}
+
+template<typename File>
+int close(sqlite3_file* f) {
+  auto self = reinterpret_cast<File*>(f);
+  auto hresult = methods(f)->xClose(self->real);
+  self->~File();
+  return hresult;
+}
+
+inline int read(sqlite3_file* f, void* buffer, int amount, sqlite3_int64 offset) {
+  return methods(f)->xRead(real(f), buffer, amount, offset);
+}
+
+inline int write(sqlite3_file* f, const void* buffer, int amount, sqlite3_int64 offset) {
+  return methods(f)->xWrite(real(f), buffer, amount, offset);
+}
+
+inline int truncate(sqlite3_file* f, sqlite3_int64 size) {
+  return methods(f)->xTruncate(real(f), size);
+}
+
+inline int sync(sqlite3_file* f, int flags) {
+  return methods(f)->xSync(real(f), flags);
+}
+
+inline int file_size(sqlite3_file* f, sqlite3_int64* size) {
+  return methods(f)->xFileSize(real(f), size);
+}
+
+inline int lock(sqlite3_file* f, int level) {
+  return methods(f)->xLock(real(f), level);
+}
+
+inline int unlock(sqlite3_file* f, int level) {
+  return methods(f)->xUnlock(real(f), level);
+}
+
+inline int check_reserved_lock(sqlite3_file* f, int* result) {
+  return methods(f)->xCheckReservedLock(real(f), result);
+}
+
+inline int file_control(sqlite3_file* f, int op, void* argument) {
+  return methods(f)->xFileControl(real(f), op, argument);
+}
+
+inline int sector_size(sqlite3_file* f) {
+  return methods(f)->xSectorSize(real(f));
+}
+
+inline int device_characteristics(sqlite3_file* f) {
+  return methods(f)->xDeviceCharacteristics(real(f));
+}
+
+inline int shm_map(sqlite3_file* f, int region, int size, int extend, void volatile** address) {
+  if (methods(f)->iVersion < 2) {
+    return SQLITE_IOERR;
+  }
+  return methods(f)->xShmMap(real(f), region, size, extend, address);
+}
+
+inline int shm_lock(sqlite3_file* f, int offset, int count, int flags) {
+  if (methods(f)->iVersion < 2) {
+    return SQLITE_IOERR;
+  }
+  return methods(f)->xShmLock(real(f), offset, count, flags);
+}
+
+inline void shm_barrier(sqlite3_file* f) {
+  if (methods(f)->iVersion >= 2) {
+    methods(f)->xShmBarrier(real(f));
+  }
+}
+
+inline int shm_unmap(sqlite3_file* f, int remove) {
+  if (methods(f)->iVersion < 2) {
+    return SQLITE_OK;
+  }
+  return methods(f)->xShmUnmap(real(f), remove);
+}
+
+inline int fetch(sqlite3_file* f, sqlite3_int64 offset, int amount, void** address) {
+  if (methods(f)->iVersion < 3) {
+    *address = nullptr;
+    return SQLITE_OK;
+  }
+  return methods(f)->xFetch(real(f), offset, amount, address);
+}
+
+inline int unfetch(sqlite3_file* f, sqlite3_int64 offset, void* address) {
+  if (methods(f)->iVersion < 3) {
+    return SQLITE_OK;
+  }
+  return methods(f)->xUnfetch(real(f), offset, address);
+}
+
+// Declines memory-mapped access so that all reads go through `xRead`.
+inline int no_fetch(sqlite3_file*, sqlite3_int64, int, void** address) {
+  *address = nullptr;
+  return SQLITE_OK;
+}
+
+inline int no_unfetch(sqlite3_file*, sqlite3_int64, void*) {
+  return SQLITE_OK;
+}
+
+// Methods that pass every call on to the wrapped file.
+template<typename File>
+const sqlite3_io_methods* passthrough() {
+  static const sqlite3_io_methods methods = {
+    3,
+    close<File>,
+    read,
+    write,
+    truncate,
+    sync,
+    file_size,
+    lock,
+    unlock,
+    check_reserved_lock,
+    file_control,
+    sector_size,
+    device_characteristics,
+    shm_map,
+    shm_lock,
+    shm_barrier,
+    shm_unmap,
+    fetch,
+    unfetch,
+  };
+  return &methods;
+}
+
+inline int remove(sqlite3_vfs* vfs, const char* name, int sync) {
+  return wrapped(vfs)->xDelete(wrapped(vfs), name, sync);
+}
+
+inline int access(sqlite3_vfs* vfs, const char* name, int flags, int* result) {
+  return wrapped(vfs)->xAccess(wrapped(vfs), name, flags, result);
+}
+
+inline int full_pathname(sqlite3_vfs* vfs, const char* name, int size, char* out) {
+  return wrapped(vfs)->xFullPathname(wrapped(vfs), name, size, out);
+}
+
+inline void* dl_open(sqlite3_vfs* vfs, const char* name) {
+  return wrapped(vfs)->xDlOpen(wrapped(vfs), name);
+}
+
+inline void dl_error(sqlite3_vfs* vfs, int size, char* message) {
+  wrapped(vfs)->xDlError(wrapped(vfs), size, message);
+}
+
+inline void (*dl_sym(sqlite3_vfs* vfs, void* handle, const char* symbol))(void) {
+  return wrapped(vfs)->xDlSym(wrapped(vfs), handle, symbol);
+}
+
+inline void dl_close(sqlite3_vfs* vfs, void* handle) {
+  wrapped(vfs)->xDlClose(wrapped(vfs), handle);
+}
+
+inline int randomness(sqlite3_vfs* vfs, int size, char* out) {
+  return wrapped(vfs)->xRandomness(wrapped(vfs), size, out);
+}
+
+inline int sleep(sqlite3_vfs* vfs, int microseconds) {
+  return wrapped(vfs)->xSleep(wrapped(vfs), microseconds);
+}
+
+inline int current_time(sqlite3_vfs* vfs, double* now) {
+  return wrapped(vfs)->xCurrentTime(wrapped(vfs), now);
+}
+
+inline int last_error(sqlite3_vfs* vfs, int size, char* message) {
+  return wrapped(vfs)->xGetLastError(wrapped(vfs), size, message);
+}
+
+inline int current_time_int64(sqlite3_vfs* vfs, sqlite3_int64* now) {
+  return wrapped(vfs)->xCurrentTimeInt64(wrapped(vfs), now);
+}
+
+// Fills `vfs` with a shim named `name` around `base` whose files are `File` structures opened
+// by `open`, and registers it.
+template<typename File>
+void install(sqlite3_vfs& vfs, sqlite3_vfs* base, const char* name, int (*open)(sqlite3_vfs*, const char*, sqlite3_file*, int, int*), bool make_default) {
+  if (!base) {
+    throw sqlite_exception("no default VFS");
+  }
+  vfs = sqlite3_vfs();
+  vfs.iVersion = base->iVersion >= 2 ? 2 : 1;
+  vfs.szOsFile = static_cast<int>(real_offset(sizeof(File))) + base->szOsFile;
+  vfs.mxPathname = base->mxPathname;
+  vfs.zName = name;
+  vfs.pAppData = base;
+  vfs.xOpen = open;
+  vfs.xDelete = remove;
+  vfs.xAccess = access;
+  vfs.xFullPathname = full_pathname;
+  vfs.xDlOpen = dl_open;
+  vfs.xDlError = dl_error;
+  vfs.xDlSym = dl_sym;
+  vfs.xDlClose = dl_close;
+  vfs.xRandomness = randomness;
+  vfs.xSleep = sleep;
+  vfs.xCurrentTime = current_time;
+  vfs.xGetLastError = last_error;
+  vfs.xCurrentTimeInt64 = current_time_int64;
+  auto hresult = sqlite3_vfs_register(&vfs, make_default ? 1 : 0);
+  if (hresult != SQLITE_OK) {
+    throw sqlite_exception(sqlite3_errstr(hresult));
+  }
+}
+
+}  // namespace shim
+}  // namespace sqlite
@@ -1,4 +1,50 @@
 #include <sqlite/sqlite.h>
+#include <algorithm>
 
 // TODO: Optional implementation that does not rely on `sqlite3.h` being
 // included in `sqlite.h`.
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace sqlite {
+
+void database::mmap_advise(mmap_advice advice) const {
+#ifndef _WIN32
+  auto size = mmap_size();
+  if (size <= 0) {
+    return;
+  }
+
+  // The mapping is only created once the file has been read.
+  *this << "select count(*) from sqlite_master;";
+
+  sqlite3_mutex_enter(sqlite3_db_mutex(db_));
+  sqlite3_file* file = nullptr;
+  if (sqlite3_file_control(db_, "main", SQLITE_FCNTL_FILE_POINTER, &file) == SQLITE_OK && file && file->pMethods &&
+      file->pMethods->iVersion >= 3 && file->pMethods->xFetch) {
+    sqlite3_int64 file_size = 0;
+    void* data = nullptr;
+    file->pMethods->xFileSize(file, &file_size);
+    if (file_size > 0 && file->pMethods->xFetch(file, 0, 1, &data) == SQLITE_OK && data) {
+      // The unix VFS maps the file with a single mapping that starts at offset zero.
+      int flag = MADV_NORMAL;
+      switch (advice) {
+      case mmap_advice::normal: flag = MADV_NORMAL; break;
+      case mmap_advice::sequential: flag = MADV_SEQUENTIAL; break;
+      case mmap_advice::random: flag = MADV_RANDOM; break;
+      case mmap_advice::willneed: flag = MADV_WILLNEED; break;
+      }
+      auto page = static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+      auto length = static_cast<std::size_t>(std::min(file_size, size));
+      madvise(data, (length + page - 1) / page * page, flag);
+      file->pMethods->xUnfetch(file, 0, data);
+    }
+  }
+  sqlite3_mutex_leave(sqlite3_db_mutex(db_));
+#endif
+}
+
+}  // namespace sqlite
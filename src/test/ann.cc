@@ -0,0 +1,126 @@
+#include <sqlite/ann.h>
+#include <sqlite/vector.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "check.h"
+
+namespace {
+
+const int dimensions = 8;
+
+// Deterministic pseudo-random components, so that distances have no ties.
+std::vector<float> embedding(std::uint32_t seed) {
+  std::vector<float> values;
+  for (int i = 0; i < dimensions; i++) {
+    seed = seed * 1664525u + 1013904223u;
+    values.push_back(static_cast<float>(seed >> 8) / static_cast<float>(1 << 24));
+  }
+  return values;
+}
+
+std::vector<sqlite3_int64> nearest(const sqlite::database& db, const std::string& sql, const std::vector<float>& target) {
+  std::vector<sqlite3_int64> rowids;
+  db << sql << target >> [&](sqlite3_int64 rowid) {
+    rowids.push_back(rowid);
+  };
+  return rowids;
+}
+
+// With every list probed, the index must return exactly the neighbours of a full scan.
+void check_exact(const sqlite::database& db) {
+  for (std::uint32_t query = 0; query < 20; query++) {
+    auto target = embedding(100000 + query);
+    auto indexed = nearest(db, "select rowid from items_ann where embedding match ? and k = 10 and probes = 1000;", target);
+    auto scanned = nearest(db, "select rowid from items where embedding is not null order by vec_l2(embedding, ?) limit 10;", target);
+    CHECK(indexed.size() == 10);
+    CHECK(indexed == scanned);
+  }
+}
+
+int execute(const sqlite::database& db, const std::string& sql) {
+  return sqlite3_exec(db.handle(), sql.data(), nullptr, nullptr, nullptr);
+}
+
+TEST_CASE(ann_matches_full_scan) {
+  test::temporary_file file("ann");
+  sqlite::database db(file.path());
+  sqlite::define_vector_functions(db);
+  sqlite::define_ann(db);
+  db << "create table items (id integer primary key, embedding blob);";
+  {
+    sqlite::transaction t(db);
+    for (int i = 1; i <= 500; i++) {
+      db << "insert into items values (?, ?);" << i << embedding(static_cast<std::uint32_t>(i));
+    }
+    db << "insert into items values (501, null);";
+    t.commit();
+  }
+  sqlite::ann_options options{ dimensions };
+  options.lists = 16;
+  sqlite::create_ann_index(db, "items_ann", "items", "embedding", options);
+  check_exact(db);
+
+  // The triggers keep the index in sync with inserts, updates and deletes of the base table.
+  {
+    sqlite::transaction t(db);
+    for (int i = 502; i <= 600; i++) {
+      db << "insert into items values (?, ?);" << i << embedding(static_cast<std::uint32_t>(i) * 7);
+    }
+    for (int i = 1; i <= 500; i += 3) {
+      db << "update items set embedding = ? where id = ?;" << embedding(static_cast<std::uint32_t>(i) * 13) << i;
+    }
+    db << "update items set embedding = ? where id = 501;" << embedding(501);
+    db << "update items set embedding = null where id = 2;";
+    db << "delete from items where id % 5 = 0;";
+    t.commit();
+  }
+  check_exact(db);
+
+  int indexed = 0;
+  db << "select count(*) from items_ann_vectors;" >> indexed;
+  int rows = 0;
+  db << "select count(*) from items where embedding is not null;" >> rows;
+  CHECK(indexed == rows);
+
+  // Other connections load the index from its shadow tables.
+  sqlite::database other(file.path());
+  sqlite::define_vector_functions(other);
+  sqlite::define_ann(other);
+  check_exact(other);
+}
+
+TEST_CASE(ann_rejects_other_sizes) {
+  sqlite::database db(":memory:");
+  sqlite::define_ann(db);
+  db << "create table items (id integer primary key, embedding blob);";
+  db << "insert into items values (1, ?);" << embedding(1);
+  sqlite::ann_options options{ dimensions };
+  sqlite::create_ann_index(db, "items_ann", "items", "embedding", options);
+  CHECK(execute(db, "insert into items values (2, zeroblob(12));") != SQLITE_OK);
+  CHECK(execute(db, "update items set embedding = zeroblob(36) where id = 1;") != SQLITE_OK);
+  CHECK(execute(db, "insert into items values (3, zeroblob(32));") == SQLITE_OK);
+
+  db << "create table wrong (id integer primary key, embedding blob);";
+  db << "insert into wrong values (1, zeroblob(12));";
+  CHECK_THROWS(sqlite::create_ann_index(db, "wrong_ann", "wrong", "embedding", options));
+}
+
+// A configuration whose source or column is NULL is reported as corrupt when the index is
+// loaded, instead of being read.
+TEST_CASE(ann_corrupt_configuration) {
+  test::temporary_file file("ann_corrupt");
+  {
+    sqlite::database db(file.path());
+    sqlite::define_ann(db);
+    db << "create table items (id integer primary key, embedding blob);";
+    db << "insert into items values (1, ?);" << embedding(1);
+    sqlite::create_ann_index(db, "items_ann", "items", "embedding", sqlite::ann_options{ dimensions });
+    db << "update items_ann_config set column = null;";
+  }
+  sqlite::database db(file.path());
+  sqlite::define_ann(db);
+  CHECK(execute(db, "select * from items_ann;") == SQLITE_CORRUPT);
+}
+
+}  // namespace
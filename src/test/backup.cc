@@ -0,0 +1,104 @@
+#include <sqlite/backup.h>
+#include <chrono>
+#include <thread>
+#include <utility>
+#include "check.h"
+
+namespace {
+
+const int rows = 600;
+
+void fill(const sqlite::database& db) {
+  db << "create table t (i integer primary key, x text);";
+  sqlite::transaction t(db);
+  for (int i = 0; i < rows; i++) {
+    db << "insert into t (x) values (printf('%.900d', ?));" << i;
+  }
+  t.commit();
+}
+
+int count(const std::string& path) {
+  sqlite::database db(path);
+  int value = 0;
+  db << "select count(*) from t;" >> value;
+  return value;
+}
+
+// Waits until the backup has copied its first step.
+void started(const sqlite::backup& b) {
+  while (b.progress().total == 0) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+}
+
+void write(const std::string& path) {
+  sqlite::database writer(path);
+  writer << "pragma busy_timeout=5000;" >> [](int) {};
+  sqlite::transaction t(writer);
+  writer << "insert into t (x) values ('written');";
+  t.commit();
+}
+
+TEST_CASE(backup_copies_database) {
+  test::temporary_file source("backup_source");
+  test::temporary_file destination("backup_destination");
+  sqlite::database db(source.path());
+  fill(db);
+  sqlite::backup_options options;
+  options.pages_per_step = 16;
+  auto b = db.backup_to(destination.path(), options);
+  b.wait();
+  CHECK(b.progress().done);
+  CHECK(b.progress().remaining == 0);
+  CHECK(b.progress().restarts == 0);
+  CHECK(count(destination.path()) == rows);
+}
+
+TEST_CASE(backup_move_assignment) {
+  test::temporary_file source("backup_move_source");
+  test::temporary_file slow("backup_move_slow");
+  test::temporary_file fast("backup_move_fast");
+  sqlite::database db(source.path());
+  fill(db);
+  sqlite::backup_options throttled;
+  throttled.pages_per_step = 1;
+  throttled.max_rate = 0.1;
+  auto b = db.backup_to(slow.path(), throttled);
+  started(b);
+  // Cancels and joins the running backup instead of dropping it.
+  b = db.backup_to(fast.path(), sqlite::backup_options());
+  b.wait();
+  CHECK(count(fast.path()) == rows);
+
+  sqlite::backup moved(std::move(b));
+  CHECK_THROWS(b.wait());
+  CHECK(!b.progress().done);
+  moved.wait();
+}
+
+TEST_CASE(backup_gives_up_on_restarts) {
+  test::temporary_file source("backup_restart_source");
+  test::temporary_file destination("backup_restart_destination");
+  sqlite::database db(source.path());
+  fill(db);
+  sqlite::backup_options options;
+  options.pages_per_step = 8;
+  options.max_rate = 1;
+  options.max_restarts = 1;
+  auto b = db.backup_to(destination.path(), options);
+  started(b);
+  write(source.path());
+  CHECK_THROWS(b.wait());
+  CHECK(b.progress().restarts == 1);
+  CHECK(!b.progress().done);
+
+  options.lock_to_finish = true;
+  b = db.backup_to(destination.path(), options);
+  started(b);
+  write(source.path());
+  b.wait();
+  CHECK(b.progress().restarts == 1);
+  CHECK(count(destination.path()) == rows + 2);
+}
+
+}  // namespace
@@ -0,0 +1,102 @@
+#include <sqlite/sqlite.h>
+#include <chrono>
+#include <thread>
+#include "check.h"
+
+namespace {
+
+// Rows of `t` that another connection sees, i.e. that are committed.
+int committed(const std::string& path) {
+  sqlite::database other(path);
+  int rows = 0;
+  other << "select count(*) from t;" >> rows;
+  return rows;
+}
+
+bool autocommit(const sqlite::database& db) {
+  return sqlite3_get_autocommit(db.handle()) != 0;
+}
+
+TEST_CASE(batch_limit) {
+  test::temporary_file file("batch_limit");
+  sqlite::database db(file.path());
+  db << "create table t (x integer primary key);";
+  db.batch(3, std::chrono::hours(1));
+  for (int i = 0; i < 3; i++) {
+    db << "insert into t values (?);" << i;
+  }
+  CHECK(!autocommit(db));
+  CHECK(committed(file.path()) == 0);
+  // The fourth write commits the first three and starts the next batch.
+  db << "insert into t values (3);";
+  CHECK(committed(file.path()) == 3);
+  db.flush();
+  CHECK(autocommit(db));
+  CHECK(committed(file.path()) == 4);
+}
+
+TEST_CASE(batch_interval) {
+  test::temporary_file file("batch_interval");
+  sqlite::database db(file.path());
+  db << "create table t (x integer primary key);";
+  db.batch(1000, std::chrono::milliseconds(20));
+  db << "insert into t values (1);";
+  db << "insert into t values (2);";
+  CHECK(committed(file.path()) == 0);
+  std::this_thread::sleep_for(std::chrono::milliseconds(40));
+  db << "insert into t values (3);";
+  CHECK(committed(file.path()) == 2);
+  db.batch(0);
+  CHECK(committed(file.path()) == 3);
+}
+
+TEST_CASE(batch_flushed_by_read) {
+  test::temporary_file file("batch_read");
+  sqlite::database db(file.path());
+  db << "create table t (x integer primary key);";
+  db.batch(1000, std::chrono::hours(1));
+  db << "insert into t values (1);";
+  db << "insert into t values (2);";
+  CHECK(!autocommit(db));
+  int rows = 0;
+  db << "select count(*) from t;" >> rows;
+  CHECK(rows == 2);
+  CHECK(autocommit(db));
+  CHECK(committed(file.path()) == 2);
+}
+
+TEST_CASE(batch_reports_lost_batch) {
+  test::temporary_file file("batch_lost");
+  sqlite::database db(file.path());
+  db << "create table t (x integer primary key);";
+  db.batch(1000, std::chrono::hours(1));
+  db << "insert into t values (1);";
+  // The conflict rolls back the batch's transaction.
+  db << "insert or rollback into t values (1);";
+  CHECK(autocommit(db));
+  db << "insert into t values (2);";
+  CHECK_THROWS(db.flush());
+  db.flush();
+  CHECK(committed(file.path()) == 1);
+}
+
+TEST_CASE(batch_reports_failed_commit) {
+  test::temporary_file file("batch_commit");
+  sqlite::database db(file.path());
+  db << "pragma foreign_keys=on;" >> [](int) {};
+  db << "create table p (id integer primary key);";
+  db << "create table t (x integer references p (id) deferrable initially deferred);";
+  db.batch(1000, std::chrono::hours(1));
+  db << "insert into t values (1);";
+  // The deferred foreign key fails the implicit commit, and the batch stays open.
+  int rows = 0;
+  db << "select count(*) from t;" >> rows;
+  CHECK(!autocommit(db));
+  CHECK_THROWS(db.flush());
+  db << "insert into p values (1);";
+  db.flush();
+  CHECK(autocommit(db));
+  CHECK(committed(file.path()) == 1);
+}
+
+}  // namespace
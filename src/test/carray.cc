@@ -0,0 +1,112 @@
+#include <sqlite/carray.h>
+#include <string>
+#include <vector>
+#include "check.h"
+
+namespace {
+
+int statements(const sqlite::database& db) {
+  int count = 0;
+  for (auto stmt = sqlite3_next_stmt(db.handle(), nullptr); stmt; stmt = sqlite3_next_stmt(db.handle(), stmt)) {
+    count++;
+  }
+  return count;
+}
+
+void create(const std::string& path) {
+  sqlite::database db(path);
+  db << "create table t (id integer primary key, name text);";
+  db << "insert into t (id, name) with recursive ids(i) as (select 1 union all select i + 1 from ids where i < 100) "
+        "select i, 'n' || i from ids;";
+}
+
+TEST_CASE(carray_binding) {
+  test::temporary_file file("carray");
+  create(file.path());
+  sqlite::database db(file.path());
+  sqlite::define_carray(db);
+
+  std::vector<int> ints = { 1, 2, 3, 200 };
+  std::vector<sqlite3_int64> longs = { 5, 6 };
+  std::vector<double> reals = { 7, 8.5 };
+  std::vector<std::string> strings = { "n9", "n10", "x" };
+  std::vector<const char*> texts = { "n11", nullptr };
+  int rows = 0;
+  db << "select count(*) from t where id in carray(?);" << sqlite::carray(ints) >> rows;
+  CHECK(rows == 3);
+  db << "select count(*) from t where id in carray(?);" << sqlite::carray(longs) >> rows;
+  CHECK(rows == 2);
+  db << "select count(*) from t where id in carray(?);" << sqlite::carray(reals) >> rows;
+  CHECK(rows == 1);
+  db << "select count(*) from t where name in carray(?);" << sqlite::carray(strings) >> rows;
+  CHECK(rows == 2);
+  db << "select count(*) from t where name in carray(?);" << sqlite::carray(texts) >> rows;
+  CHECK(rows == 1);
+  db << "select count(*) from carray(?);" << sqlite::carray(ints.data(), 0) >> rows;
+  CHECK(rows == 0);
+  std::string joined;
+  db << "select group_concat(value, ',') from carray(?);" << sqlite::carray(strings) >> joined;
+  CHECK(joined == "n9,n10,x");
+
+  // Only a call with the handle can be planned.
+  CHECK_THROWS(db << "select count(*) from carray;" >> rows);
+}
+
+// One cached statement of an immutable database serves lists of every length.
+TEST_CASE(carray_statement_reuse) {
+  test::temporary_file file("carray_reuse");
+  create(file.path());
+  sqlite::database db(file.path(), sqlite::open_mode::immutable);
+  sqlite::define_carray(db);
+  for (std::size_t length = 0; length < 50; length += 7) {
+    std::vector<sqlite3_int64> ids;
+    for (std::size_t i = 0; i < length; i++) {
+      ids.push_back(static_cast<sqlite3_int64>(i * 2 + 1));
+    }
+    sqlite3_int64 sum = 0;
+    db << "select total(id) from t where id in carray(?);" << sqlite::carray(ids) >> sum;
+    CHECK(sum == static_cast<sqlite3_int64>(length * length));
+    CHECK(statements(db) == 1);
+  }
+}
+
+// Handles resolve while their statement runs, only on their connection, and not after the
+// statement was reset or finalized.
+TEST_CASE(carray_handle_lifetime) {
+  test::temporary_file file("carray_handles");
+  create(file.path());
+  for (auto mode : { sqlite::open_mode::read_write, sqlite::open_mode::immutable }) {
+    sqlite::database db(file.path(), mode);
+    sqlite::database other(file.path(), mode);
+    sqlite::define_carray(db);
+    sqlite::define_carray(other);
+    std::vector<sqlite3_int64> ids = { 1, 2, 3 };
+    sqlite3_int64 handle = 0;
+    int inside = 0;
+    bool foreign = false;
+    db << "select ?;" << sqlite::carray(ids) >> [&](sqlite3_int64 h) {
+      handle = h;
+      // Defining it again keeps the bound arrays.
+      sqlite::define_carray(db);
+      db << "select count(*) from carray(?);" << h >> inside;
+      try {
+        int rows = 0;
+        other << "select count(*) from carray(?);" << h >> rows;
+      }
+      catch (const sqlite::sqlite_exception&) {
+        foreign = true;
+      }
+    };
+    CHECK(inside == 3);
+    CHECK(foreign);
+    int rows = 0;
+    CHECK_THROWS(db << "select count(*) from carray(?);" << handle >> rows);
+  }
+
+  sqlite::database undefined(":memory:");
+  std::vector<int> ids = { 1 };
+  int rows = 0;
+  CHECK_THROWS(undefined << "select count(*) from carray(?);" << sqlite::carray(ids) >> rows);
+}
+
+}  // namespace
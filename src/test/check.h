@@ -0,0 +1,106 @@
+#pragma once
+#include <cstdio>
+#include <exception>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// A minimal test runner. The files in src/test register their cases with `TEST_CASE`, and
+// `main` runs them after the example. A failing `CHECK` throws and ends its case.
+namespace test {
+
+struct failure : public std::runtime_error {
+  failure(const std::string& message) : runtime_error(message) {
+  }
+};
+
+struct test_case {
+  const char* name;
+  void (*run)();
+};
+
+inline std::vector<test_case>& cases() {
+  static std::vector<test_case> cases;
+  return cases;
+}
+
+struct registration {
+  registration(const char* name, void (*run)()) {
+    cases().push_back(test_case{ name, run });
+  }
+};
+
+// Runs all cases and returns the number of cases that failed.
+inline int run() {
+  int failed = 0;
+  for (const auto& c : cases()) {
+    try {
+      c.run();
+      std::cout << "ok     " << c.name << std::endl;
+    }
+    catch (const std::exception& e) {
+      failed++;
+      std::cout << "FAILED " << c.name << ": " << e.what() << std::endl;
+    }
+  }
+  std::cout << cases().size() - failed << " of " << cases().size() << " cases passed" << std::endl;
+  return failed;
+}
+
+// A database file in the working directory that is removed, along with its journal and WAL,
+// when the case starts and ends.
+class temporary_file {
+private:
+  std::string path_;
+
+  void remove() const {
+    for (auto suffix : { "", "-journal", "-wal", "-shm" }) {
+      std::remove((path_ + suffix).data());
+    }
+  }
+
+public:
+  explicit temporary_file(const std::string& name) : path_("test_" + name + ".db") {
+    remove();
+  }
+
+  temporary_file(const temporary_file& other) = delete;
+  temporary_file& operator=(const temporary_file& other) = delete;
+
+  ~temporary_file() {
+    remove();
+  }
+
+  const std::string& path() const {
+    return path_;
+  }
+};
+
+}  // namespace test
+
+#define TEST_CASE(name) \
+  static void name(); \
+  static test::registration name##_registration(#name, &name); \
+  static void name()
+
+#define CHECK(condition) \
+  do { \
+    if (!(condition)) { \
+      throw test::failure(std::string(__FILE__) + ":" + std::to_string(__LINE__) + ": CHECK(" #condition ")"); \
+    } \
+  } while (false)
+
+#define CHECK_THROWS(statement) \
+  do { \
+    bool thrown = false; \
+    try { \
+      statement; \
+    } \
+    catch (const std::exception&) { \
+      thrown = true; \
+    } \
+    if (!thrown) { \
+      throw test::failure(std::string(__FILE__) + ":" + std::to_string(__LINE__) + ": CHECK_THROWS(" #statement ")"); \
+    } \
+  } while (false)
@@ -0,0 +1,126 @@
+#include <sqlite/checkpoint.h>
+#include <chrono>
+#include <fstream>
+#include <string>
+#include <thread>
+#include "check.h"
+
+namespace {
+
+sqlite::database open_wal(const std::string& path) {
+  sqlite::database db(path);
+  db << "pragma journal_mode=wal;" >> [](std::string) {};
+  db << "create table if not exists t (x blob);";
+  return db;
+}
+
+// Writes about `pages` pages of 4 KiB in one transaction.
+void write(const sqlite::database& db, int pages) {
+  sqlite::transaction t(db);
+  for (int i = 0; i < pages; i++) {
+    db << "insert into t values (randomblob(3800));";
+  }
+  t.commit();
+}
+
+sqlite::checkpoint_metrics wait_for(const sqlite::checkpointer& c, std::uint64_t checkpoints) {
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+  auto metrics = c.metrics();
+  while (metrics.checkpoints < checkpoints && std::chrono::steady_clock::now() < deadline) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    metrics = c.metrics();
+  }
+  return metrics;
+}
+
+std::streamoff size(const std::string& path) {
+  std::ifstream in(path, std::ios::binary | std::ios::ate);
+  return in ? static_cast<std::streamoff>(in.tellg()) : -1;
+}
+
+sqlite::checkpoint_options thresholds(int passive, int restart, int truncate) {
+  sqlite::checkpoint_options options;
+  options.passive_pages = passive;
+  options.restart_pages = restart;
+  options.truncate_pages = truncate;
+  return options;
+}
+
+TEST_CASE(checkpoint_passive) {
+  test::temporary_file file("checkpoint_passive");
+  auto db = open_wal(file.path());
+  sqlite::checkpointer c(db, thresholds(10, 1000, 1000));
+  write(db, 5);
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  CHECK(c.metrics().checkpoints == 0);
+  write(db, 10);
+  auto metrics = wait_for(c, 1);
+  CHECK(metrics.checkpoints == 1);
+  CHECK(metrics.restarts == 0);
+  CHECK(metrics.truncates == 0);
+  CHECK(metrics.busy == 0);
+  CHECK(metrics.checkpointed_pages >= 15);
+  CHECK(metrics.wal_pages == metrics.checkpointed_pages);
+}
+
+TEST_CASE(checkpoint_escalates) {
+  test::temporary_file file("checkpoint_escalates");
+  auto db = open_wal(file.path());
+  {
+    sqlite::checkpointer c(db, thresholds(10, 20, 1000));
+    write(db, 25);
+    auto metrics = wait_for(c, 1);
+    CHECK(metrics.restarts == 1);
+    CHECK(metrics.truncates == 0);
+  }
+  sqlite::checkpointer c(db, thresholds(10, 20, 40));
+  write(db, 45);
+  auto metrics = wait_for(c, 1);
+  CHECK(metrics.restarts == 0);
+  CHECK(metrics.truncates == 1);
+  CHECK(metrics.busy == 0);
+  CHECK(size(file.path() + "-wal") == 0);
+}
+
+// A reader's snapshot keeps a passive checkpoint from copying the frames written after it.
+TEST_CASE(checkpoint_busy) {
+  test::temporary_file file("checkpoint_busy");
+  auto db = open_wal(file.path());
+  write(db, 1);
+  sqlite::database reader(file.path());
+  sqlite::transaction snapshot(reader, sqlite::transaction_mode::deferred);
+  int rows = 0;
+  reader << "select count(*) from t;" >> rows;
+
+  sqlite::checkpointer c(db, thresholds(10, 1000, 1000));
+  write(db, 15);
+  auto metrics = wait_for(c, 1);
+  CHECK(metrics.busy == 1);
+  CHECK(metrics.checkpointed_pages < metrics.wal_pages);
+  snapshot.commit();
+
+  c.request();
+  metrics = wait_for(c, 2);
+  CHECK(metrics.busy == 1);
+  CHECK(metrics.checkpointed_pages == metrics.wal_pages);
+}
+
+TEST_CASE(checkpoint_restores_autocheckpoint) {
+  test::temporary_file file("checkpoint_restore");
+  auto db = open_wal(file.path());
+  sqlite::checkpoint_options options;
+  options.autocheckpoint = 123;
+  {
+    sqlite::checkpointer c(db, options);
+    c.request();
+    CHECK(wait_for(c, 1).checkpoints == 1);
+  }
+  int pages = 0;
+  db << "pragma wal_autocheckpoint;" >> pages;
+  CHECK(pages == 123);
+
+  sqlite::database memory(":memory:");
+  CHECK_THROWS(sqlite::checkpointer c(memory));
+}
+
+}  // namespace
@@ -0,0 +1,192 @@
+#include <sqlite/compress.h>
+#include <cstdint>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+#include "check.h"
+
+namespace {
+
+// Rows of about a quarter page each, so that the test databases have several map blocks of
+// 256 pages.
+const int rows = 4000;
+
+sqlite3_int64 checksum(const sqlite::database& db) {
+  sqlite3_int64 value = 0;
+  db << "select sum(cast(x as integer)) + count(*) from t;" >> value;
+  return value;
+}
+
+std::string integrity(const sqlite::database& db) {
+  std::string result;
+  db << "pragma integrity_check;" >> result;
+  return result;
+}
+
+sqlite::database open_compressed(const std::string& path) {
+  return sqlite::database(path, sqlite::open_mode::read_write, sqlite::compressed_vfs()->zName);
+}
+
+void insert(const sqlite::database& db, int begin, int end) {
+  sqlite::transaction t(db);
+  for (int i = begin; i < end; i++) {
+    db << "insert into t (x) values (printf('%.1000d', ?));" << i;
+  }
+  t.commit();
+}
+
+std::vector<char> read(const std::string& path) {
+  std::ifstream in(path, std::ios::binary);
+  return std::vector<char>(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+void write(const std::string& path, const std::vector<char>& data) {
+  std::ofstream out(path, std::ios::binary | std::ios::trunc);
+  out.write(data.data(), static_cast<std::streamsize>(data.size()));
+}
+
+std::uint64_t generation(const std::vector<char>& file, std::size_t slot) {
+  std::uint64_t value = 0;
+  for (int i = 0; i < 8; i++) {
+    value |= static_cast<std::uint64_t>(static_cast<unsigned char>(file[slot * 512 + 8 + i])) << (8 * i);
+  }
+  return value;
+}
+
+TEST_CASE(compress_round_trip) {
+  test::temporary_file file("compress");
+  sqlite3_int64 expected = 0;
+  {
+    auto db = open_compressed(file.path());
+    db << "create table t (i integer primary key, x text);";
+    // One transaction per chunk writes a new superblock each time.
+    for (int i = 0; i < rows; i += 250) {
+      insert(db, i, i + 250);
+    }
+    expected = checksum(db);
+    CHECK(integrity(db) == "ok");
+  }
+  auto stored = read(file.path());
+  CHECK(stored.size() < static_cast<std::size_t>(rows) * 1000 / 2);
+  CHECK(generation(stored, 0) > 2 || generation(stored, 1) > 2);
+  {
+    auto db = open_compressed(file.path());
+    CHECK(checksum(db) == expected);
+    db << "pragma cache_size=10;";
+    db << "update t set x = printf('%.1000d', i * 2) where i % 3 = 0;";
+    db << "delete from t where i % 7 = 0;";
+    expected = checksum(db);
+    db << "vacuum;";
+    CHECK(checksum(db) == expected);
+  }
+  auto db = open_compressed(file.path());
+  CHECK(checksum(db) == expected);
+  CHECK(integrity(db) == "ok");
+
+  auto statistics = sqlite::compressed_vfs_statistics();
+  CHECK(statistics.pages_written > 0);
+  CHECK(statistics.ratio() > 1);
+}
+
+// A torn write of the newest superblock leaves the previous one, which still describes the
+// database as of the previous commit.
+TEST_CASE(compress_torn_superblock) {
+  test::temporary_file file("compress_torn");
+  test::temporary_file copy("compress_torn_copy");
+  sqlite3_int64 before = 0;
+  {
+    auto db = open_compressed(file.path());
+    db << "create table t (i integer primary key, x text);";
+    insert(db, 0, rows);
+    before = checksum(db);
+  }
+  {
+    auto db = open_compressed(file.path());
+    insert(db, rows, rows + 100);
+  }
+  auto stored = read(file.path());
+  auto newest = generation(stored, 1) > generation(stored, 0) ? 1 : 0;
+  stored[newest * 512 + 60] ^= 1;
+  write(copy.path(), stored);
+
+  auto db = open_compressed(copy.path());
+  CHECK(checksum(db) == before);
+  CHECK(integrity(db) == "ok");
+}
+
+// A copy taken in the middle of a transaction that spilled pages to the file is what a crash
+// leaves. The hot journal rolls it back.
+TEST_CASE(compress_crash_recovery) {
+  test::temporary_file file("compress_crash");
+  test::temporary_file copy("compress_crash_copy");
+  sqlite3_int64 before = 0;
+  auto db = open_compressed(file.path());
+  db << "create table t (i integer primary key, x text);";
+  insert(db, 0, rows);
+  before = checksum(db);
+
+  db << "pragma cache_size=10;";
+  {
+    sqlite::transaction t(db);
+    db << "update t set x = printf('%.1000d', cast(x as integer) + 1);";
+    write(copy.path(), read(file.path()));
+    write(copy.path() + "-journal", read(file.path() + "-journal"));
+    t.commit();
+  }
+  CHECK(checksum(db) == before + rows);
+
+  auto recovered = open_compressed(copy.path());
+  CHECK(checksum(recovered) == before);
+  CHECK(integrity(recovered) == "ok");
+}
+
+// Readers in WAL mode keep the map of their snapshot while checkpoints of other connections
+// reuse the extents of older maps.
+TEST_CASE(compress_wal_readers) {
+  test::temporary_file file("compress_wal");
+  auto a = open_compressed(file.path());
+  a << "pragma journal_mode=wal;" >> [](std::string) {};
+  a << "pragma wal_autocheckpoint=0;" >> [](int) {};
+  a << "create table t (i integer primary key, v integer, pad blob);";
+  {
+    sqlite::transaction t(a);
+    for (int i = 0; i < 20000; i++) {
+      a << "insert into t values (?, ?, randomblob(200));" << i << i;
+    }
+    t.commit();
+  }
+  a << "pragma wal_checkpoint(truncate);" >> [](int, int, int) {};
+  auto r = open_compressed(file.path());
+  auto b = open_compressed(file.path());
+  b << "pragma cache_size=5;";
+  auto update = [&](int round, int step) {
+    sqlite::transaction t(a);
+    for (int i = 0; i < 60; i++) {
+      a << "update t set v = v + 1, pad = randomblob(200) where i = ?;" << (i * step + round * 101) % 20000;
+    }
+    t.commit();
+  };
+  for (int round = 0; round < 5; round++) {
+    update(round, 331);
+    sqlite::transaction tr(r, sqlite::transaction_mode::deferred);
+    sqlite3_int64 value = 0;
+    r << "select v from t where i = 1;" >> value;
+    update(round, 337);
+    sqlite::transaction tb(b, sqlite::transaction_mode::deferred);
+    b << "select v from t where i = 0;" >> value;
+    a << "pragma wal_checkpoint(passive);" >> [](int, int, int) {};
+    tr.commit();
+    a << "pragma wal_checkpoint(passive);" >> [](int, int, int) {};
+    sqlite3_int64 snapshot = 0;
+    b << "select sum(v) from t;" >> snapshot;
+    tb.commit();
+    sqlite3_int64 current = 0;
+    b << "select sum(v) from t;" >> current;
+    CHECK(snapshot == current);
+    a << "pragma wal_checkpoint(truncate);" >> [](int, int, int) {};
+  }
+  CHECK(integrity(b) == "ok");
+}
+
+}  // namespace
@@ -0,0 +1,66 @@
+#include <sqlite/config.h>
+#include "check.h"
+
+namespace {
+
+sqlite3_int64 mmap_size(const sqlite::database& db) {
+  sqlite3_int64 size = 0;
+  db << "pragma mmap_size;" >> size;
+  return size;
+}
+
+// Shuts the library down so that `initialize` can configure it again. Only valid while no
+// connection is open.
+void shutdown() {
+  CHECK(sqlite3_shutdown() == SQLITE_OK);
+}
+
+TEST_CASE(config_refused_after_open) {
+  sqlite::database db(":memory:");
+  sqlite::config options;
+  options.memstatus = 0;
+  CHECK_THROWS(sqlite::initialize(options));
+  // Also without settings that call sqlite3_config.
+  CHECK_THROWS(sqlite::initialize(sqlite::config()));
+  int one = 0;
+  db << "select 1;" >> one;
+  CHECK(one == 1);
+}
+
+// The settings are process-wide, so the test restores the compile-time defaults before the
+// other tests open their databases.
+TEST_CASE(config_mmap) {
+  test::temporary_file file("config_mmap");
+  sqlite3_int64 default_size = 0;
+  {
+    sqlite::database db(file.path());
+    default_size = mmap_size(db);
+  }
+
+  shutdown();
+  sqlite::config options;
+  options.mmap_size = 1 << 20;
+  options.mmap_limit = 1 << 21;
+  sqlite::initialize(options);
+  {
+    sqlite::database db(file.path());
+    CHECK(mmap_size(db) == 1 << 20);
+    db << "pragma mmap_size=1073741824;" >> [](sqlite3_int64) {};
+    CHECK(mmap_size(db) == 1 << 21);
+  }
+
+  // Only a maximum keeps the compile-time default size.
+  shutdown();
+  options.mmap_size = -1;
+  sqlite::initialize(options);
+  {
+    sqlite::database db(file.path());
+    CHECK(mmap_size(db) == default_size);
+  }
+
+  shutdown();
+  CHECK(sqlite3_config(SQLITE_CONFIG_MMAP_SIZE, static_cast<sqlite3_int64>(-1), static_cast<sqlite3_int64>(-1)) == SQLITE_OK);
+  CHECK(sqlite3_initialize() == SQLITE_OK);
+}
+
+}  // namespace
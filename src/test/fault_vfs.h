@@ -0,0 +1,251 @@
+#pragma once
+#include <sqlite/sqlite.h>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include "../shim.h"
+
+// A VFS for tests and benchmarks that injects delays, sync stalls, short reads and I/O errors
+// into the calls of chosen files and operations. Random decisions are drawn from a generator
+// with a fixed seed, so a single-threaded run injects the same faults every time.
+namespace sqlite {
+namespace test {
+
+enum fault_operation : unsigned {
+  fault_open = 1,
+  fault_read = 2,
+  fault_write = 4,
+  fault_sync = 8,
+  fault_truncate = 16,
+  fault_lock = 32,
+  fault_all = 63,
+};
+
+struct fault_rule {
+  // Files the rule applies to: a combination of `SQLITE_OPEN_MAIN_DB`, `SQLITE_OPEN_WAL`,
+  // `SQLITE_OPEN_MAIN_JOURNAL` and the other file type flags, and a substring of the path.
+  // Zero and an empty string match all files.
+  int files = 0;
+  std::string path;
+
+  unsigned operations = fault_all;
+
+  // Chance that a matching call is affected, after the first `after` matching calls, and the
+  // maximum number of affected calls or zero for no limit.
+  double probability = 1;
+  std::uint64_t after = 0;
+  std::uint64_t times = 0;
+
+  // Sleeps for `delay` plus a uniformly distributed part of `jitter` before the call.
+  std::chrono::microseconds delay{ 0 };
+  std::chrono::microseconds jitter{ 0 };
+
+  // Fails the call with this result instead of passing it on, e.g. `SQLITE_IOERR_WRITE`.
+  int error = SQLITE_OK;
+
+  // Reads only the first half of the requested bytes and reports a short read.
+  bool short_read = false;
+};
+
+struct fault_statistics {
+  std::uint64_t delays = 0;
+  std::chrono::microseconds delayed{ 0 };
+  std::uint64_t errors = 0;
+  std::uint64_t short_reads = 0;
+};
+
+namespace detail {
+
+struct fault_state {
+  std::mutex mutex;
+  std::vector<fault_rule> rules;
+
+  // Matching and affected calls of each rule.
+  std::vector<std::pair<std::uint64_t, std::uint64_t>> counts;
+  std::mt19937_64 random;
+  fault_statistics statistics;
+
+  sqlite3_vfs vfs;
+  std::once_flag registered;
+};
+
+inline fault_state& state() {
+  static fault_state s;
+  return s;
+}
+
+struct fault_file : shim::file {
+  int flags = 0;
+  std::string path;
+};
+
+struct fault {
+  std::chrono::microseconds delay{ 0 };
+  int error = SQLITE_OK;
+  bool short_read = false;
+};
+
+// Decides which faults apply to a call and sleeps for the delays.
+inline fault inject(int flags, const std::string& path, fault_operation operation) {
+  fault f;
+  {
+    auto& s = state();
+    std::lock_guard<std::mutex> lock(s.mutex);
+    for (std::size_t i = 0; i < s.rules.size(); i++) {
+      auto& rule = s.rules[i];
+      auto& count = s.counts[i];
+      if (!(rule.operations & operation) || (rule.files && !(rule.files & flags)) || path.find(rule.path) == std::string::npos) {
+        continue;
+      }
+      if (++count.first <= rule.after || (rule.times && count.second >= rule.times)) {
+        continue;
+      }
+      if (rule.probability < 1 && std::uniform_real_distribution<double>(0, 1)(s.random) >= rule.probability) {
+        continue;
+      }
+      ++count.second;
+      f.delay += rule.delay;
+      if (rule.jitter.count() > 0) {
+        f.delay += std::chrono::microseconds(std::uniform_int_distribution<std::int64_t>(0, rule.jitter.count())(s.random));
+      }
+      if (f.error == SQLITE_OK) {
+        f.error = rule.error;
+      }
+      f.short_read = f.short_read || (rule.short_read && operation == fault_read);
+    }
+    if (f.delay.count() > 0) {
+      ++s.statistics.delays;
+      s.statistics.delayed += f.delay;
+    }
+    if (f.error != SQLITE_OK) {
+      ++s.statistics.errors;
+    } else if (f.short_read) {
+      ++s.statistics.short_reads;
+    }
+  }
+  if (f.delay.count() > 0) {
+    std::this_thread::sleep_for(f.delay);
+  }
+  return f;
+}
+
+inline fault inject(sqlite3_file* f, fault_operation operation) {
+  auto self = reinterpret_cast<fault_file*>(f);
+  return inject(self->flags, self->path, operation);
+}
+
+inline int read(sqlite3_file* f, void* buffer, int amount, sqlite3_int64 offset) {
+  auto injected = inject(f, test::fault_read);
+  if (injected.error != SQLITE_OK) {
+    return injected.error;
+  }
+  if (injected.short_read) {
+    auto half = amount / 2;
+    auto hresult = shim::read(f, buffer, half, offset);
+    if (hresult != SQLITE_OK && hresult != SQLITE_IOERR_SHORT_READ) {
+      return hresult;
+    }
+    std::memset(static_cast<char*>(buffer) + half, 0, static_cast<std::size_t>(amount - half));
+    return SQLITE_IOERR_SHORT_READ;
+  }
+  return shim::read(f, buffer, amount, offset);
+}
+
+inline int write(sqlite3_file* f, const void* buffer, int amount, sqlite3_int64 offset) {
+  auto injected = inject(f, test::fault_write);
+  return injected.error != SQLITE_OK ? injected.error : shim::write(f, buffer, amount, offset);
+}
+
+inline int sync(sqlite3_file* f, int flags) {
+  auto injected = inject(f, test::fault_sync);
+  return injected.error != SQLITE_OK ? injected.error : shim::sync(f, flags);
+}
+
+inline int truncate(sqlite3_file* f, sqlite3_int64 size) {
+  auto injected = inject(f, test::fault_truncate);
+  return injected.error != SQLITE_OK ? injected.error : shim::truncate(f, size);
+}
+
+inline int lock(sqlite3_file* f, int level) {
+  auto injected = inject(f, test::fault_lock);
+  return injected.error != SQLITE_OK ? injected.error : shim::lock(f, level);
+}
+
+inline const sqlite3_io_methods* fault_methods() {
+  static const sqlite3_io_methods methods = {
+    3,
+    shim::close<fault_file>,
+    read,
+    write,
+    truncate,
+    sync,
+    shim::file_size,
+    lock,
+    shim::unlock,
+    shim::check_reserved_lock,
+    shim::file_control,
+    shim::sector_size,
+    shim::device_characteristics,
+    shim::shm_map,
+    shim::shm_lock,
+    shim::shm_barrier,
+    shim::shm_unmap,
+    shim::fetch,
+    shim::unfetch,
+  };
+  return &methods;
+}
+
+inline int open(sqlite3_vfs* v, const char* name, sqlite3_file* f, int flags, int* out_flags) {
+  std::string path = name ? name : "";
+  auto injected = inject(flags, path, test::fault_open);
+  if (injected.error != SQLITE_OK) {
+    f->pMethods = nullptr;
+    return injected.error;
+  }
+  int hresult;
+  auto self = shim::open<fault_file>(v, name, f, flags, out_flags, hresult);
+  if (!self) {
+    return hresult;
+  }
+  self->flags = flags;
+  self->path = std::move(path);
+  f->pMethods = fault_methods();
+  return SQLITE_OK;
+}
+
+}  // namespace detail
+
+// Registers the "fault" VFS around the default VFS and returns it. It injects nothing until
+// rules are set.
+inline sqlite3_vfs* fault_vfs() {
+  auto& s = detail::state();
+  std::call_once(s.registered, [&s]() {
+    shim::install<detail::fault_file>(s.vfs, sqlite3_vfs_find(nullptr), "fault", detail::open, false);
+  });
+  return &s.vfs;
+}
+
+// Replaces the rules, resets their counters and the statistics, and reseeds the generator.
+inline void set_faults(const std::vector<fault_rule>& rules, std::uint64_t seed = 0) {
+  auto& s = detail::state();
+  std::lock_guard<std::mutex> lock(s.mutex);
+  s.rules = rules;
+  s.counts.assign(rules.size(), {});
+  s.random.seed(seed);
+  s.statistics = fault_statistics();
+}
+
+inline fault_statistics fault_vfs_statistics() {
+  auto& s = detail::state();
+  std::lock_guard<std::mutex> lock(s.mutex);
+  return s.statistics;
+}
+
+}  // namespace test
+}  // namespace sqlite
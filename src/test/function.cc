@@ -0,0 +1,83 @@
+#include <sqlite/sqlite.h>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "check.h"
+
+namespace {
+
+template<typename T>
+T query(const sqlite::database& db, const std::string& sql) {
+  T value{};
+  db << sql >> value;
+  return value;
+}
+
+TEST_CASE(function_integral_types) {
+  sqlite::database db(":memory:");
+  db.define("size", [](const std::string& text) -> std::size_t {
+    return text.size();
+  });
+  db.define("twice", [](long value) {
+    return value * 2;
+  });
+  db.define("narrow", [](unsigned short value) -> std::uint8_t {
+    return static_cast<std::uint8_t>(value);
+  });
+  db.define("wide", [](std::uint32_t value) -> std::uint64_t {
+    return static_cast<std::uint64_t>(value) << 8;
+  });
+  db.define("sign", [](signed char value) -> short {
+    return value < 0 ? -1 : 1;
+  });
+  db.define("maybe", [](std::int64_t value) {
+    return value ? std::unique_ptr<std::size_t>(new std::size_t(static_cast<std::size_t>(value))) : nullptr;
+  });
+
+  CHECK(query<sqlite3_int64>(db, "select size('four');") == 4);
+  CHECK(query<std::string>(db, "select typeof(size('four'));") == "integer");
+  CHECK(query<sqlite3_int64>(db, "select twice(21);") == 42);
+  CHECK(query<sqlite3_int64>(db, "select twice(4000000000);") == 8000000000);
+  CHECK(query<sqlite3_int64>(db, "select narrow(258);") == 2);
+  CHECK(query<sqlite3_int64>(db, "select wide(4294967295);") == 1099511627520);
+  CHECK(query<sqlite3_int64>(db, "select sign(-5);") == -1);
+  CHECK(query<sqlite3_int64>(db, "select maybe(7);") == 7);
+  CHECK(query<std::string>(db, "select typeof(maybe(0));") == "null");
+  CHECK(query<sqlite3_int64>(db, "select twice(null);") == 0);
+}
+
+TEST_CASE(function_other_types) {
+  sqlite::database db(":memory:");
+  db.define("both", [](bool a, bool b) {
+    return a && b;
+  });
+  db.define("half", [](float value) {
+    return value / 2;
+  });
+  db.define("joined", [](const char* a, std::string b) {
+    return std::string(a ? a : "") + b;
+  });
+  db.define("sum_i32", [](std::vector<std::int32_t> values) {
+    sqlite3_int64 sum = 0;
+    for (auto value : values) {
+      sum += value;
+    }
+    return sum;
+  });
+  db.define("fail", [](int) -> int {
+    throw std::runtime_error("failed");
+  });
+
+  CHECK(query<int>(db, "select both(1, 2);") == 1);
+  CHECK(query<int>(db, "select both(1, 0);") == 0);
+  CHECK(query<double>(db, "select half(3);") == 1.5);
+  CHECK(query<std::string>(db, "select joined('a', 'b');") == "ab");
+  CHECK(query<std::string>(db, "select joined(null, 'b');") == "b");
+  CHECK(query<sqlite3_int64>(db, "select sum_i32(x'010000000200000003000000');") == 6);
+  CHECK_THROWS(query<int>(db, "select fail(1);"));
+}
+
+}  // namespace
@@ -1,5 +1,6 @@
 #include <iostream>
 #include <sqlite/sqlite.h>
+#include "check.h"
 using namespace sqlite;
 using namespace std;
 
@@ -63,5 +64,8 @@ int main() {
   catch (exception& e) {
     cout << e.what() << endl;
   }
+
+  auto failed = test::run();
   std::cin.get();
+  return failed == 0 ? 0 : 1;
 }
\ No newline at end of file
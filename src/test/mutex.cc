@@ -0,0 +1,88 @@
+#include <sqlite/config.h>
+#include <sqlite/mutex.h>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include "check.h"
+
+namespace {
+
+sqlite::mutex_statistics find(const std::string& name) {
+  for (const auto& s : sqlite::futex_mutex_statistics()) {
+    if (s.name == name) {
+      return s;
+    }
+  }
+  return sqlite::mutex_statistics();
+}
+
+// Holds `m` on another thread for `hold` and then locks it on this one.
+void contend(sqlite3_mutex* m, std::chrono::milliseconds hold) {
+  std::atomic<bool> holding{ false };
+  std::thread holder([&]() {
+    sqlite3_mutex_enter(m);
+    holding = true;
+    std::this_thread::sleep_for(hold);
+    sqlite3_mutex_leave(m);
+  });
+  while (!holding) {
+    std::this_thread::yield();
+  }
+  sqlite3_mutex_enter(m);
+  sqlite3_mutex_leave(m);
+  holder.join();
+}
+
+// The mutex implementation is process-wide, so the test installs it while no connection is
+// open and restores the previous one before the other tests open their databases.
+TEST_CASE(mutex_statistics) {
+  sqlite3_mutex_methods previous;
+  CHECK(sqlite3_shutdown() == SQLITE_OK);
+  CHECK(sqlite3_config(SQLITE_CONFIG_GETMUTEX, &previous) == SQLITE_OK);
+
+  sqlite::config options;
+  options.mutex = sqlite::mutex_implementation::futex;
+  options.futex.statistics = true;
+  // Long enough that the waiter acquires the mutex while spinning.
+  options.futex.spin = 1 << 30;
+  sqlite::initialize(options);
+
+  auto before = find("fast");
+  auto m = sqlite3_mutex_alloc(SQLITE_MUTEX_FAST);
+  sqlite3_mutex_enter(m);
+  CHECK(sqlite3_mutex_try(m) == SQLITE_BUSY);
+  sqlite3_mutex_leave(m);
+  contend(m, std::chrono::milliseconds(20));
+  sqlite3_mutex_free(m);
+  auto spun = find("fast");
+  CHECK(spun.acquires - before.acquires == 3);
+  CHECK(spun.contended - before.contended == 1);
+  CHECK(spun.wait - before.wait >= std::chrono::milliseconds(10));
+
+  // Without spinning, the waiter parks.
+  CHECK(sqlite3_shutdown() == SQLITE_OK);
+  options.futex.spin = 0;
+  sqlite::initialize(options);
+  m = sqlite3_mutex_alloc(SQLITE_MUTEX_RECURSIVE);
+  before = find("recursive");
+  contend(m, std::chrono::milliseconds(20));
+  sqlite3_mutex_free(m);
+  auto parked = find("recursive");
+  CHECK(parked.acquires - before.acquires == 2);
+  CHECK(parked.contended - before.contended == 1);
+  CHECK(parked.wait - before.wait >= std::chrono::milliseconds(10));
+
+  {
+    sqlite::database db(":memory:");
+    db << "create table t (x integer);";
+    db << "insert into t values (1);";
+  }
+  CHECK(find("fast").acquires + find("recursive").acquires + find("main").acquires > parked.acquires);
+
+  CHECK(sqlite3_shutdown() == SQLITE_OK);
+  CHECK(sqlite3_config(SQLITE_CONFIG_MUTEX, &previous) == SQLITE_OK);
+  CHECK(sqlite3_initialize() == SQLITE_OK);
+}
+
+}  // namespace
@@ -0,0 +1,95 @@
+#include <sqlite/scheduler.h>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include "check.h"
+
+namespace {
+
+// Counts to `limit` in a recursive query that runs long enough to be preempted.
+sqlite3_int64 count_to(sqlite::database& db, sqlite3_int64 limit) {
+  sqlite3_int64 rows = 0;
+  db << "with recursive c(x) as (select 1 union all select x + 1 from c where x < ?) select count(*) from c;" << limit >> rows;
+  return rows;
+}
+
+void wait_until(const std::atomic<bool>& flag) {
+  while (!flag) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+}
+
+TEST_CASE(scheduler_preempts_lower_class) {
+  test::temporary_file file("scheduler_preempt");
+  sqlite::scheduler_options options;
+  options.connections = 1;
+  options.aging = std::chrono::milliseconds(0);
+  sqlite::scheduler s(file.path(), options);
+
+  std::atomic<bool> started{ false };
+  std::atomic<bool> interrupted{ false };
+  std::thread low([&]() {
+    try {
+      s.run(sqlite::priority::low, [&](sqlite::database& db) {
+        started = true;
+        return count_to(db, 100000000);
+      });
+    }
+    catch (const sqlite::sqlite_exception&) {
+      interrupted = true;
+    }
+  });
+  wait_until(started);
+  auto rows = s.run(sqlite::priority::high, [](sqlite::database& db) {
+    return count_to(db, 10);
+  });
+  low.join();
+  CHECK(rows == 10);
+  CHECK(interrupted);
+  CHECK(s.running(sqlite::priority::low) == 0);
+}
+
+// A low request that aged into the high class while it waited is not preempted by the
+// next high request.
+TEST_CASE(scheduler_keeps_aged_class) {
+  test::temporary_file file("scheduler_aging");
+  sqlite::scheduler_options options;
+  options.connections = 1;
+  options.aging = std::chrono::milliseconds(10);
+  sqlite::scheduler s(file.path(), options);
+
+  std::atomic<bool> holding{ false };
+  std::atomic<bool> started{ false };
+  std::thread normal([&]() {
+    s.run(sqlite::priority::normal, [&](sqlite::database&) {
+      holding = true;
+      std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    });
+  });
+  wait_until(holding);
+
+  sqlite3_int64 rows = 0;
+  std::string error;
+  std::thread low([&]() {
+    try {
+      rows = s.run(sqlite::priority::low, [&](sqlite::database& db) {
+        started = true;
+        return count_to(db, 3000000);
+      });
+    }
+    catch (const sqlite::sqlite_exception& e) {
+      error = e.what();
+    }
+  });
+  wait_until(started);
+  s.run(sqlite::priority::high, [](sqlite::database& db) {
+    return count_to(db, 10);
+  });
+  low.join();
+  normal.join();
+  CHECK(error.empty());
+  CHECK(rows == 3000000);
+}
+
+}  // namespace
@@ -1,3 +1,24 @@
 #include <sqlite/sqlite.h>
+#include <sqlite/allocator.h>
+#include <sqlite/ann.h>
+#include <sqlite/approximate.h>
+#include <sqlite/backup.h>
+#include <sqlite/carray.h>
+#include <sqlite/checkpoint.h>
+#include <sqlite/collation.h>
+#include <sqlite/compress.h>
+#include <sqlite/config.h>
+#include <sqlite/function.h>
+#include <sqlite/governor.h>
+#include <sqlite/instrument.h>
+#include <sqlite/mutex.h>
+#include <sqlite/pcache.h>
+#include <sqlite/readahead.h>
+#include <sqlite/replica.h>
+#include <sqlite/scheduler.h>
+#include <sqlite/uring.h>
+#include <sqlite/vector.h>
+#include <sqlite/vtab.h>
+#include "fault_vfs.h"
 
 // This file tests for linker errors when the `inline` keyword is missing in a header file.
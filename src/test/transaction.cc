@@ -0,0 +1,140 @@
+#include <sqlite/sqlite.h>
+#include <stdexcept>
+#include <utility>
+#include "check.h"
+
+namespace {
+
+int count(const sqlite::database& db) {
+  int rows = 0;
+  db << "select count(*) from t;" >> rows;
+  return rows;
+}
+
+bool autocommit(const sqlite::database& db) {
+  return sqlite3_get_autocommit(db.handle()) != 0;
+}
+
+TEST_CASE(transaction_commit) {
+  test::temporary_file file("transaction_commit");
+  {
+    sqlite::database db(file.path());
+    db << "create table t (x integer);";
+    sqlite::transaction t(db);
+    CHECK(!autocommit(db));
+    db << "insert into t values (1);";
+    db << "insert into t values (2);";
+    t.commit();
+    CHECK(autocommit(db));
+  }
+  sqlite::database db(file.path());
+  CHECK(count(db) == 2);
+}
+
+TEST_CASE(transaction_rollback_on_exception) {
+  test::temporary_file file("transaction_rollback");
+  sqlite::database db(file.path());
+  db << "create table t (x integer);";
+  CHECK_THROWS({
+    sqlite::transaction t(db);
+    db << "insert into t values (1);";
+    throw std::runtime_error("abort");
+  });
+  CHECK(autocommit(db));
+  CHECK(count(db) == 0);
+
+  sqlite::transaction t(db, sqlite::transaction_mode::deferred);
+  db << "insert into t values (1);";
+  t.rollback();
+  CHECK(autocommit(db));
+  CHECK(count(db) == 0);
+}
+
+TEST_CASE(savepoint_nesting) {
+  test::temporary_file file("savepoint_nesting");
+  sqlite::database db(file.path());
+  db << "create table t (x integer);";
+  {
+    sqlite::transaction t(db);
+    db << "insert into t values (1);";
+    {
+      sqlite::savepoint outer(db);
+      db << "insert into t values (2);";
+      {
+        sqlite::savepoint inner(db);
+        db << "insert into t values (3);";
+      }
+      CHECK(count(db) == 2);
+      // The rolled back savepoint's depth is reused.
+      {
+        sqlite::savepoint inner(db);
+        db << "insert into t values (4);";
+        inner.release();
+      }
+      outer.release();
+    }
+    CHECK(count(db) == 3);
+    {
+      sqlite::savepoint s(db);
+      db << "insert into t values (5);";
+      s.rollback();
+    }
+    t.commit();
+  }
+  CHECK(count(db) == 3);
+
+  // A savepoint outside of a transaction starts one.
+  {
+    sqlite::savepoint s(db);
+    CHECK(!autocommit(db));
+    db << "insert into t values (6);";
+    s.release();
+  }
+  CHECK(autocommit(db));
+  CHECK(count(db) == 4);
+}
+
+TEST_CASE(transaction_resets_savepoint_depth) {
+  test::temporary_file file("transaction_depth");
+  sqlite::database db(file.path());
+  db << "create table t (x integer);";
+  {
+    sqlite::transaction t(db);
+    sqlite::savepoint s(db);
+    db << "insert into t values (1);";
+    s.release();
+    t.commit();
+  }
+  {
+    sqlite::transaction t(db);
+    sqlite::savepoint s(db);
+    db << "insert into t values (2);";
+    s.rollback();
+    t.commit();
+  }
+  CHECK(count(db) == 1);
+}
+
+TEST_CASE(database_move) {
+  test::temporary_file file("database_move");
+  sqlite::database a(file.path());
+  a << "create table t (x integer);";
+  {
+    sqlite::transaction t(a);
+    a << "insert into t values (1);";
+    t.commit();
+  }
+  sqlite::database b(std::move(a));
+  CHECK(a.handle() == nullptr);
+  CHECK(count(b) == 1);
+  {
+    sqlite::transaction t(b);
+    b << "insert into t values (2);";
+    t.commit();
+  }
+  sqlite::database c(":memory:");
+  c = std::move(b);
+  CHECK(count(c) == 2);
+}
+
+}  // namespace
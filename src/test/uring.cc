@@ -0,0 +1,64 @@
+#include <sqlite/uring.h>
+#include <string>
+#include "check.h"
+
+namespace {
+
+const int rows = 3000;
+const sqlite3_int64 sum = static_cast<sqlite3_int64>(rows - 1) * rows / 2;
+
+sqlite3_int64 checksum(const sqlite::database& db) {
+  sqlite3_int64 value = 0;
+  db << "select sum(cast(x as integer)) from t;" >> value;
+  return value;
+}
+
+std::string integrity(const sqlite::database& db) {
+  std::string result;
+  db << "pragma integrity_check;" >> result;
+  return result;
+}
+
+// Round trip through the VFS with a small page cache, so that scans are served by readahead
+// and commits by batched writes, and a reopen that reads the file back.
+TEST_CASE(uring_round_trip) {
+  test::temporary_file file("uring");
+  sqlite::uring_vfs_options options;
+  options.readahead = 64 * 1024;
+  options.write_batch = 64 * 1024;
+  auto vfs = sqlite::uring_vfs(options);
+  auto before = sqlite::uring_vfs_statistics();
+  {
+    sqlite::database db(file.path(), sqlite::open_mode::read_write, vfs->zName);
+    db << "pragma cache_size=10;";
+    db << "create table t (i integer primary key, x text);";
+    sqlite::transaction t(db);
+    for (int i = 0; i < rows; i++) {
+      db << "insert into t (x) values (printf('%.900d', ?));" << i;
+    }
+    t.commit();
+    for (int i = 0; i < 5; i++) {
+      CHECK(checksum(db) == sum);
+    }
+    CHECK(integrity(db) == "ok");
+  }
+  {
+    sqlite::database db(file.path(), sqlite::open_mode::read_write, vfs->zName);
+    db << "pragma cache_size=10;";
+    CHECK(checksum(db) == sum);
+    db << "update t set x = printf('%.900d', i - 2) where i % 2 = 0;";
+    CHECK(checksum(db) == sum - rows / 2);
+    CHECK(integrity(db) == "ok");
+  }
+  sqlite::database db(file.path());
+  CHECK(checksum(db) == sum - rows / 2);
+
+  auto after = sqlite::uring_vfs_statistics();
+  if (sqlite::uring_available()) {
+    CHECK(after.writes > before.writes);
+    CHECK(after.write_batches > before.write_batches);
+    CHECK(after.readahead_hits > before.readahead_hits);
+  }
+}
+
+}  // namespace
@@ -0,0 +1,67 @@
+#include <sqlite/vtab.h>
+#include <string>
+#include <vector>
+#include "check.h"
+
+namespace {
+
+struct point {
+  sqlite3_int64 id;
+  double x;
+  std::string name;
+};
+
+int count(const sqlite::database& db, const std::string& table, const std::string& where) {
+  int rows = 0;
+  db << "select count(*) from " + table + " where " + where + ";" >> rows;
+  return rows;
+}
+
+// Constraints of every storage class on the sorted first column must match what SQLite
+// returns for a real table with the same declared types.
+TEST_CASE(sorted_table_matches_real_table) {
+  std::vector<point> points = { { 1, 0.5, "a" }, { 2, 1.5, "b" }, { 3, 2.5, "c" }, { 5, 3.5, "e" } };
+  std::vector<point> names = { { 1, 0, "" }, { 2, 0, "10" }, { 3, 0, "9" }, { 4, 0, "abc" }, { 5, 0, "b" } };
+  sqlite::database db(":memory:");
+  sqlite::define_sorted_table(db, "ids", points, sqlite::column("id", &point::id), sqlite::column("x", &point::x));
+  sqlite::define_sorted_table(db, "texts", names, sqlite::column("name", &point::name), sqlite::column("id", &point::id));
+  db << "create table real_ids (id integer, x real);";
+  db << "create table real_texts (name text, id integer);";
+  for (const auto& p : points) {
+    db << "insert into real_ids values (?, ?);" << p.id << p.x;
+  }
+  for (const auto& p : names) {
+    db << "insert into real_texts values (?, ?);" << p.name << p.id;
+  }
+
+  const char* numbers[] = {
+    "id < 'abc'", "id > 'abc'", "id = '2'", "id >= '2'", "id < x'00'", "id > x'00'", "id = null", "id < 3",
+    "id <= 3",    "id > 2.5",   "id = 2.0", "id = 4",    "id >= 2 and id < 5",      "id > 'abc' and id < 5",
+  };
+  for (auto where : numbers) {
+    if (count(db, "ids", where) != count(db, "real_ids", where)) {
+      throw test::failure(std::string("ids where ") + where);
+    }
+  }
+  const char* texts[] = {
+    "name < 'b'", "name >= 'abc'", "name = 'abc'", "name < 10", "name = 10", "name > 9", "name < x'62'", "name = ''",
+  };
+  for (auto where : texts) {
+    if (count(db, "texts", where) != count(db, "real_texts", where)) {
+      throw test::failure(std::string("texts where ") + where);
+    }
+  }
+}
+
+TEST_CASE(sorted_table_order) {
+  std::vector<point> points = { { 1, 0.5, "a" }, { 2, 1.5, "b" }, { 3, 2.5, "c" } };
+  sqlite::database db(":memory:");
+  sqlite::define_sorted_table(db, "points", points, sqlite::column("id", &point::id), sqlite::column("name", &point::name));
+  std::string names;
+  db << "select name from points where id >= ? order by id;" << 2 >> [&](std::string name) {
+    names += name;
+  };
+  CHECK(names == "bc");
+}
+
+}  // namespace
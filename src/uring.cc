@@ -0,0 +1,713 @@
+#include <sqlite/uring.h>
+#include "shim.h"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#ifdef __linux__
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+
+namespace sqlite {
+namespace {
+
+uring_vfs_options options;
+sqlite3_vfs vfs;
+bool available = false;
+std::once_flag registered;
+
+std::atomic<std::uint64_t> reads{ 0 };
+std::atomic<std::uint64_t> readahead_hits{ 0 };
+std::atomic<std::uint64_t> writes{ 0 };
+std::atomic<std::uint64_t> write_batches{ 0 };
+std::atomic<std::uint64_t> write_submissions{ 0 };
+std::atomic<std::uint64_t> syncs{ 0 };
+
+#ifdef __linux__
+
+// Adjacent pages merged into a single vectored write, the Linux limit of `writev`.
+const unsigned max_iovecs = 1024;
+
+// Completion of a submitted request.
+struct operation {
+  int result = 0;
+  bool done = true;
+};
+
+// Minimal io_uring instance on top of the raw system calls. Requests are only submitted and
+// completed by the thread that currently owns the file.
+class ring {
+private:
+  int fd_ = -1;
+  void* sq_ = MAP_FAILED;
+  void* cq_ = MAP_FAILED;
+  void* sqes_ = MAP_FAILED;
+  std::size_t sq_size_ = 0;
+  std::size_t cq_size_ = 0;
+  std::size_t sqes_size_ = 0;
+
+  unsigned* sq_head_ = nullptr;
+  unsigned* sq_tail_ = nullptr;
+  unsigned* sq_array_ = nullptr;
+  unsigned sq_mask_ = 0;
+  unsigned* cq_head_ = nullptr;
+  unsigned* cq_tail_ = nullptr;
+  unsigned cq_mask_ = 0;
+  io_uring_cqe* cqes_ = nullptr;
+  unsigned entries_ = 0;
+
+  // Requests that were queued but not submitted, and submitted but not completed. Their sum
+  // never exceeds the queue size, so the completion queue cannot overflow.
+  unsigned queued_ = 0;
+  unsigned inflight_ = 0;
+
+  // Set when a system call failed. No requests are queued afterwards.
+  bool broken_ = false;
+
+  void release() {
+    if (sqes_ != MAP_FAILED) {
+      munmap(sqes_, sqes_size_);
+    }
+    if (cq_ != MAP_FAILED && cq_ != sq_) {
+      munmap(cq_, cq_size_);
+    }
+    if (sq_ != MAP_FAILED) {
+      munmap(sq_, sq_size_);
+    }
+    if (fd_ >= 0) {
+      close(fd_);
+    }
+    sq_ = cq_ = sqes_ = MAP_FAILED;
+    fd_ = -1;
+  }
+
+  int enter(unsigned submit, unsigned complete) {
+    auto flags = complete ? IORING_ENTER_GETEVENTS : 0u;
+    auto n = static_cast<int>(syscall(__NR_io_uring_enter, fd_, submit, complete, flags, nullptr, 0));
+    if (n > 0) {
+      queued_ -= static_cast<unsigned>(n);
+      inflight_ += static_cast<unsigned>(n);
+    }
+    if (n < 0 && errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+      abandon();
+      return -1;
+    }
+    return 0;
+  }
+
+  // Requests point into buffers of callers that return as soon as the ring fails, so after a
+  // failure the requests that the kernel has not consumed are taken back and the others are
+  // waited for. Callers find their operations either done or never started.
+  void abandon() {
+    broken_ = true;
+    auto head = __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE);
+    auto unconsumed = *sq_tail_ - head;
+    inflight_ += queued_ - unconsumed;
+    queued_ = 0;
+    __atomic_store_n(sq_tail_, head, __ATOMIC_RELEASE);
+    while (reap(), inflight_ > 0) {
+      // Completions are also posted without entering the kernel, so waiting continues when
+      // entering fails again.
+      if (syscall(__NR_io_uring_enter, fd_, 0, 1, IORING_ENTER_GETEVENTS, nullptr, 0) < 0 && errno != EINTR) {
+        usleep(1000);
+      }
+    }
+  }
+
+  void reap() {
+    auto head = *cq_head_;
+    auto tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+    for (; head != tail; head++) {
+      auto& cqe = cqes_[head & cq_mask_];
+      if (auto op = reinterpret_cast<operation*>(cqe.user_data)) {
+        op->result = cqe.res;
+        op->done = true;
+      }
+      inflight_--;
+    }
+    __atomic_store_n(cq_head_, head, __ATOMIC_RELEASE);
+  }
+
+public:
+  explicit ring(unsigned entries) {
+    io_uring_params params;
+    std::memset(&params, 0, sizeof(params));
+    fd_ = static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+    if (fd_ < 0) {
+      return;
+    }
+    sq_size_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cq_size_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    bool single = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (single) {
+      sq_size_ = cq_size_ = std::max(sq_size_, cq_size_);
+    }
+    sq_ = mmap(nullptr, sq_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_SQ_RING);
+    cq_ = single ? sq_ : mmap(nullptr, cq_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_CQ_RING);
+    sqes_size_ = params.sq_entries * sizeof(io_uring_sqe);
+    sqes_ = mmap(nullptr, sqes_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_SQES);
+    if (sq_ == MAP_FAILED || cq_ == MAP_FAILED || sqes_ == MAP_FAILED) {
+      release();
+      return;
+    }
+
+    auto sq = static_cast<char*>(sq_);
+    sq_head_ = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+    sq_tail_ = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+    sq_array_ = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+    sq_mask_ = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+    auto cq = static_cast<char*>(cq_);
+    cq_head_ = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+    cq_tail_ = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+    cq_mask_ = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+    cqes_ = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+    entries_ = params.sq_entries;
+  }
+
+  ring(const ring& other) = delete;
+  ring& operator=(const ring& other) = delete;
+
+  ~ring() {
+    drain();
+    release();
+  }
+
+  bool valid() const {
+    return fd_ >= 0;
+  }
+
+  // Queues a request. Returns false when the queue is full.
+  bool push(std::uint8_t opcode, int fd, const void* address, unsigned length, sqlite3_int64 offset, operation* op, std::uint8_t flags = 0, std::uint32_t op_flags = 0) {
+    if (broken_ || queued_ + inflight_ >= entries_) {
+      return false;
+    }
+    auto tail = *sq_tail_;
+    auto index = tail & sq_mask_;
+    auto& sqe = static_cast<io_uring_sqe*>(sqes_)[index];
+    std::memset(&sqe, 0, sizeof(sqe));
+    sqe.opcode = opcode;
+    sqe.flags = flags;
+    sqe.fd = fd;
+    sqe.addr = reinterpret_cast<std::uintptr_t>(address);
+    sqe.len = length;
+    sqe.off = static_cast<std::uint64_t>(offset);
+    sqe.rw_flags = static_cast<decltype(sqe.rw_flags)>(op_flags);
+    sqe.user_data = reinterpret_cast<std::uintptr_t>(op);
+    if (op) {
+      op->done = false;
+    }
+    sq_array_[index] = index;
+    __atomic_store_n(sq_tail_, tail + 1, __ATOMIC_RELEASE);
+    queued_++;
+    return true;
+  }
+
+  // Submits queued requests without waiting for them.
+  bool submit() {
+    while (queued_ > 0) {
+      if (enter(queued_, 0) < 0) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  // Submits queued requests and waits until `op` is complete. Returns false when `op` was
+  // never started, in which case the ring no longer refers to it.
+  bool wait(operation& op) {
+    while (true) {
+      reap();
+      if (op.done) {
+        return true;
+      }
+      if (queued_ + inflight_ == 0 || enter(queued_, 1) < 0) {
+        return op.done;
+      }
+    }
+  }
+
+  // Submits queued requests and waits until all requests are complete. Returns false when
+  // the ring failed; no request is pending afterwards either way.
+  bool drain() {
+    while (valid()) {
+      reap();
+      if (queued_ + inflight_ == 0) {
+        return true;
+      }
+      if (enter(queued_, 1) < 0) {
+        return false;
+      }
+    }
+    return false;
+  }
+};
+
+// Bytes read ahead of sequential reads. A window is either empty, being read or filled.
+struct window {
+  std::vector<char> data;
+  iovec iov;
+  sqlite3_int64 offset = -1;
+  std::size_t length = 0;
+  operation op;
+};
+
+#endif
+
+struct file : shim::file {
+#ifdef __linux__
+  int fd = -1;
+  std::unique_ptr<ring> uring;
+
+  // Writes are copied and collected by offset until they are submitted.
+  std::map<sqlite3_int64, std::vector<char>> pending;
+  std::size_t pending_bytes = 0;
+
+  window windows[2];
+  std::size_t current = 0;
+  sqlite3_int64 next_offset = -1;
+  int sequential = 0;
+#endif
+};
+
+#ifdef __linux__
+
+// Methods of main database files that go through io_uring.
+
+file& self(sqlite3_file* f) {
+  return *reinterpret_cast<file*>(f);
+}
+
+void invalidate(file& self) {
+  for (auto& w : self.windows) {
+    if (!w.op.done) {
+      self.uring->wait(w.op);
+    }
+    w.offset = -1;
+    w.length = 0;
+  }
+  self.sequential = 0;
+}
+
+// Reads until `amount` bytes are read or the end of the file is reached. Returns the number
+// of bytes read or -1.
+long read_fully(file& self, char* buffer, std::size_t amount, sqlite3_int64 offset) {
+  std::size_t done = 0;
+  while (done < amount) {
+    int result;
+    operation op;
+    iovec iov = { buffer + done, amount - done };
+    if (self.uring->push(IORING_OP_READV, self.fd, &iov, 1, offset + done, &op) && self.uring->wait(op)) {
+      result = op.result;
+    } else {
+      result = static_cast<int>(pread(self.fd, buffer + done, amount - done, offset + done));
+      result = result < 0 ? -errno : result;
+    }
+    if (result == -EINTR || result == -EAGAIN) {
+      continue;
+    }
+    if (result < 0) {
+      return -1;
+    }
+    if (result == 0) {
+      break;
+    }
+    done += static_cast<std::size_t>(result);
+  }
+  return static_cast<long>(done);
+}
+
+bool write_fully(file& self, const char* buffer, std::size_t amount, sqlite3_int64 offset) {
+  std::size_t done = 0;
+  while (done < amount) {
+    auto result = pwrite(self.fd, buffer + done, amount - done, offset + done);
+    if (result < 0 && errno == EINTR) {
+      continue;
+    }
+    if (result <= 0) {
+      return false;
+    }
+    done += static_cast<std::size_t>(result);
+  }
+  return true;
+}
+
+// Submits the collected writes, merging adjacent pages into vectored writes, and syncs the
+// file after all of them when `flags` is not zero.
+int flush(file& self, int flags = 0) {
+  if (self.pending.empty() && !flags) {
+    return SQLITE_OK;
+  }
+
+  struct run {
+    sqlite3_int64 offset;
+    std::size_t first;
+    unsigned count;
+    std::size_t bytes;
+    operation op;
+  };
+  std::vector<iovec> iovecs;
+  std::vector<run> runs;
+  iovecs.reserve(self.pending.size());
+  runs.reserve(self.pending.size());
+  for (auto& page : self.pending) {
+    iovec iov = { page.second.data(), page.second.size() };
+    if (!runs.empty()) {
+      auto& last = runs.back();
+      if (last.offset + static_cast<sqlite3_int64>(last.bytes) == page.first && last.count < max_iovecs) {
+        iovecs.push_back(iov);
+        last.count++;
+        last.bytes += iov.iov_len;
+        continue;
+      }
+    }
+    runs.push_back({ page.first, iovecs.size(), 1, iov.iov_len, {} });
+    iovecs.push_back(iov);
+  }
+
+  bool queued = true;
+  for (auto& r : runs) {
+    queued = queued && (self.uring->push(IORING_OP_WRITEV, self.fd, &iovecs[r.first], r.count, r.offset, &r.op)
+      || (self.uring->drain() && self.uring->push(IORING_OP_WRITEV, self.fd, &iovecs[r.first], r.count, r.offset, &r.op)));
+  }
+
+  // The drain flag starts the sync only after all writes before it have completed.
+  operation synced;
+  if (flags && queued) {
+    auto fsync_flags = (flags & SQLITE_SYNC_DATAONLY) ? IORING_FSYNC_DATASYNC : 0u;
+    queued = self.uring->push(IORING_OP_FSYNC, self.fd, nullptr, 0, 0, &synced, IOSQE_IO_DRAIN, fsync_flags)
+      || (self.uring->drain() && self.uring->push(IORING_OP_FSYNC, self.fd, nullptr, 0, 0, &synced, IOSQE_IO_DRAIN, fsync_flags));
+  }
+  queued = self.uring->drain() && queued;
+  write_batches++;
+  write_submissions += runs.size();
+
+  // Runs that did not complete in full are written again with plain system calls.
+  bool rewritten = false;
+  for (auto& r : runs) {
+    if (queued && r.op.done && r.op.result == static_cast<int>(r.bytes)) {
+      continue;
+    }
+    auto offset = r.offset;
+    for (unsigned i = 0; i < r.count; i++) {
+      auto& iov = iovecs[r.first + i];
+      if (!write_fully(self, static_cast<const char*>(iov.iov_base), iov.iov_len, offset)) {
+        return SQLITE_IOERR_WRITE;
+      }
+      offset += static_cast<sqlite3_int64>(iov.iov_len);
+    }
+    rewritten = true;
+  }
+  self.pending.clear();
+  self.pending_bytes = 0;
+
+  if (flags && (!queued || rewritten || !synced.done || synced.result < 0)) {
+    return shim::methods(&self.base)->xSync(self.real, flags);
+  }
+  return SQLITE_OK;
+}
+
+bool overlaps_pending(const file& self, sqlite3_int64 offset, int amount) {
+  auto it = self.pending.lower_bound(offset + amount);
+  if (it == self.pending.begin()) {
+    return false;
+  }
+  --it;
+  return it->first + static_cast<sqlite3_int64>(it->second.size()) > offset;
+}
+
+// Starts reading the window at `offset` without waiting for it.
+void prefetch(file& self, window& w, sqlite3_int64 offset) {
+  w.data.resize(options.readahead);
+  w.iov = { w.data.data(), w.data.size() };
+  w.offset = offset;
+  w.length = 0;
+  if (!self.uring->push(IORING_OP_READV, self.fd, &w.iov, 1, offset, &w.op) || !self.uring->submit()) {
+    w.op.done = true;
+    w.offset = -1;
+  }
+}
+
+int uring_close(sqlite3_file* f) {
+  auto& s = self(f);
+  auto hresult = flush(s);
+  invalidate(s);
+  s.uring.reset();
+  auto closed = shim::methods(f)->xClose(s.real);
+  s.~file();
+  return hresult != SQLITE_OK ? hresult : closed;
+}
+
+int uring_read(sqlite3_file* f, void* buffer, int amount, sqlite3_int64 offset) {
+  auto& s = self(f);
+  reads++;
+  if (!s.pending.empty() && overlaps_pending(s, offset, amount)) {
+    auto hresult = flush(s);
+    if (hresult != SQLITE_OK) {
+      return hresult;
+    }
+  }
+
+  s.sequential = offset == s.next_offset ? s.sequential + 1 : 0;
+  s.next_offset = offset + amount;
+  auto out = static_cast<char*>(buffer);
+  auto end = offset + amount;
+
+  if (options.readahead >= static_cast<std::size_t>(amount)) {
+    for (std::size_t i = 0; i < 2; i++) {
+      auto& w = s.windows[(s.current + i) % 2];
+      if (w.offset < 0 || offset < w.offset || offset >= w.offset + static_cast<sqlite3_int64>(options.readahead)) {
+        continue;
+      }
+      if (!w.op.done && !s.uring->wait(w.op)) {
+        w.offset = -1;
+        continue;
+      }
+      if (w.op.result < 0) {
+        w.offset = -1;
+        continue;
+      }
+      if (w.length == 0) {
+        w.length = static_cast<std::size_t>(w.op.result);
+      }
+      auto available = w.offset + static_cast<sqlite3_int64>(w.length);
+      bool eof = w.length < options.readahead;
+      if (end > available && !eof) {
+        continue;
+      }
+      auto copied = std::max<sqlite3_int64>(std::min(end, available) - offset, 0);
+      std::memcpy(out, w.data.data() + (offset - w.offset), static_cast<std::size_t>(copied));
+      readahead_hits++;
+
+      // Moving into the next window starts reading the one after it.
+      if (i == 1) {
+        s.current = (s.current + 1) % 2;
+        auto& next = s.windows[(s.current + 1) % 2];
+        next.offset = -1;
+        if (!eof) {
+          prefetch(s, next, w.offset + static_cast<sqlite3_int64>(options.readahead));
+        }
+      }
+      if (copied < amount) {
+        std::memset(out + copied, 0, static_cast<std::size_t>(amount - copied));
+        return SQLITE_IOERR_SHORT_READ;
+      }
+      return SQLITE_OK;
+    }
+
+    if (s.sequential >= options.sequential_reads) {
+      invalidate(s);
+      s.sequential = options.sequential_reads;
+      auto& w = s.windows[s.current];
+      w.data.resize(options.readahead);
+      auto result = read_fully(s, w.data.data(), options.readahead, offset);
+      if (result < 0) {
+        return SQLITE_IOERR_READ;
+      }
+      w.offset = offset;
+      w.length = static_cast<std::size_t>(result);
+      w.op.result = static_cast<int>(result);
+      if (w.length == options.readahead) {
+        prefetch(s, s.windows[(s.current + 1) % 2], offset + static_cast<sqlite3_int64>(options.readahead));
+      }
+      auto copied = std::min<sqlite3_int64>(static_cast<sqlite3_int64>(w.length), amount);
+      std::memcpy(out, w.data.data(), static_cast<std::size_t>(copied));
+      if (copied < amount) {
+        std::memset(out + copied, 0, static_cast<std::size_t>(amount - copied));
+        return SQLITE_IOERR_SHORT_READ;
+      }
+      return SQLITE_OK;
+    }
+  }
+
+  auto result = read_fully(s, out, static_cast<std::size_t>(amount), offset);
+  if (result < 0) {
+    return SQLITE_IOERR_READ;
+  }
+  if (result < amount) {
+    std::memset(out + result, 0, static_cast<std::size_t>(amount - result));
+    return SQLITE_IOERR_SHORT_READ;
+  }
+  return SQLITE_OK;
+}
+
+int uring_write(sqlite3_file* f, const void* buffer, int amount, sqlite3_int64 offset) {
+  auto& s = self(f);
+  writes++;
+  invalidate(s);
+
+  auto data = static_cast<const char*>(buffer);
+  auto it = s.pending.find(offset);
+  if (it != s.pending.end() && it->second.size() == static_cast<std::size_t>(amount)) {
+    std::memcpy(it->second.data(), data, static_cast<std::size_t>(amount));
+    return SQLITE_OK;
+  }
+  if (overlaps_pending(s, offset, amount)) {
+    auto hresult = flush(s);
+    if (hresult != SQLITE_OK) {
+      return hresult;
+    }
+  }
+  s.pending.emplace(offset, std::vector<char>(data, data + amount));
+  s.pending_bytes += static_cast<std::size_t>(amount);
+  if (s.pending_bytes >= options.write_batch) {
+    return flush(s);
+  }
+  return SQLITE_OK;
+}
+
+int uring_truncate(sqlite3_file* f, sqlite3_int64 size) {
+  auto& s = self(f);
+  auto hresult = flush(s);
+  invalidate(s);
+  return hresult != SQLITE_OK ? hresult : shim::methods(f)->xTruncate(s.real, size);
+}
+
+int uring_sync(sqlite3_file* f, int flags) {
+  syncs++;
+  return flush(self(f), flags);
+}
+
+int uring_file_size(sqlite3_file* f, sqlite3_int64* size) {
+  auto hresult = flush(self(f));
+  return hresult != SQLITE_OK ? hresult : shim::methods(f)->xFileSize(shim::real(f), size);
+}
+
+// Other connections may change the file between locks, so the readahead windows are
+// dropped whenever a lock changes.
+int uring_lock(sqlite3_file* f, int level) {
+  invalidate(self(f));
+  return shim::methods(f)->xLock(shim::real(f), level);
+}
+
+int uring_unlock(sqlite3_file* f, int level) {
+  auto hresult = flush(self(f));
+  invalidate(self(f));
+  return hresult != SQLITE_OK ? hresult : shim::methods(f)->xUnlock(shim::real(f), level);
+}
+
+int uring_file_control(sqlite3_file* f, int op, void* argument) {
+  if (op == SQLITE_FCNTL_MMAP_SIZE) {
+    *static_cast<sqlite3_int64*>(argument) = 0;
+    return SQLITE_OK;
+  }
+  auto hresult = flush(self(f));
+  return hresult != SQLITE_OK ? hresult : shim::methods(f)->xFileControl(shim::real(f), op, argument);
+}
+
+int uring_shm_lock(sqlite3_file* f, int offset, int count, int flags) {
+  if (flags & SQLITE_SHM_UNLOCK) {
+    auto hresult = flush(self(f));
+    if (hresult != SQLITE_OK) {
+      return hresult;
+    }
+  }
+  invalidate(self(f));
+  return shim::shm_lock(f, offset, count, flags);
+}
+
+const sqlite3_io_methods uring_methods = {
+  3,
+  uring_close,
+  uring_read,
+  uring_write,
+  uring_truncate,
+  uring_sync,
+  uring_file_size,
+  uring_lock,
+  uring_unlock,
+  shim::check_reserved_lock,
+  uring_file_control,
+  shim::sector_size,
+  shim::device_characteristics,
+  shim::shm_map,
+  uring_shm_lock,
+  shim::shm_barrier,
+  shim::shm_unmap,
+  shim::no_fetch,
+  shim::no_unfetch,
+};
+
+// Returns the descriptor of a file opened by the unix VFS. The unix VFS does not expose its
+// descriptor, so it is read from the start of its file structure and only used when it
+// refers to the same file as the path.
+int descriptor(sqlite3_file* real, const char* path) {
+  struct unix_file {
+    const sqlite3_io_methods* methods;
+    sqlite3_vfs* vfs;
+    void* inode;
+    int fd;
+  };
+  auto fd = reinterpret_cast<unix_file*>(real)->fd;
+  struct stat opened, named;
+  if (fd < 0 || fstat(fd, &opened) != 0 || stat(path, &named) != 0) {
+    return -1;
+  }
+  return opened.st_dev == named.st_dev && opened.st_ino == named.st_ino ? fd : -1;
+}
+
+#endif
+
+int open(sqlite3_vfs* v, const char* name, sqlite3_file* f, int flags, int* out_flags) {
+  int hresult;
+  auto self = shim::open<file>(v, name, f, flags, out_flags, hresult);
+  if (!self) {
+    return hresult;
+  }
+  f->pMethods = shim::passthrough<file>();
+
+#ifdef __linux__
+  if (available && name && (flags & SQLITE_OPEN_MAIN_DB)) {
+    self->fd = descriptor(self->real, name);
+    if (self->fd >= 0) {
+      std::unique_ptr<ring> r(new ring(options.entries));
+      if (r->valid()) {
+        self->uring = std::move(r);
+        f->pMethods = &uring_methods;
+      }
+    }
+  }
+#endif
+  return SQLITE_OK;
+}
+
+}  // namespace
+
+sqlite3_vfs* uring_vfs(const uring_vfs_options& o) {
+  std::call_once(registered, [&o]() {
+    options = o;
+    options.entries = std::max(options.entries, 8u);
+    auto base = sqlite3_vfs_find(nullptr);
+#ifdef __linux__
+    available = base && std::strncmp(base->zName, "unix", 4) == 0 && ring(options.entries).valid();
+#endif
+    shim::install<file>(vfs, base, "uring", open, options.make_default);
+  });
+  return &vfs;
+}
+
+bool uring_available() {
+  return available;
+}
+
+uring_statistics uring_vfs_statistics() {
+  uring_statistics s;
+  s.reads = reads;
+  s.readahead_hits = readahead_hits;
+  s.writes = writes;
+  s.write_batches = write_batches;
+  s.write_submissions = write_submissions;
+  s.syncs = syncs;
+  return s;
+}
+
+}  // namespace sqlite
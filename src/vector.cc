@@ -0,0 +1,424 @@
+#include <sqlite/vector.h>
+#include <cmath>
+#include <cstring>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define SQLITE_VECTOR_X86 1
+#include <immintrin.h>
+#endif
+
+namespace sqlite {
+namespace {
+
+// Components are copied out, since BLOBs in records are not aligned.
+inline float load(const void* p, std::size_t i) {
+  float value;
+  std::memcpy(&value, static_cast<const char*>(p) + i * sizeof(float), sizeof(float));
+  return value;
+}
+
+inline std::int32_t load8(const void* p, std::size_t i) {
+  return static_cast<const std::int8_t*>(p)[i];
+}
+
+// Sums of a * b, a * a and b * b for the cosine distance.
+struct float_sums {
+  float ab;
+  float aa;
+  float bb;
+};
+
+struct int_sums {
+  std::int32_t ab;
+  std::int32_t aa;
+  std::int32_t bb;
+};
+
+struct kernels {
+  float (*dot)(const void*, const void*, std::size_t);
+  float (*l2)(const void*, const void*, std::size_t);
+  float_sums (*cosine)(const void*, const void*, std::size_t);
+  std::int32_t (*dot8)(const void*, const void*, std::size_t);
+  std::int32_t (*l28)(const void*, const void*, std::size_t);
+  int_sums (*cosine8)(const void*, const void*, std::size_t);
+};
+
+// The scalar kernels also finish the components that the vector kernels leave, from `i` on.
+float dot_scalar(const void* a, const void* b, std::size_t size, std::size_t i = 0, float sum = 0) {
+  for (; i < size; i++) {
+    sum += load(a, i) * load(b, i);
+  }
+  return sum;
+}
+
+float l2_scalar(const void* a, const void* b, std::size_t size, std::size_t i = 0, float sum = 0) {
+  for (; i < size; i++) {
+    auto d = load(a, i) - load(b, i);
+    sum += d * d;
+  }
+  return sum;
+}
+
+float_sums cosine_scalar(const void* a, const void* b, std::size_t size, std::size_t i = 0, float_sums sums = {}) {
+  for (; i < size; i++) {
+    auto x = load(a, i);
+    auto y = load(b, i);
+    sums.ab += x * y;
+    sums.aa += x * x;
+    sums.bb += y * y;
+  }
+  return sums;
+}
+
+std::int32_t dot8_scalar(const void* a, const void* b, std::size_t size, std::size_t i = 0, std::int32_t sum = 0) {
+  for (; i < size; i++) {
+    sum += load8(a, i) * load8(b, i);
+  }
+  return sum;
+}
+
+std::int32_t l28_scalar(const void* a, const void* b, std::size_t size, std::size_t i = 0, std::int32_t sum = 0) {
+  for (; i < size; i++) {
+    auto d = load8(a, i) - load8(b, i);
+    sum += d * d;
+  }
+  return sum;
+}
+
+int_sums cosine8_scalar(const void* a, const void* b, std::size_t size, std::size_t i = 0, int_sums sums = {}) {
+  for (; i < size; i++) {
+    auto x = load8(a, i);
+    auto y = load8(b, i);
+    sums.ab += x * y;
+    sums.aa += x * x;
+    sums.bb += y * y;
+  }
+  return sums;
+}
+
+#ifdef SQLITE_VECTOR_X86
+
+inline const float* floats(const void* p, std::size_t i) {
+  return static_cast<const float*>(p) + i;
+}
+
+inline const __m128i* bytes(const void* p, std::size_t i) {
+  return reinterpret_cast<const __m128i*>(static_cast<const std::int8_t*>(p) + i);
+}
+
+__attribute__((target("avx2,fma"))) inline float sum(__m256 v) {
+  auto x = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+  x = _mm_add_ps(x, _mm_movehl_ps(x, x));
+  return _mm_cvtss_f32(_mm_add_ss(x, _mm_shuffle_ps(x, x, 1)));
+}
+
+__attribute__((target("avx2,fma"))) inline std::int32_t sum(__m256i v) {
+  auto x = _mm_add_epi32(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+  x = _mm_add_epi32(x, _mm_shuffle_epi32(x, 0x4e));
+  return _mm_cvtsi128_si32(_mm_add_epi32(x, _mm_shuffle_epi32(x, 0xb1)));
+}
+
+__attribute__((target("avx2,fma"))) float dot_avx2(const void* a, const void* b, std::size_t size) {
+  auto s0 = _mm256_setzero_ps();
+  auto s1 = _mm256_setzero_ps();
+  std::size_t i = 0;
+  for (; i + 16 <= size; i += 16) {
+    s0 = _mm256_fmadd_ps(_mm256_loadu_ps(floats(a, i)), _mm256_loadu_ps(floats(b, i)), s0);
+    s1 = _mm256_fmadd_ps(_mm256_loadu_ps(floats(a, i + 8)), _mm256_loadu_ps(floats(b, i + 8)), s1);
+  }
+  for (; i + 8 <= size; i += 8) {
+    s0 = _mm256_fmadd_ps(_mm256_loadu_ps(floats(a, i)), _mm256_loadu_ps(floats(b, i)), s0);
+  }
+  return dot_scalar(a, b, size, i, sum(_mm256_add_ps(s0, s1)));
+}
+
+__attribute__((target("avx2,fma"))) float l2_avx2(const void* a, const void* b, std::size_t size) {
+  auto s0 = _mm256_setzero_ps();
+  auto s1 = _mm256_setzero_ps();
+  std::size_t i = 0;
+  for (; i + 16 <= size; i += 16) {
+    auto d0 = _mm256_sub_ps(_mm256_loadu_ps(floats(a, i)), _mm256_loadu_ps(floats(b, i)));
+    auto d1 = _mm256_sub_ps(_mm256_loadu_ps(floats(a, i + 8)), _mm256_loadu_ps(floats(b, i + 8)));
+    s0 = _mm256_fmadd_ps(d0, d0, s0);
+    s1 = _mm256_fmadd_ps(d1, d1, s1);
+  }
+  for (; i + 8 <= size; i += 8) {
+    auto d = _mm256_sub_ps(_mm256_loadu_ps(floats(a, i)), _mm256_loadu_ps(floats(b, i)));
+    s0 = _mm256_fmadd_ps(d, d, s0);
+  }
+  return l2_scalar(a, b, size, i, sum(_mm256_add_ps(s0, s1)));
+}
+
+__attribute__((target("avx2,fma"))) float_sums cosine_avx2(const void* a, const void* b, std::size_t size) {
+  auto ab = _mm256_setzero_ps();
+  auto aa = _mm256_setzero_ps();
+  auto bb = _mm256_setzero_ps();
+  std::size_t i = 0;
+  for (; i + 8 <= size; i += 8) {
+    auto x = _mm256_loadu_ps(floats(a, i));
+    auto y = _mm256_loadu_ps(floats(b, i));
+    ab = _mm256_fmadd_ps(x, y, ab);
+    aa = _mm256_fmadd_ps(x, x, aa);
+    bb = _mm256_fmadd_ps(y, y, bb);
+  }
+  return cosine_scalar(a, b, size, i, float_sums{ sum(ab), sum(aa), sum(bb) });
+}
+
+// Bytes are widened to 16 bits, and madd multiplies and adds pairs of them into 32 bits.
+__attribute__((target("avx2,fma"))) std::int32_t dot8_avx2(const void* a, const void* b, std::size_t size) {
+  auto s = _mm256_setzero_si256();
+  std::size_t i = 0;
+  for (; i + 16 <= size; i += 16) {
+    auto x = _mm256_cvtepi8_epi16(_mm_loadu_si128(bytes(a, i)));
+    auto y = _mm256_cvtepi8_epi16(_mm_loadu_si128(bytes(b, i)));
+    s = _mm256_add_epi32(s, _mm256_madd_epi16(x, y));
+  }
+  return dot8_scalar(a, b, size, i, sum(s));
+}
+
+__attribute__((target("avx2,fma"))) std::int32_t l28_avx2(const void* a, const void* b, std::size_t size) {
+  auto s = _mm256_setzero_si256();
+  std::size_t i = 0;
+  for (; i + 16 <= size; i += 16) {
+    auto d = _mm256_sub_epi16(_mm256_cvtepi8_epi16(_mm_loadu_si128(bytes(a, i))), _mm256_cvtepi8_epi16(_mm_loadu_si128(bytes(b, i))));
+    s = _mm256_add_epi32(s, _mm256_madd_epi16(d, d));
+  }
+  return l28_scalar(a, b, size, i, sum(s));
+}
+
+__attribute__((target("avx2,fma"))) int_sums cosine8_avx2(const void* a, const void* b, std::size_t size) {
+  auto ab = _mm256_setzero_si256();
+  auto aa = _mm256_setzero_si256();
+  auto bb = _mm256_setzero_si256();
+  std::size_t i = 0;
+  for (; i + 16 <= size; i += 16) {
+    auto x = _mm256_cvtepi8_epi16(_mm_loadu_si128(bytes(a, i)));
+    auto y = _mm256_cvtepi8_epi16(_mm_loadu_si128(bytes(b, i)));
+    ab = _mm256_add_epi32(ab, _mm256_madd_epi16(x, y));
+    aa = _mm256_add_epi32(aa, _mm256_madd_epi16(x, x));
+    bb = _mm256_add_epi32(bb, _mm256_madd_epi16(y, y));
+  }
+  return cosine8_scalar(a, b, size, i, int_sums{ sum(ab), sum(aa), sum(bb) });
+}
+
+// The halves are extracted with masks, since the unmasked extractions and casts make GCC warn
+// about uninitialized values inside the intrinsics.
+__attribute__((target("avx512f,avx512bw,avx2,fma"))) inline float sum(__m512 v) {
+  auto x = _mm512_castps_pd(v);
+  return sum(_mm256_add_ps(_mm256_castpd_ps(_mm512_maskz_extractf64x4_pd(0xf, x, 0)), _mm256_castpd_ps(_mm512_maskz_extractf64x4_pd(0xf, x, 1))));
+}
+
+__attribute__((target("avx512f,avx512bw,avx2,fma"))) inline std::int32_t sum(__m512i v) {
+  return sum(_mm256_add_epi32(_mm512_maskz_extracti64x4_epi64(0xf, v, 0), _mm512_maskz_extracti64x4_epi64(0xf, v, 1)));
+}
+
+// The AVX-512 kernels load the last components with a mask instead of a scalar loop.
+__attribute__((target("avx512f,avx512bw,avx2,fma"))) inline __mmask16 tail(std::size_t rest) {
+  return rest >= 16 ? static_cast<__mmask16>(0xffff) : static_cast<__mmask16>((1u << rest) - 1);
+}
+
+__attribute__((target("avx512f,avx512bw,avx2,fma"))) float dot_avx512(const void* a, const void* b, std::size_t size) {
+  auto s = _mm512_setzero_ps();
+  for (std::size_t i = 0; i < size; i += 16) {
+    auto mask = tail(size - i);
+    s = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(mask, floats(a, i)), _mm512_maskz_loadu_ps(mask, floats(b, i)), s);
+  }
+  return sum(s);
+}
+
+__attribute__((target("avx512f,avx512bw,avx2,fma"))) float l2_avx512(const void* a, const void* b, std::size_t size) {
+  auto s = _mm512_setzero_ps();
+  for (std::size_t i = 0; i < size; i += 16) {
+    auto mask = tail(size - i);
+    auto d = _mm512_sub_ps(_mm512_maskz_loadu_ps(mask, floats(a, i)), _mm512_maskz_loadu_ps(mask, floats(b, i)));
+    s = _mm512_fmadd_ps(d, d, s);
+  }
+  return sum(s);
+}
+
+__attribute__((target("avx512f,avx512bw,avx2,fma"))) float_sums cosine_avx512(const void* a, const void* b, std::size_t size) {
+  auto ab = _mm512_setzero_ps();
+  auto aa = _mm512_setzero_ps();
+  auto bb = _mm512_setzero_ps();
+  for (std::size_t i = 0; i < size; i += 16) {
+    auto mask = tail(size - i);
+    auto x = _mm512_maskz_loadu_ps(mask, floats(a, i));
+    auto y = _mm512_maskz_loadu_ps(mask, floats(b, i));
+    ab = _mm512_fmadd_ps(x, y, ab);
+    aa = _mm512_fmadd_ps(x, x, aa);
+    bb = _mm512_fmadd_ps(y, y, bb);
+  }
+  return float_sums{ sum(ab), sum(aa), sum(bb) };
+}
+
+__attribute__((target("avx512f,avx512bw,avx2,fma"))) std::int32_t dot8_avx512(const void* a, const void* b, std::size_t size) {
+  auto s = _mm512_setzero_si512();
+  std::size_t i = 0;
+  for (; i + 32 <= size; i += 32) {
+    auto x = _mm512_cvtepi8_epi16(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(bytes(a, i))));
+    auto y = _mm512_cvtepi8_epi16(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(bytes(b, i))));
+    s = _mm512_add_epi32(s, _mm512_madd_epi16(x, y));
+  }
+  return dot8_scalar(a, b, size, i, sum(s));
+}
+
+__attribute__((target("avx512f,avx512bw,avx2,fma"))) std::int32_t l28_avx512(const void* a, const void* b, std::size_t size) {
+  auto s = _mm512_setzero_si512();
+  std::size_t i = 0;
+  for (; i + 32 <= size; i += 32) {
+    auto x = _mm512_cvtepi8_epi16(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(bytes(a, i))));
+    auto y = _mm512_cvtepi8_epi16(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(bytes(b, i))));
+    auto d = _mm512_sub_epi16(x, y);
+    s = _mm512_add_epi32(s, _mm512_madd_epi16(d, d));
+  }
+  return l28_scalar(a, b, size, i, sum(s));
+}
+
+__attribute__((target("avx512f,avx512bw,avx2,fma"))) int_sums cosine8_avx512(const void* a, const void* b, std::size_t size) {
+  auto ab = _mm512_setzero_si512();
+  auto aa = _mm512_setzero_si512();
+  auto bb = _mm512_setzero_si512();
+  std::size_t i = 0;
+  for (; i + 32 <= size; i += 32) {
+    auto x = _mm512_cvtepi8_epi16(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(bytes(a, i))));
+    auto y = _mm512_cvtepi8_epi16(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(bytes(b, i))));
+    ab = _mm512_add_epi32(ab, _mm512_madd_epi16(x, y));
+    aa = _mm512_add_epi32(aa, _mm512_madd_epi16(x, x));
+    bb = _mm512_add_epi32(bb, _mm512_madd_epi16(y, y));
+  }
+  return cosine8_scalar(a, b, size, i, int_sums{ sum(ab), sum(aa), sum(bb) });
+}
+
+#endif
+
+kernels select_kernels() {
+#ifdef SQLITE_VECTOR_X86
+  if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw")) {
+    return kernels{ dot_avx512, l2_avx512, cosine_avx512, dot8_avx512, l28_avx512, cosine8_avx512 };
+  }
+  if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+    return kernels{ dot_avx2, l2_avx2, cosine_avx2, dot8_avx2, l28_avx2, cosine8_avx2 };
+  }
+#endif
+  return kernels{
+    [](const void* a, const void* b, std::size_t size) { return dot_scalar(a, b, size); },
+    [](const void* a, const void* b, std::size_t size) { return l2_scalar(a, b, size); },
+    [](const void* a, const void* b, std::size_t size) { return cosine_scalar(a, b, size); },
+    [](const void* a, const void* b, std::size_t size) { return dot8_scalar(a, b, size); },
+    [](const void* a, const void* b, std::size_t size) { return l28_scalar(a, b, size); },
+    [](const void* a, const void* b, std::size_t size) { return cosine8_scalar(a, b, size); },
+  };
+}
+
+const kernels& active() {
+  static const kernels instance = select_kernels();
+  return instance;
+}
+
+float cosine_distance(double ab, double aa, double bb) {
+  if (aa <= 0 || bb <= 0) {
+    return 1;
+  }
+  return static_cast<float>(1 - ab / std::sqrt(aa * bb));
+}
+
+float dot(const void* a, const void* b, std::size_t size) {
+  return active().dot(a, b, size);
+}
+
+float l2(const void* a, const void* b, std::size_t size) {
+  return std::sqrt(active().l2(a, b, size));
+}
+
+float cosine(const void* a, const void* b, std::size_t size) {
+  auto sums = active().cosine(a, b, size);
+  return cosine_distance(sums.ab, sums.aa, sums.bb);
+}
+
+float dot8(const void* a, const void* b, std::size_t size) {
+  return static_cast<float>(active().dot8(a, b, size));
+}
+
+float l28(const void* a, const void* b, std::size_t size) {
+  return std::sqrt(static_cast<float>(active().l28(a, b, size)));
+}
+
+float cosine8(const void* a, const void* b, std::size_t size) {
+  auto sums = active().cosine8(a, b, size);
+  return cosine_distance(sums.ab, sums.aa, sums.bb);
+}
+
+// Components up to which the int8 kernels' 32-bit sums cannot overflow.
+const std::size_t int8_components = 32768;
+
+// Calls `Distance` with the BLOBs of both arguments and the number of components of
+// `Component` bytes.
+template<float (*Distance)(const void*, const void*, std::size_t), std::size_t Component>
+void call(sqlite3_context* context, int, sqlite3_value** arguments) {
+  if (sqlite3_value_type(arguments[0]) == SQLITE_NULL || sqlite3_value_type(arguments[1]) == SQLITE_NULL) {
+    sqlite3_result_null(context);
+    return;
+  }
+  auto a = sqlite3_value_blob(arguments[0]);
+  auto a_size = static_cast<std::size_t>(sqlite3_value_bytes(arguments[0]));
+  auto b = sqlite3_value_blob(arguments[1]);
+  auto b_size = static_cast<std::size_t>(sqlite3_value_bytes(arguments[1]));
+  if (a_size != b_size || a_size % Component) {
+    sqlite3_result_error(context, "vectors have different dimensions", -1);
+    return;
+  }
+  if (Component == 1 && a_size > int8_components) {
+    sqlite3_result_error(context, "int8 vectors have more than 32768 dimensions", -1);
+    return;
+  }
+  sqlite3_result_double(context, Distance(a, b, a_size / Component));
+}
+
+template<float (*Distance)(const void*, const void*, std::size_t), std::size_t Component>
+void define_function(const database& db, const char* name) {
+  auto flags = SQLITE_UTF8;
+#ifdef SQLITE_DETERMINISTIC
+  flags |= SQLITE_DETERMINISTIC;
+#endif
+  auto hresult = sqlite3_create_function_v2(db.handle(), name, 2, flags, nullptr, call<Distance, Component>, nullptr, nullptr, nullptr);
+  if (hresult != SQLITE_OK) {
+    throw sqlite_exception(sqlite3_errstr(hresult));
+  }
+}
+
+}  // namespace
+
+float vector_dot(const float* a, const float* b, std::size_t size) {
+  return dot(a, b, size);
+}
+
+float vector_l2(const float* a, const float* b, std::size_t size) {
+  return l2(a, b, size);
+}
+
+float vector_cosine(const float* a, const float* b, std::size_t size) {
+  return cosine(a, b, size);
+}
+
+std::int32_t vector_dot(const std::int8_t* a, const std::int8_t* b, std::size_t size) {
+  return active().dot8(a, b, size);
+}
+
+float vector_l2(const std::int8_t* a, const std::int8_t* b, std::size_t size) {
+  return l28(a, b, size);
+}
+
+float vector_cosine(const std::int8_t* a, const std::int8_t* b, std::size_t size) {
+  return cosine8(a, b, size);
+}
+
+void define_vector_functions(const database& db) {
+  define_function<dot, sizeof(float)>(db, "vec_dot");
+  define_function<l2, sizeof(float)>(db, "vec_l2");
+  define_function<cosine, sizeof(float)>(db, "vec_cosine");
+  define_function<dot8, 1>(db, "vec_dot_i8");
+  define_function<l28, 1>(db, "vec_l2_i8");
+  define_function<cosine8, 1>(db, "vec_cosine_i8");
+}
+
+}  // namespace sqlite